@@ -57,9 +57,8 @@ private:
 	*/
 	inline void serializeLocal(cf::WorkPacket &p) const override
 	{
-		sf::Int64 size = numbers.size();
-		p << size;
-		for (sf::Int64 i = 0; i < size; i++) p << numbers[i];
+		//Neighbouring values change slowly, so share their high bytes.
+		p.writeArray(numbers, cf::ArrayFilter::XorPrevious);
 	};
 
 	/**
@@ -70,9 +69,6 @@ private:
 	*/
 	inline void deserializeLocal(cf::WorkPacket &p) override
 	{
-		sf::Int64 size;
-		p >> size;
-		numbers.resize(size);
-		for (sf::Int64 i = 0; i < size; i++) p >> numbers[i];
+		p.readArray(numbers);
 	};
 };
\ No newline at end of file
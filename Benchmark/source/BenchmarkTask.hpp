@@ -33,6 +33,13 @@ public:
 	*/
 	inline std::string getSubtype() const { return "BenchmarkTask"; };
 
+	/**
+	* Get the amount of work in this task.
+	* Overrides virtual function in base class.
+	* @returns The number of square root calculations in this task.
+	*/
+	inline double getWorkSize() const override { return (((double)dataRangeEnd - dataRangeStart) + 1) * cycles; };
+
 private:
 
 	/**
@@ -80,6 +87,30 @@ private:
 		return tasksConv;
 	};
 
+	/**
+	* Split this task up in to chunks sized in proportion to a set of weights, and return
+	* a std::vector of pointers to those split tasks.
+	* Overrides virtual function in base class.
+	* @param weights The relative size of each part.
+	* @returns A std::vector of pointers to the new split tasks.
+	*/
+	inline std::vector<cf::Task *> splitWeightedLocal(const std::vector<double> &weights) const override
+	{
+		std::vector<cf::Task *> tasks;
+
+		//Distribute numbers among the new tasks in proportion to the weights.
+		for (auto &range : divideRange(dataRangeStart, dataRangeEnd, weights))
+		{
+			BenchmarkTask *task = new BenchmarkTask();
+			task->dataRangeStart = range.first;
+			task->dataRangeEnd = range.second;
+			task->cycles = cycles;
+			tasks.push_back(task);
+		}
+
+		return tasks;
+	};
+
 	/**
 	* Serialize this task and store the data in a given packet.
 	* Overrides virtual function in base class.
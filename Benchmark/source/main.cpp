@@ -149,9 +149,7 @@ int main(int argc, char *argv[], char *envp[])
 			testTask->dataRangeEnd = dataRangeEnd;
 			testTask->cycles = cycles;
 
-			unsigned __int64 taskID = testTask->getInitialTaskID();
-
-			host->addTaskToQueue(testTask);
+			cf::TaskHandle handle = host->addTaskToQueue(testTask);
 
 			//Wait for at least one client.
 			CF_SAY("Waiting for clients. Hold Ctrl-Q to quit.", cf::Settings::LogLevels::Info);
@@ -168,17 +166,16 @@ int main(int argc, char *argv[], char *envp[])
 
 			//Wait for results to be complete.
 			CF_SAY("Waiting for completed results.", cf::Settings::LogLevels::Info);
-			while (!host->checkAvailableResult(taskID) && !cf::ConsoleMessager::getInstance()->exceptionThrown)
+			while (!handle.waitFor(100) && !cf::ConsoleMessager::getInstance()->exceptionThrown)
 			{
 				//WAIT
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
 			}
 
 			//Abort main loop if exception was thrown by a thread.
 			if (cf::ConsoleMessager::getInstance()->exceptionThrown) break;
 
-			cf::Result *finished = host->getAvailableResult(taskID);
-			BenchmarkResult *output = static_cast<BenchmarkResult *>(finished);
+			std::unique_ptr<cf::Result> finished = handle.takeResult();
+			BenchmarkResult *output = static_cast<BenchmarkResult *>(finished.get());
 
 			//Stop benchmark test clock.
 			auto end = std::chrono::steady_clock::now();
@@ -203,9 +200,8 @@ int main(int argc, char *argv[], char *envp[])
 			}
 			CF_SAY("Results verified OK from " + std::to_string(host->getClientsCount()) + " clients.", cf::Settings::LogLevels::Info);
 
-			//Remove the result from the completed results queue.
-			host->removeResultFromQueue(finished);
-			finished = nullptr;
+			//Delete the result.
+			finished.reset();
 			output = nullptr;
 
 			//Collect test statistics.
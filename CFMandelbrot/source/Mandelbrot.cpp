@@ -29,7 +29,37 @@ void Mandelbrot::purgeCache(int maxCacheResults)
 	{
 		if ((*it).cacheEntryID < (unsigned int)oldestCacheID && (*it).result != nullptr)
 		{
-			host->removeResultFromQueue((*it).result);
+			//Erasing the cache entry deletes its results.
+			it = cache.erase(it);
+		}
+		else
+		{
+			it++;
+		}
+	}
+}
+
+void Mandelbrot::cancelStaleViews(int maxDepth)
+{
+	std::vector<MandelbrotViewData>::iterator it;
+	for (it = cache.begin(); it != cache.end();)
+	{
+		bool wanted = (*it).result != nullptr;
+
+		if (!wanted && (*it).offsetX == offsetX && (*it).offsetY == offsetY)
+		{
+			for (int i = -maxDepth; i <= maxDepth; i++)
+			{
+				if ((*it).zoom == getNewZoom(i))
+				{
+					wanted = true;
+					break;
+				}
+			}
+		}
+
+		if (!wanted && host->cancelTask((*it).taskID))
+		{
 			it = cache.erase(it);
 		}
 		else
@@ -112,7 +142,7 @@ double Mandelbrot::getNewOffsetX(double currentOffsetX, double currentZoom, int
 	return currentOffsetX;
 }
 
-void Mandelbrot::newView(double zoom, double offsetX, double offsetY, unsigned int imageWidth, unsigned int imageHeight)
+void Mandelbrot::newView(double zoom, double offsetX, double offsetY, unsigned int imageWidth, unsigned int imageHeight, cf::Task::Priorities priority)
 {
 	cf::Task *task = new MandelbrotTask();
 
@@ -121,6 +151,14 @@ void Mandelbrot::newView(double zoom, double offsetX, double offsetY, unsigned i
 	task->setNodeTargetType(cf::Task::NodeTargetTypes::Any);
 	task->allowNodeTaskSplit = false;
 
+	//Rows near the set boundary take far longer than others, so hand rows out to threads on demand, 
+	//a few rows at a time at least.
+	task->setSchedulingMode(cf::Task::SchedulingModes::Guided);
+	task->setMinGrainSize(imageWidth * 4.0);
+
+	//Views generated ahead of time only use nodes that would otherwise be idle.
+	task->setPriority(priority);
+
 	((MandelbrotTask *)task)->zoom = zoom;
 	((MandelbrotTask *)task)->offsetX = offsetX;
 	((MandelbrotTask *)task)->offsetY = offsetY;
@@ -129,17 +167,16 @@ void Mandelbrot::newView(double zoom, double offsetX, double offsetY, unsigned i
 	((MandelbrotTask *)task)->minY = 0;
 	((MandelbrotTask *)task)->maxY = imageHeight - 1;
 
-	host->addTaskToQueue(task);
-
 	//Create new cache entry for this zoom level.
 	MandelbrotViewData mvd;
 	mvd.zoom = zoom;
 	mvd.offsetX = offsetX;
 	mvd.offsetY = offsetY;
-	mvd.result = nullptr;
-	mvd.taskID = task->getInitialTaskID();
+	mvd.handle = host->addTaskToQueue(task);
+	mvd.taskID = mvd.handle.getTaskID();
 	mvd.cacheEntryID = nextCacheID++;
-	cache.push_back(mvd);
+	mvd.priority = priority;
+	cache.push_back(std::move(mvd));
 }
 
 void Mandelbrot::save() const
@@ -88,9 +88,10 @@ public:
 	* @param offsetY The offset in the Y dimension.
 	* @param imageWidth The image width.
 	* @param imageHeight The image height.
+	* @param priority The task priority. Interactive for the view on screen, Prefetch for views generated ahead of time.
 	* @returns void.
 	*/
-	void newView(double zoom, double offsetX, double offsetY, unsigned int imageWidth, unsigned int imageHeight);
+	void newView(double zoom, double offsetX, double offsetY, unsigned int imageWidth, unsigned int imageHeight, cf::Task::Priorities priority);
 	
 	/**
 	* Save current zoom and offset data to disk.
@@ -117,7 +118,7 @@ public:
 	void resetZoomOnly();
 
 	/**
-	* Remove excess cache results from cache and from host results list.
+	* Remove excess cache results from the cache.
 	* Won't purge cache entries that are still pending (no results set yet attached).
 	* @param maxCacheResults The maximum number of results to store in the cache. 
 	* The oldest entries in excess of this number are removed.
@@ -125,6 +126,14 @@ public:
 	*/
 	void purgeCache(int maxCacheResults);
 
+	/**
+	* Cancel views that are still being generated but are no longer wanted, and remove them from the cache.
+	* Views are wanted if they are at the current offset, and no more than maxDepth zoom levels from the current zoom.
+	* @param maxDepth The number of zoom levels either side of the current zoom to keep generating.
+	* @returns void.
+	*/
+	void cancelStaleViews(int maxDepth);
+
 	/**
 	* Get the color value from the color table at the given index.
 	* @param index The table index to use.
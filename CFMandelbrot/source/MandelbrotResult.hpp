@@ -88,10 +88,9 @@ private:
 		p << zoom;
 		p << offsetX;
 		p << offsetY;
-		sf::Int64 size;
-		size = numbers.size();
-		p << size;
-		for (sf::Int64 i = 0; i < size; i++) p << numbers[i];
+
+		//Iteration counts form long runs, inside the set and in the bands around it.
+		p.writeArray(numbers, cf::ArrayFilter::RunLength);
 	};
 
 	/**
@@ -105,9 +104,6 @@ private:
 		p >> zoom;
 		p >> offsetX;
 		p >> offsetY;
-		sf::Int64 size;
-		p >> size;
-		numbers.resize(size);
-		for (sf::Int64 i = 0; i < size; i++) p >> numbers[i];
+		p.readArray(numbers);
 	};
 };
\ No newline at end of file
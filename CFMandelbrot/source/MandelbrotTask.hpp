@@ -49,6 +49,13 @@ public:
 	*/
 	inline std::string getSubtype() const override { return "MandelbrotTask"; };
 
+	/**
+	* Get the amount of work in this task.
+	* Overrides virtual function in base class.
+	* @returns The number of pixels computed by this task.
+	*/
+	inline double getWorkSize() const override { return (((double)maxY - minY) + 1) * spaceWidth; };
+
 private:
 
 	//Maximum number of iterations for Mandelbrot calculations.
@@ -105,6 +112,34 @@ private:
 		return tasksConv;
 	};
 
+	/**
+	* Split this task up in to chunks sized in proportion to a set of weights, and return
+	* a std::vector of pointers to those split tasks.
+	* Overrides virtual function in base class.
+	* @param weights The relative size of each part.
+	* @returns A std::vector of pointers to the new split tasks.
+	*/
+	inline std::vector<cf::Task *> splitWeightedLocal(const std::vector<double> &weights) const override
+	{
+		std::vector<cf::Task *> tasks;
+
+		//Distribute Y-axis rows among the new tasks in proportion to the weights.
+		for (auto &range : divideRange(minY, maxY, weights))
+		{
+			MandelbrotTask *task = new MandelbrotTask();
+			task->minY = range.first;
+			task->maxY = range.second;
+			task->zoom = zoom;
+			task->offsetX = offsetX;
+			task->offsetY = offsetY;
+			task->spaceHeight = spaceHeight;
+			task->spaceWidth = spaceWidth;
+			tasks.push_back(task);
+		}
+
+		return tasks;
+	};
+
 	/**
 	* Serialize this task and store the data in a given packet.
 	* Overrides virtual function in base class.
@@ -179,6 +214,9 @@ private:
 		double imagstart = minY * zoom - spaceHeight / 2.0 * zoom + offsetY;
 		for (unsigned int x = 0; x < spaceWidth; x++, real += zoom) 
 		{
+			//Stop early if the view is no longer wanted.
+			if (isCancelled()) break;
+
 			double imag = imagstart;
 			for (unsigned int y = minY; y <= maxY; y++, imag += zoom) 
 			{
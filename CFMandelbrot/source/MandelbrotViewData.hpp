@@ -1,9 +1,10 @@
 #pragma once
+#include <memory>
 #include "Host.h"
 
 /**
 * MandelbrotViewData class. Mandelbrot set view zoom and offset data for use with the Mandelbrot class.
-* Tracks the ClusterFrac task ID and results set associated with the given view.
+* Tracks the ClusterFrac task handle and results set associated with the given view.
 * @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
 */
 struct MandelbrotViewData
@@ -14,7 +15,17 @@ public:
 	/**
 	* Default constructor.
 	*/
-	MandelbrotViewData() { taskID = 0;  cacheEntryID = 0;  offsetX = offsetY = zoom = 0; result = nullptr; };
+	MandelbrotViewData() { taskID = 0;  cacheEntryID = 0;  offsetX = offsetY = zoom = 0; priority = cf::Task::Priorities::Normal; };
+
+	/**
+	* Move constructor. View data owns its task handle and result, so can be moved but not copied.
+	*/
+	MandelbrotViewData(MandelbrotViewData &&other) = default;
+
+	/**
+	* Move assignment.
+	*/
+	MandelbrotViewData &operator=(MandelbrotViewData &&other) = default;
 
 	/**
 	* Default destructor.
@@ -33,8 +44,14 @@ public:
 	//Task ID.
 	sf::Uint64 taskID;
 
-	//Results pointer.
-	cf::Result *result;
+	//Handle for the task generating this view.
+	cf::TaskHandle handle;
+
+	//Results, once the task has completed.
+	std::unique_ptr<cf::Result> result;
+
+	//Priority of the task generating this view.
+	cf::Task::Priorities priority;
 
 	//Cache entry id. Used to determine oldest entries.
 	unsigned int cacheEntryID;
@@ -219,7 +219,17 @@ int main(int argc, char *argv[], char *envp[])
 						{
 							if (mvd.offsetX == mb.offsetX && mvd.offsetY == mb.offsetY && mvd.zoom == mb.getNewZoom(zoomFactor))
 							{
-								if (zoomFactor == 0) viewResult = mvd.result;
+								if (zoomFactor == 0)
+								{
+									viewResult = mvd.result.get();
+
+									//A view generated ahead of time is now on screen, so the user is waiting on it.
+									if (mvd.result == nullptr && mvd.priority != cf::Task::Priorities::Interactive)
+									{
+										host->setTaskPriority(mvd.taskID, cf::Task::Priorities::Interactive);
+										mvd.priority = cf::Task::Priorities::Interactive;
+									}
+								}
 								found = true;
 								break;
 							}
@@ -227,7 +237,8 @@ int main(int argc, char *argv[], char *envp[])
 
 						if (!found)
 						{
-							mb.newView(mb.getNewZoom(zoomFactor), mb.offsetX, mb.offsetY, IMAGE_WIDTH, IMAGE_HEIGHT);
+							mb.newView(mb.getNewZoom(zoomFactor), mb.offsetX, mb.offsetY, IMAGE_WIDTH, IMAGE_HEIGHT, 
+								zoomFactor == 0 ? cf::Task::Priorities::Interactive : cf::Task::Priorities::Prefetch);
 							break;
 						}
 						else if (abs(zoomFactor) >= maxDepth)
@@ -241,15 +252,15 @@ int main(int argc, char *argv[], char *envp[])
 					}
 				}
 
-				//Match incoming results to their cached tasks.
+				//Stop generating views the user has moved away from.
+				mb.cancelStaleViews(std::max(maxDepth, 0));
+
+				//Take results for cached views from their tasks as they complete.
 				for (auto &mvd : mb.cache)
 				{
-					if (mvd.result == nullptr)
+					if (mvd.result == nullptr && mvd.handle.isComplete())
 					{
-						if (host->checkAvailableResult(mvd.taskID))
-						{
-							mvd.result = host->getAvailableResult(mvd.taskID);
-						}
+						mvd.result = mvd.handle.takeResult();
 					}
 				}
 
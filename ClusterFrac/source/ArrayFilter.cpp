@@ -0,0 +1,172 @@
+#include "ArrayFilter.h"
+#include <cstring>
+
+namespace cf
+{
+	const std::size_t ArrayFilter::DEFAULT_MAX_DECODED_SIZE;
+	std::atomic<std::size_t> ArrayFilter::maxDecodedSize(ArrayFilter::DEFAULT_MAX_DECODED_SIZE);
+
+	void ArrayFilter::encode(Type type, const sf::Uint8 *data, std::size_t count, std::size_t elementSize, std::vector<sf::Uint8> &out)
+	{
+		if (elementSize < 1 || elementSize > 8) CF_THROW("Invalid element size for array filter.");
+
+		out.clear();
+
+		if (type == RunLength)
+		{
+			//Each run of equal elements is stored as its length followed by the element.
+			std::size_t i = 0;
+			while (i < count)
+			{
+				const sf::Uint8 *element = data + i * elementSize;
+				std::size_t j = i + 1;
+				while (j < count && std::memcmp(data + j * elementSize, element, elementSize) == 0) j++;
+
+				writeVarint(j - i, out);
+				out.insert(out.end(), element, element + elementSize);
+				i = j;
+			}
+		}
+		else if (type == Delta)
+		{
+			//Each byte is stored as the difference from the same byte of the previous element.
+			std::size_t bytes = count * elementSize;
+			out.resize(bytes);
+			for (std::size_t k = 0; k < bytes; k++)
+			{
+				out[k] = (sf::Uint8)(data[k] - (k >= elementSize ? data[k - elementSize] : 0));
+			}
+		}
+		else if (type == XorPrevious)
+		{
+			//Each element is XORed with the previous one. Slowly changing values share their sign, exponent and high
+			//mantissa bits, so the result has zero bytes at one or both ends. A header byte holds the number of zero
+			//bytes at the high end in its top four bits and at the low end in its bottom four bits, and only the
+			//bytes between them are stored.
+			out.reserve(count * (elementSize + 1));
+			sf::Uint64 previous = 0;
+			for (std::size_t i = 0; i < count; i++)
+			{
+				sf::Uint64 current = 0;
+				for (std::size_t b = 0; b < elementSize; b++) current |= (sf::Uint64)data[i * elementSize + b] << (8 * b);
+
+				sf::Uint64 x = current ^ previous;
+				previous = current;
+
+				if (x == 0)
+				{
+					out.push_back((sf::Uint8)(elementSize << 4));
+					continue;
+				}
+
+				std::size_t low = 0;
+				while (((x >> (8 * low)) & 0xFF) == 0) low++;
+				std::size_t high = 0;
+				while (((x >> (8 * (elementSize - 1 - high))) & 0xFF) == 0) high++;
+
+				out.push_back((sf::Uint8)((high << 4) | low));
+				for (std::size_t b = low; b < elementSize - high; b++) out.push_back((sf::Uint8)(x >> (8 * b)));
+			}
+		}
+		else
+		{
+			CF_THROW("Unknown array filter.");
+		}
+	}
+
+	bool ArrayFilter::decode(Type type, const sf::Uint8 *data, std::size_t size, std::size_t count, std::size_t elementSize, sf::Uint8 *out)
+	{
+		if (elementSize < 1 || elementSize > 8) CF_THROW("Invalid element size for array filter.");
+
+		if (type == RunLength)
+		{
+			std::size_t pos = 0;
+			std::size_t i = 0;
+			while (i < count)
+			{
+				sf::Uint64 run = 0;
+				if (!readVarint(data, size, pos, run) || run == 0 || run > count - i || pos + elementSize > size) return false;
+
+				for (sf::Uint64 r = 0; r < run; r++) std::memcpy(out + (i + r) * elementSize, data + pos, elementSize);
+				pos += elementSize;
+				i += (std::size_t)run;
+			}
+			if (pos != size) return false;
+		}
+		else if (type == Delta)
+		{
+			std::size_t bytes = count * elementSize;
+			if (size != bytes) return false;
+
+			for (std::size_t k = 0; k < bytes; k++)
+			{
+				out[k] = (sf::Uint8)(data[k] + (k >= elementSize ? out[k - elementSize] : 0));
+			}
+		}
+		else if (type == XorPrevious)
+		{
+			std::size_t pos = 0;
+			sf::Uint64 previous = 0;
+			for (std::size_t i = 0; i < count; i++)
+			{
+				if (pos >= size) return false;
+				std::size_t high = data[pos] >> 4;
+				std::size_t low = data[pos] & 0x0F;
+				pos++;
+
+				if (high + low > elementSize || pos + (elementSize - high - low) > size) return false;
+
+				sf::Uint64 x = 0;
+				for (std::size_t b = low; b < elementSize - high; b++) x |= (sf::Uint64)data[pos++] << (8 * b);
+
+				sf::Uint64 current = x ^ previous;
+				previous = current;
+				for (std::size_t b = 0; b < elementSize; b++) out[i * elementSize + b] = (sf::Uint8)(current >> (8 * b));
+			}
+			if (pos != size) return false;
+		}
+		else
+		{
+			//Unknown array filter.
+			return false;
+		}
+
+		return true;
+	}
+
+	bool ArrayFilter::isValidCount(Type type, std::size_t size, std::size_t count, std::size_t elementSize)
+	{
+		if (elementSize < 1 || elementSize > 8) return false;
+
+		if (type == RunLength) return count <= maxDecodedSize / elementSize;
+		if (type == Delta) return count <= size / elementSize && size == count * elementSize;
+		if (type == XorPrevious) return count <= size;
+
+		return false;
+	}
+
+	void ArrayFilter::writeVarint(sf::Uint64 value, std::vector<sf::Uint8> &out)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back((sf::Uint8)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((sf::Uint8)value);
+	}
+
+	bool ArrayFilter::readVarint(const sf::Uint8 *data, std::size_t size, std::size_t &pos, sf::Uint64 &value)
+	{
+		value = 0;
+		for (unsigned int shift = 0; shift < 64; shift += 7)
+		{
+			if (pos >= size) return false;
+
+			sf::Uint8 b = data[pos++];
+			value |= (sf::Uint64)(b & 0x7F) << shift;
+			if ((b & 0x80) == 0) return true;
+		}
+
+		return false;
+	}
+}
\ No newline at end of file
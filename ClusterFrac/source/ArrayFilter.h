@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <SFML\Network.hpp>
+#include "DllExport.h"
+#include "ConsoleMessager.hpp"
+
+namespace cf
+{
+	/**
+	* Array filter class. Encodes arrays of numbers written to work packets so they take fewer
+	* bytes, or so they compress better in the optional zlib stage that follows. Arrays are
+	* encoded as they are written with WorkPacket::writeArray, and decoded as they are read.
+	* Filters work on the little endian bytes of the elements, so they give the same result on any machine.
+	* Thread safe.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class ArrayFilter
+	{
+
+	public:
+
+		//Filters that can be applied to an array. Stored as a Uint8 in packets.
+		//RunLength stores each run of equal elements as a count and one element. Best for data with long runs.
+		//Delta stores each byte as the difference from the same byte of the previous element. Best for smooth gradients, before zlib.
+		//XorPrevious stores each element XORed with the previous one, leaving out the zero bytes at either end
+		//in the style of the Gorilla time series encoding. Best for floating point values that change slowly.
+		enum Type
+		{
+			None,
+			RunLength,
+			Delta,
+			XorPrevious
+		};
+
+		//Default largest decoded size of a run length encoded array, in bytes.
+		static const std::size_t DEFAULT_MAX_DECODED_SIZE = 1073741824;
+
+		/**
+		* Encode an array.
+		* @param type The filter to apply. Must not be None.
+		* @param data The little endian bytes of the elements.
+		* @param count The number of elements.
+		* @param elementSize The size of each element, in bytes. At most 8.
+		* @param out The buffer to store the encoded data in. Its previous contents are replaced.
+		* @returns void.
+		*/
+		DLL static void encode(Type type, const sf::Uint8 *data, std::size_t count, std::size_t elementSize, std::vector<sf::Uint8> &out);
+
+		/**
+		* Decode an array encoded by encode.
+		* The encoded data comes from the other end of the connection, so it is checked rather than trusted.
+		* @param type The filter that was applied. Must not be None.
+		* @param data The encoded data.
+		* @param size The size of the encoded data, in bytes.
+		* @param count The number of elements encoded.
+		* @param elementSize The size of each element, in bytes. At most 8.
+		* @param out Where to store the little endian bytes of the elements. Must hold count * elementSize bytes.
+		* @returns True if the array was decoded, false if the encoded data is invalid.
+		*/
+		DLL static bool decode(Type type, const sf::Uint8 *data, std::size_t size, std::size_t count, std::size_t elementSize, sf::Uint8 *out);
+
+		/**
+		* Check that an element count read from a packet can be right for the encoded data, before
+		* room is made for the decoded array. Delta encoded arrays are exactly the size of the elements,
+		* XOR encoded arrays take at least one byte per element, and run length encoded arrays are 
+		* limited to the largest decoded size.
+		* @param type The filter that was applied.
+		* @param size The size of the encoded data, in bytes.
+		* @param count The number of elements claimed to be encoded.
+		* @param elementSize The size of each element, in bytes.
+		* @returns True if the count is possible, false if not.
+		*/
+		DLL static bool isValidCount(Type type, std::size_t size, std::size_t count, std::size_t elementSize);
+
+		/**
+		* Set the largest decoded size of a run length encoded array. Run length encoded arrays can
+		* expand to any size, so this limits the memory a packet can ask for.
+		* @param bytes The largest decoded size, in bytes.
+		* @returns void.
+		*/
+		DLL static inline void setMaxDecodedSize(std::size_t bytes) { maxDecodedSize = bytes; };
+
+		/**
+		* Get the largest decoded size of a run length encoded array.
+		* @returns The largest decoded size, in bytes.
+		*/
+		DLL static inline std::size_t getMaxDecodedSize() { return maxDecodedSize; };
+
+	private:
+
+		//Largest decoded size of a run length encoded array, in bytes.
+		static std::atomic<std::size_t> maxDecodedSize;
+
+		/**
+		* Append an unsigned number to a buffer, using as few bytes as it needs, 7 bits per byte.
+		* @param value The number to append.
+		* @param out The buffer to append the number to.
+		* @returns void.
+		*/
+		static void writeVarint(sf::Uint64 value, std::vector<sf::Uint8> &out);
+
+		/**
+		* Read a number written by writeVarint.
+		* @param data The encoded data.
+		* @param size The size of the encoded data, in bytes.
+		* @param pos The read position, which is moved past the number.
+		* @param value Set to the number.
+		* @returns True if the number was read, false if it runs past the end of the data.
+		*/
+		static bool readVarint(const sf::Uint8 *data, std::size_t size, std::size_t &pos, sf::Uint64 &value);
+	};
+}
\ No newline at end of file
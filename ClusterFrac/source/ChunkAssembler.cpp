@@ -0,0 +1,161 @@
+#include "ChunkAssembler.h"
+#include "PacketPool.h"
+
+namespace cf
+{
+	const sf::Uint64 ChunkAssembler::DEFAULT_MAX_MESSAGE_SIZE;
+	const sf::Uint64 ChunkAssembler::DEFAULT_MAX_EARLY_BYTES;
+	const std::size_t ChunkAssembler::MAX_OPEN_MESSAGES;
+	const unsigned int ChunkAssembler::ABANDON_TIMEOUT;
+
+	ChunkAssembler::ChunkAssembler()
+	{
+		//No pieces held yet.
+		earlyBytes = 0;
+
+		//Default limits.
+		maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE;
+		maxEarlyBytes = DEFAULT_MAX_EARLY_BYTES;
+	}
+
+	ChunkAssembler::~ChunkAssembler()
+	{
+		clear();
+	}
+
+	bool ChunkAssembler::add(WorkPacket &frame, WorkPacket *&whole)
+	{
+		whole = nullptr;
+
+		if (frame.getFlag() != WorkPacket::Flag::Chunk || frame.getDataSize() <= WorkPacket::CHUNK_HEADER_SIZE)
+		{
+			CF_SAY("Invalid chunk packet.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		sf::Uint32 messageID = 0;
+		sf::Uint8 flag = WorkPacket::Flag::None;
+		sf::Uint64 size = 0;
+		sf::Uint64 offset = 0;
+		frame >> messageID;
+		frame >> flag;
+		frame >> size;
+		frame >> offset;
+
+		//The rest of the chunk packet is the piece.
+		const char *piece = static_cast<const char *>(frame.getData()) + WorkPacket::CHUNK_HEADER_SIZE;
+		std::size_t pieceSize = frame.getDataSize() - WorkPacket::CHUNK_HEADER_SIZE;
+
+		if (offset > size || pieceSize > size - offset)
+		{
+			CF_SAY("Chunk packet does not fit the packet it is a piece of.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		if (size > maxMessageSize)
+		{
+			CF_SAY("Chunk packet is a piece of a packet of " + std::to_string(size) + " bytes, more than the limit of " 
+				+ std::to_string(maxMessageSize) + " bytes.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		std::unique_lock<std::mutex> lock(assemblerMutex);
+
+		discardAbandoned();
+
+		auto it = messages.find(messageID);
+		if (it == messages.end())
+		{
+			if (messages.size() >= MAX_OPEN_MESSAGES)
+			{
+				CF_SAY("Too many packets sent in pieces at once.", Settings::LogLevels::Error);
+				return false;
+			}
+
+			Message m;
+			//Take a pooled packet that has held a packet this large before, if there is one, so it doesn't grow piece by piece.
+			m.packet = CF_PACKETS->acquire((WorkPacket::Flag)flag, (std::size_t)size);
+			m.size = size;
+			it = messages.emplace(messageID, std::move(m)).first;
+		}
+		Message &m = it->second;
+		m.lastPiece = std::chrono::steady_clock::now();
+
+		if (m.size != size || m.packet->getFlag() != flag)
+		{
+			CF_SAY("Chunk packet does not match the packet it is a piece of.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		sf::Uint64 received = m.packet->getDataSize();
+		if (offset < received || m.early.count(offset) > 0)
+		{
+			CF_SAY("Chunk packet received twice.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		if (offset > received)
+		{
+			if (earlyBytes + pieceSize > maxEarlyBytes)
+			{
+				CF_SAY("Too many bytes held in chunk packets that arrived early.", Settings::LogLevels::Error);
+				return false;
+			}
+
+			//Hold the piece until the pieces in front of it arrive.
+			m.early[offset].assign(piece, piece + pieceSize);
+			earlyBytes += pieceSize;
+			return true;
+		}
+
+		m.packet->append(piece, pieceSize);
+
+		//Add any held pieces that now follow on.
+		auto e = m.early.find(m.packet->getDataSize());
+		while (e != m.early.end())
+		{
+			m.packet->append(e->second.data(), e->second.size());
+			earlyBytes -= e->second.size();
+			m.early.erase(e);
+			e = m.early.find(m.packet->getDataSize());
+		}
+
+		if (m.packet->getDataSize() < m.size) return true;
+
+		whole = m.packet;
+		messages.erase(it);
+		return true;
+	}
+
+	void ChunkAssembler::clear()
+	{
+		std::unique_lock<std::mutex> lock(assemblerMutex);
+		for (auto &m : messages)
+		{
+			CF_PACKETS->release(m.second.packet);
+			m.second.packet = nullptr;
+		}
+		messages.clear();
+		earlyBytes = 0;
+	}
+
+	void ChunkAssembler::discardAbandoned()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (auto it = messages.begin(); it != messages.end();)
+		{
+			if (now - it->second.lastPiece > std::chrono::milliseconds(ABANDON_TIMEOUT))
+			{
+				CF_SAY("Discarding a packet sent in pieces that stopped arriving.", Settings::LogLevels::Info);
+				for (auto &e : it->second.early) earlyBytes -= e.second.size();
+				CF_PACKETS->release(it->second.packet);
+				it->second.packet = nullptr;
+				it = messages.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+}
\ No newline at end of file
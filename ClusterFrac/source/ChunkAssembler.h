@@ -0,0 +1,138 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <SFML\Network.hpp>
+#include "DllExport.h"
+#include "ConsoleMessager.hpp"
+#include "WorkPacket.h"
+
+namespace cf
+{
+	/**
+	* Chunk assembler class. Puts packets sent as a series of chunk packets back together
+	* on the receiving end of one connection. See WorkPacket::nextChunk.
+	* Each piece is added to the packet being rebuilt as soon as it arrives, so only one
+	* piece at a time is held in memory besides the packet itself. Pieces processed out of
+	* order, such as by the listener thread pool, are held until the pieces before them arrive.
+	* The size of each packet, the bytes held in early pieces and the number of packets being put back
+	* together at once are limited, so a misbehaving connection can't use up the receiver's memory.
+	* Packets that receive no pieces for a while are treated as abandoned and discarded.
+	* Thread safe.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class ChunkAssembler
+	{
+
+	public:
+
+		//Default largest data size of a packet that can be put back together, in bytes.
+		static const sf::Uint64 DEFAULT_MAX_MESSAGE_SIZE = 1073741824;
+
+		//Default most bytes held in pieces that arrived early, across all packets being put back together.
+		static const sf::Uint64 DEFAULT_MAX_EARLY_BYTES = 67108864;
+
+		//Most packets that can be put back together at once.
+		static const std::size_t MAX_OPEN_MESSAGES = 16;
+
+		//Time after which a packet that has received no pieces is discarded, in milliseconds.
+		static const unsigned int ABANDON_TIMEOUT = 30000;
+
+		/**
+		* Default constructor.
+		*/
+		DLL ChunkAssembler();
+
+		/**
+		* Default destructor.
+		*/
+		DLL ~ChunkAssembler();
+
+		/**
+		* Add a received chunk packet to the packet it is a piece of.
+		* A chunk packet is invalid if it is malformed, received twice, doesn't match the other pieces of its packet,
+		* or would go over the limits. The connection it came from should be dropped, as the data sent over it 
+		* can no longer be trusted.
+		* @param frame The received chunk packet.
+		* @param whole Set to the whole packet once its last piece has been added, or nullptr if more pieces are needed.
+		* The packet comes from the packet pool, and the caller is responsible for giving it back.
+		* @returns True if the chunk packet was valid, false if not.
+		*/
+		DLL bool add(WorkPacket &frame, WorkPacket *&whole);
+
+		/**
+		* Set the largest data size of a packet that can be put back together.
+		* @param n The largest data size, in bytes.
+		* @returns void.
+		*/
+		DLL inline void setMaxMessageSize(sf::Uint64 n) { maxMessageSize = n; };
+
+		/**
+		* Get the largest data size of a packet that can be put back together.
+		* @returns The largest data size, in bytes.
+		*/
+		DLL inline sf::Uint64 getMaxMessageSize() const { return maxMessageSize; };
+
+		/**
+		* Set the most bytes held in pieces that arrived early, across all packets being put back together.
+		* @param n The most bytes held.
+		* @returns void.
+		*/
+		DLL inline void setMaxEarlyBytes(sf::Uint64 n) { maxEarlyBytes = n; };
+
+		/**
+		* Get the most bytes held in pieces that arrived early, across all packets being put back together.
+		* @returns The most bytes held.
+		*/
+		DLL inline sf::Uint64 getMaxEarlyBytes() const { return maxEarlyBytes; };
+
+		/**
+		* Discard any packets still being put back together, such as when the connection is lost.
+		* @returns void.
+		*/
+		DLL void clear();
+
+	private:
+
+		//A packet being put back together.
+		struct Message
+		{
+			//The packet, holding the pieces received in order so far.
+			WorkPacket *packet;
+
+			//Data size of the whole packet, in bytes.
+			sf::Uint64 size;
+
+			//Pieces that arrived before the pieces in front of them, by offset.
+			std::map<sf::Uint64, std::vector<char>> early;
+
+			//Time the last piece arrived.
+			std::chrono::steady_clock::time_point lastPiece;
+		};
+
+		//Packets being put back together, by message ID.
+		std::unordered_map<sf::Uint32, Message> messages;
+
+		//Bytes held in pieces that arrived early, across all packets being put back together.
+		sf::Uint64 earlyBytes;
+
+		//Largest data size of a packet that can be put back together.
+		std::atomic<sf::Uint64> maxMessageSize;
+
+		//Most bytes held in pieces that arrived early.
+		std::atomic<sf::Uint64> maxEarlyBytes;
+
+		//Mutex for the packets being put back together.
+		std::mutex assemblerMutex;
+
+		/**
+		* Discard packets that have received no pieces for longer than the abandon timeout.
+		* The caller must hold the assembler lock.
+		* @returns void.
+		*/
+		void discardAbandoned();
+	};
+}
\ No newline at end of file
@@ -22,6 +22,19 @@ namespace cf
 
 		//Default network compression status for the host.
 		compression = false;
+
+		connectionCompression = false;
+		compressionLevel = Z_DEFAULT_COMPRESSION;
+
+		handshakeTimeoutMilliseconds = 5000;
+
+		//Results completed together are sent together, without waiting for more.
+		batchSize = 16;
+		batchWindowMilliseconds = 0;
+
+		//Packets over a megabyte are sent in pieces.
+		chunkSize = 1048576;
+		nextChunkMessageID = 0;
 	}
 
 	Client::~Client()
@@ -30,12 +43,18 @@ namespace cf
 		if (processTaskThreadRun)
 		{
 			//Shut down task processing.
+			std::unique_lock<std::mutex> lock(taskQueueMutex);
 			processTaskThreadRun = false;
+			lock.unlock();
+			taskQueueCondition.notify_all();
 
 			//Wait for task processing thread to finish.
 			if (taskProcessingThread.joinable()) taskProcessingThread.join();
 		}
 
+		//Stop the task thread pool.
+		taskPool.stop();
+
 		//Stop the listener.
 		listener.stop();
 
@@ -56,7 +75,7 @@ namespace cf
 
 		std::unordered_set<Result *> removeResults;
 		for (auto &r : resultQueueComplete) removeResults.insert(r);
-		for (auto &r : resultQueueIncomplete) removeResults.insert(r);
+		for (auto &r : incompleteResults.clear()) removeResults.insert(r);
 		for (auto &r : removeResults) delete r;
 
 	}
@@ -78,6 +97,8 @@ namespace cf
 
 		sender.start();
 
+		taskPool.start(MAX_THREADS);
+
 		processTaskThreadRun = true;
 		taskProcessingThread = std::thread([this] { processTaskThread(); });
 		
@@ -126,10 +147,12 @@ namespace cf
 		//Use socket blocking during a connection attempt.
 		socket.setBlocking(true);
 		CF_SAY("Trying to connect to host at " + ipAddress.toString() + " on port " + std::to_string(port) + ".", Settings::LogLevels::Info);
-		if (socket.connect(ipAddress, port) == sf::Socket::Done)
+		if (socket.connect(ipAddress, port) == sf::Socket::Done && handshake())
 		{
 			CF_SAY("Connected to host.", Settings::LogLevels::Info);
+			std::unique_lock<std::mutex> connectionLock(connectionMutex);
 			connected = true;
+			connectionLock.unlock();
 		}
 		else
 		{
@@ -139,13 +162,114 @@ namespace cf
 		}
 		socket.setBlocking(false);
 
+		if (connected)
+		{
+			//Wake the listener thread, which waits while there is no connection.
+			connectionCondition.notify_all();
+
+			//Wake the sender thread, which waits while there is no connection.
+			//Cycle the results queue lock first so the sender can't miss the new connection state.
+			std::unique_lock<std::mutex> resultsLock(resultsQueueMutex);
+			resultsLock.unlock();
+			resultsQueueCondition.notify_all();
+		}
+
 		return connected;
 	}
 
+	bool Client::handshake()
+	{
+		//Handshake packets are never compressed, as compression has not been agreed yet.
+		connectionCompression = false;
+
+		//Send our capabilities, and whether we would like to use compression.
+		cf::WorkPacket packet(cf::WorkPacket::Flag::Handshake);
+		NodeCapabilities::getLocal(MAX_THREADS).serialize(packet);
+		packet << compression;
+		if (socket.send(packet) != sf::Socket::Done)
+		{
+			CF_SAY("Failed to send handshake to host.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		//Wait for the host reply. Switch to non blocking mode so a host that never replies can't lock up the client.
+		socket.setBlocking(false);
+		sf::SocketSelector selector;
+		selector.add(socket);
+
+		packet.clear();
+		sf::Socket::Status status = sf::Socket::Status::NotReady;
+		sf::Clock timer;
+		while (status != sf::Socket::Status::Done && timer.getElapsedTime().asMilliseconds() < (sf::Int32)handshakeTimeoutMilliseconds)
+		{
+			if (!selector.wait(sf::milliseconds(100))) continue;
+
+			status = socket.receive(packet);
+			if (status == sf::Socket::Status::Disconnected || status == sf::Socket::Status::Error) break;
+		}
+		socket.setBlocking(true);
+
+		if (status != sf::Socket::Status::Done || packet.getFlag() != cf::WorkPacket::Flag::Handshake)
+		{
+			CF_SAY("No handshake received from host.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		hostCapabilities.deserialize(packet);
+		if (hostCapabilities.protocolVersion != NodeCapabilities::PROTOCOL_VERSION)
+		{
+			CF_SAY("Host uses protocol version " + std::to_string(hostCapabilities.protocolVersion) + " but the client uses version "
+				+ std::to_string(NodeCapabilities::PROTOCOL_VERSION) + ".", Settings::LogLevels::Error);
+			return false;
+		}
+
+		bool accepted;
+		bool useCompression;
+		packet >> accepted;
+		packet >> useCompression;
+
+		if (!accepted)
+		{
+			CF_SAY("Host rejected the handshake.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		connectionCompression = useCompression;
+
+		//Use the host's IDs for task and result subtypes on this connection.
+		taskTypes.setRemoteNames(TaskTypeRegistry::deserializeNames(packet));
+		resultTypes.setRemoteNames(ResultTypeRegistry::deserializeNames(packet));
+
+		//Compress with the host's preset dictionaries on this connection.
+		std::map<sf::Uint8, std::vector<sf::Uint8>> dictionaries;
+		sf::Uint8 dictionaryCount = 0;
+		packet >> dictionaryCount;
+		for (sf::Uint8 i = 0; i < dictionaryCount; i++)
+		{
+			sf::Uint8 flag = 0;
+			packet >> flag;
+			if (!packet.readArray(dictionaries[flag]))
+			{
+				CF_SAY("Invalid compression dictionary from host.", Settings::LogLevels::Error);
+				return false;
+			}
+		}
+		compressionEngine.setDictionaries(dictionaries);
+		compressionEngine.setLevel(compressionLevel);
+
+		CF_SAY("Host has " + std::to_string(hostCapabilities.threads) + " thread(s), SIMD features: " + hostCapabilities.getSIMDFeaturesString()
+			+ ". Network compression " + (useCompression ? "on." : "off."), Settings::LogLevels::Info);
+
+		return true;
+	}
+
 	void Client::disconnect()
 	{
 		socket.disconnect();
 		connected = false;
+
+		//Pieces of packets from this connection will never be completed.
+		chunkAssembler.clear();
 	}
 
 	void Client::addTaskToQueue(Task *task)
@@ -153,6 +277,71 @@ namespace cf
 		std::unique_lock<std::mutex> lock(taskQueueMutex);
 		taskQueue.push_back(task);
 		CF_SAY("Added task " + std::to_string(task->getInitialTaskID()) + " to queue.", Settings::LogLevels::Info);
+		lock.unlock();
+
+		//Wake the task processing thread.
+		taskQueueCondition.notify_one();
+	}
+
+	void Client::trackCancellationToken(Task *task)
+	{
+		std::unique_lock<std::mutex> lock(cancellationTokensMutex);
+
+		//Forget tokens of tasks that have finished.
+		for (auto it = cancellationTokens.begin(); it != cancellationTokens.end();)
+		{
+			if (it->second.expired())
+			{
+				it = cancellationTokens.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		cancellationTokens.emplace(task->getInitialTaskID(), task->getCancellationToken());
+	}
+
+	void Client::cancelTask(unsigned __int64 taskID)
+	{
+		CF_SAY("Cancelling task " + std::to_string(taskID) + ".", Settings::LogLevels::Info);
+
+		//Cancel running parts of the task.
+		std::unique_lock<std::mutex> tokensLock(cancellationTokensMutex);
+		auto range = cancellationTokens.equal_range(taskID);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			std::shared_ptr<std::atomic<bool>> token = it->second.lock();
+			if (token) *token = true;
+		}
+		cancellationTokens.erase(range.first, range.second);
+		tokensLock.unlock();
+
+		//Remove parts of the task that have not started.
+		std::unique_lock<std::mutex> lock(taskQueueMutex);
+		for (auto it = taskQueue.begin(); it != taskQueue.end();)
+		{
+			if ((*it)->getInitialTaskID() == taskID)
+			{
+				delete *it;
+				it = taskQueue.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	void Client::queuePartialResult(Result *partial)
+	{
+		std::unique_lock<std::mutex> lock(resultsQueueMutex);
+		resultQueueComplete.push_back(partial);
+		lock.unlock();
+
+		//Wake the sender thread.
+		resultsQueueCondition.notify_one();
 	}
 
 	void Client::processTaskThread()
@@ -161,9 +350,14 @@ namespace cf
 		{
 			while (processTaskThreadRun && !cf::ConsoleMessager::getInstance()->exceptionThrown)
 			{
-				//Copy the local task queue.
+				//Wait for tasks to arrive in the local task queue.
+				//A timeout is set so the thread still responds to exceptions thrown elsewhere.
 				std::unique_lock<std::mutex> lock(taskQueueMutex);
-				std::list<Task *> taskQueueCOPY = taskQueue;
+				taskQueueCondition.wait_for(lock, std::chrono::milliseconds(100), [this] { return !processTaskThreadRun || taskQueue.size() > 0; });
+
+				//Take all tasks from the local task queue.
+				std::list<Task *> taskQueueCOPY;
+				taskQueueCOPY.swap(taskQueue);
 				lock.unlock();
 
 				for (auto &t : taskQueueCOPY)
@@ -172,102 +366,50 @@ namespace cf
 
 					CF_SAY("Task " + std::to_string(taskID) + " - started.", Settings::LogLevels::Info);
 
-					//Split the task among available threads and run.
-					std::vector<Task *> tasks;
-					Task *removeTask = t;
-					if (MAX_THREADS > 1)
-					{
-						tasks = t->split(MAX_THREADS);
-
-						//Remove the original task from memory.
-						delete t;
-						t = nullptr;
-					}
-					else
-					{
-						tasks = std::vector<Task *>{ t };
-						//Don't remove original task from memory here. We'll be using it passed on as a subtask.
-						//IT will get cleaned up later as a subtask.
-					}
-
-					//Remove the task from the local task parts queue.
-					std::unique_lock<std::mutex> lock3(taskQueueMutex);
-					taskQueue.erase(std::remove(taskQueue.begin(), taskQueue.end(), removeTask), taskQueue.end());
-					lock3.unlock();
+					//Results are merged back to the depth of the task received from the host before being sent.
+					size_t completeDepth = t->getTaskPartNumberStack().size();
 
-					std::vector<std::future<Result *>> threads = std::vector<std::future<Result *>>();
+					//Send partial results streamed by the task to the host as they arrive.
+					if (t->getStreamResults()) t->setPartialResultSink([this](Result *partial) { queuePartialResult(partial); });
 
 					//Start benchmark timer.
 					auto start = std::chrono::steady_clock::now();
 
-					for (auto &task : tasks)
-					{
-						threads.push_back(std::async(std::launch::async, [&task]() { return task->run(); }));
-					}
-
-					std::vector<Result *> results;
-
-					unsigned int threadID = 0;
-					for (auto &thread : threads)
-					{
-						CF_SAY("Task " + std::to_string(taskID) + " - processing on thread " + std::to_string(threadID++) + ".", Settings::LogLevels::Info);
-						auto result = thread.get();
-						results.push_back(result);
-					}
-
-					for (auto &task : tasks)
+					//Tasks using a dynamic scheduling mode are handed to the pool threads in chunks on demand.
+					if (t->getSchedulingMode() != Task::SchedulingModes::Static && MAX_THREADS > 1)
 					{
-						delete task;
-						task = nullptr;
+						taskPool.runScheduledTask(t, true, [this, taskID, completeDepth, start](std::vector<Task *> &tasks, std::vector<Result *> &results)
+						{
+							completeTask(taskID, tasks, results, completeDepth, start);
+						});
+						continue;
 					}
 
-					//Stop benchmark test clock.
-					auto end = std::chrono::steady_clock::now();
-					auto diff = end - start;
-
-					CF_SAY("Task " + std::to_string(taskID) + " time: " + std::to_string(std::chrono::duration <double, std::milli>(diff).count()) + " ms.", Settings::LogLevels::Info);
-
-					Result *result;
-
-					//Merge result objects if there was more than one in the resulting set.
-					if (results.size() > 1)
+					//Split the task among available threads.
+					std::vector<Task *> tasks;
+					bool split = MAX_THREADS > 1;
+					if (split)
 					{
-						if (resultConstructMap.size() == 0 || resultConstructMap.find(results.front()->getSubtype()) == resultConstructMap.end()) CF_THROW("Invalid results type.");
-						result = resultConstructMap[results.front()->getSubtype()]();
+						tasks = t->split(MAX_THREADS);
 
-						result->merge(results);
+						//Remove the original task from memory.
+						delete t;
+						t = nullptr;
 					}
 					else
 					{
-						result = results.front();
+						tasks = std::vector<Task *>{ t };
+						//Don't remove original task from memory here. We'll be using it passed on as a subtask.
+						//IT will get cleaned up later as a subtask.
 					}
 
-					//Clean up temporary results objects, but only if they were a set of more than one.
-					//If there was just one result than we need to keep the single result object in memory
-					//and just pass it to the completed results list.
-					if (results.size() > 1)
+					//Hand the task parts to the thread pool. Parts of this task run alongside parts of
+					//any tasks still in progress, and the last part to finish completes the task.
+					taskPool.runTasks(tasks, [this, taskID, tasks, completeDepth, start](std::vector<Result *> &results) mutable
 					{
-						for (auto &r : results)
-						{
-							delete r;
-							r = nullptr;
-						}
-					}
-
-					CF_SAY("Task " + std::to_string(taskID) + " - completed.", Settings::LogLevels::Info);
-
-					//Place the result in the client COMPLETED result queue.
-					//Even if this is a result part, we know it must be sent back to the host
-					//for merging with other result parts. So we treat it like a complete result.
-					std::unique_lock<std::mutex> lock2(resultsQueueMutex);
-					resultQueueComplete.push_back(result);
-					lock2.unlock();
-
-					//Scan the incomplete results queue for complete results sets and move them to the complete results queue.
-					checkForCompleteResults();
+						completeTask(taskID, tasks, results, completeDepth, start);
+					});
 				}
-
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
 			}
 
 		}
@@ -283,76 +425,86 @@ namespace cf
 		}
 	}
 
-	void Client::checkForCompleteResults()
+	void Client::completeTask(unsigned __int64 taskID, std::vector<Task *> &tasks, std::vector<Result *> &results, 
+		size_t completeDepth, std::chrono::steady_clock::time_point start)
 	{
-		//Aquire lock on result queues.
-		std::unique_lock<std::mutex> lock(resultsQueueMutex);
+		//All parts of a task share its cancellation token.
+		bool cancelled = tasks.size() > 0 && tasks.front()->isCancelled();
 
-		std::vector<Result *> set;
-		std::vector<Result *> remove;
-		for (auto &r1 : resultQueueIncomplete)
+		for (auto &task : tasks)
 		{
-			//If this result part is already in the removal list, then skip it.
-			if (remove.size() > 0 && std::find(remove.begin(), remove.end(), r1) != remove.end()) continue;
-
-			set.push_back(r1);
+			delete task;
+			task = nullptr;
+		}
 
-			for (auto &r2 : resultQueueIncomplete)
+		//The host no longer wants the results of cancelled tasks.
+		if (cancelled)
+		{
+			for (auto &r : results)
 			{
-				//Skip checking against ourself.
-				if (r1 == r2) continue;
+				delete r;
+				r = nullptr;
+			}
 
-				//If this result part is already in the removal list, then skip it.
-				if (remove.size() > 0 && std::find(remove.begin(), remove.end(), r2) != remove.end()) continue;
+			CF_SAY("Task " + std::to_string(taskID) + " - cancelled.", Settings::LogLevels::Info);
+			return;
+		}
 
-				//Compare initial task ID of the two result parts.
-				if (r2->getInitialTaskID() == r1->getInitialTaskID()) set.push_back(r2);
-			}
+		//Stop benchmark test clock.
+		auto end = std::chrono::steady_clock::now();
+		auto diff = end - start;
 
-			//If all parts of the result set are present, merge them and place the 
-			//combined result on the completed results queue.
-			if (set.size() == r1->getCurrentTaskPartsTotal())
-			{
-				Result *rNew;
-				
-				//Merge if the results set is in multiple parts. 
-				//Otherwise just copy the results set pointer.
-				if (set.size() > 1)
-				{
-					if (resultConstructMap.size() == 0 || resultConstructMap.find(r1->getSubtype()) == resultConstructMap.end()) CF_THROW("Invalid results type.");
+		CF_SAY("Task " + std::to_string(taskID) + " time: " + std::to_string(std::chrono::duration <double, std::milli>(diff).count()) + " ms.", Settings::LogLevels::Info);
 
-					rNew = resultConstructMap[r1->getSubtype()]();
+		//Add each result part to its result set. The final part merges the set, which also unwinds 
+		//the task part stack back to that of the original task.
+		for (auto &r : results)
+		{
+			checkForCompleteResults(r, completeDepth);
+			r = nullptr;
+		}
 
-					rNew->merge(set);
-				}
-				else
-				{
-					rNew = set.front();
-				}
+		CF_SAY("Task " + std::to_string(taskID) + " - completed.", Settings::LogLevels::Info);
+	}
 
-				resultQueueComplete.push_back(rNew);
+	void Client::checkForCompleteResults(Result *result, size_t completeDepth)
+	{
+		//Merge each set as its last part arrives, working back up the task tree to the task received from the host.
+		while (result->getTaskPartNumberStack().size() > completeDepth)
+		{
+			std::unique_lock<std::mutex> lock(resultsQueueMutex);
+			std::vector<Result *> set;
+			bool added = incompleteResults.add(result, set);
+			lock.unlock();
 
-				//Record these results for removal from the incomplete results set.
-				remove.insert(remove.end(), set.begin(), set.end());
+			//Parts are produced by this client's own tasks, so a part that does not fit its set is a bug.
+			if (!added) CF_THROW("Cannot index result. Task part is out of range, already arrived, or does not match its set.");
 
-			}
-			set.clear();
-		}
+			//The set is still waiting on other parts.
+			if (set.size() == 0) return;
 
-		for (auto &r : remove)
-		{
-			//Remove completed results from incomplete results set.
-			resultQueueIncomplete.erase(std::remove(resultQueueIncomplete.begin(), resultQueueIncomplete.end(), r), resultQueueIncomplete.end());
+			Result *rNew = resultTypes.createLike(set.front());
+			if (rNew == nullptr) CF_THROW("Invalid results type.");
+			rNew->merge(set);
 
-			//If the result is part of a set, delete the result set part from memory 
-			//as we will have merged it into a new results set previously.
-			if (r->getCurrentTaskPartsTotal() > 1)
+			//Delete the result set parts from memory, as we have merged them into a new result.
+			for (auto &r : set)
 			{
 				delete r;
 				r = nullptr;
 			}
+
+			result = rNew;
 		}
 
+		//Place the result in the client COMPLETED result queue.
+		//Even if this is a result part, we know it must be sent back to the host
+		//for merging with other result parts. So we treat it like a complete result.
+		std::unique_lock<std::mutex> lock(resultsQueueMutex);
+		resultQueueComplete.push_back(result);
+		lock.unlock();
 
+		//Wake the sender thread.
+		resultsQueueCondition.notify_one();
 	}
 }
\ No newline at end of file
@@ -4,7 +4,10 @@
 #include <list>
 #include <thread>
 #include <future>
+#include <chrono>
+#include <condition_variable>
 #include <unordered_set>
+#include <unordered_map>
 #include <SFML\Network.hpp>
 #include "DllExport.h"
 #include "ConsoleMessager.hpp"
@@ -12,6 +15,12 @@
 #include "Result.h"
 #include "ClientListener.h"
 #include "ClientSender.h"
+#include "ThreadPool.h"
+#include "ResultSetIndex.h"
+#include "NodeCapabilities.h"
+#include "TypeRegistry.hpp"
+#include "CompressionEngine.h"
+#include "ChunkAssembler.h"
 
 namespace cf
 {
@@ -43,24 +52,28 @@ namespace cf
 		* Register new task construction callback.
 		* @param name The name of the new task.
 		* @param f The callback function to use to construct a new task of this type.
+		* @param poolSize Number of tasks of this type to set aside pooled memory for straight away, so the first
+		* tasks split, received or merged reuse memory. Memory is pooled as tasks are destroyed in any case.
 		* @returns void.
 		*/
-		DLL inline void registerTaskType(std::string name, std::function<Task *()> f)
+		DLL inline void registerTaskType(std::string name, std::function<Task *()> f, unsigned int poolSize = 0)
 		{ 
 			CF_SAY("Registered task type " + name + ".", Settings::LogLevels::Info); 
-			taskConstructMap[name] = f; 
+			taskTypes.add(name, f, poolSize);
 		};
 
 		/**
 		* Register new result construction callback.
 		* @param name The name of the new result.
 		* @param f The callback function to use to construct a new result of this type.
+		* @param poolSize Number of results of this type to set aside pooled memory for straight away, so the first
+		* results split, received or merged reuse memory. Memory is pooled as results are destroyed in any case.
 		* @returns void.
 		*/
-		DLL inline void registerResultType(std::string name, std::function<Result *()> f)
+		DLL inline void registerResultType(std::string name, std::function<Result *()> f, unsigned int poolSize = 0)
 		{ 
 			CF_SAY("Registered result type " + name + ".", Settings::LogLevels::Info); 
-			resultConstructMap[name] = f; 
+			resultTypes.add(name, f, poolSize);
 		};
 
 		/**
@@ -132,6 +145,10 @@ namespace cf
 
 		/**
 		* Set network compression on or off on the client.
+		* Compression is used for a connection if it is enabled on either the host or the client.
+		* Each packet is then only compressed if the measured link speed, compression speed and compression
+		* ratio for the connection show that compressing saves time.
+		* Changes take effect on the next connection to a host.
 		* @param newStatus Set true to enable compression, false to disable.
 		* @returns void.
 		*/
@@ -143,6 +160,70 @@ namespace cf
 		*/
 		DLL inline bool getCompression() const { return compression; };
 
+		/**
+		* Set the zlib compression level used when sending results to the host.
+		* Changes take effect on the next connection to a host.
+		* @param newLevel The compression level, from 0 (no compression) to 9 (best compression). Lower levels use less CPU time.
+		* @returns void.
+		*/
+		DLL inline void setCompressionLevel(int newLevel) { if (newLevel < 0 || newLevel > 9) { CF_THROW("Invalid compression level."); } compressionLevel = newLevel; };
+
+		/**
+		* Get the zlib compression level used when sending results to the host.
+		* @returns The compression level, or Z_DEFAULT_COMPRESSION if it has not been set.
+		*/
+		DLL inline int getCompressionLevel() const { return compressionLevel; };
+
+		/**
+		* Set the maximum number of results sent to the host in one batch packet.
+		* Results completed close together are sent in a single packet, saving the per packet overhead
+		* for workloads with many small task parts.
+		* @param n The maximum number of results per batch. Set to 1 to send each result in its own packet.
+		* @returns void.
+		*/
+		DLL inline void setBatchSize(unsigned int n) { if (n < 1) { CF_THROW("Invalid batch size."); } batchSize = n; };
+
+		/**
+		* Get the maximum number of results sent to the host in one batch packet.
+		* @returns The maximum number of results per batch.
+		*/
+		DLL inline unsigned int getBatchSize() const { return batchSize; };
+
+		/**
+		* Set how long the sender waits for more results to fill a batch packet before sending it.
+		* With a window of zero, a batch holds the results already completed when the send begins.
+		* @param milliseconds The batch window, in milliseconds.
+		* @returns void.
+		*/
+		DLL inline void setBatchWindow(unsigned int milliseconds) { batchWindowMilliseconds = milliseconds; };
+
+		/**
+		* Get how long the sender waits for more results to fill a batch packet before sending it.
+		* @returns The batch window, in milliseconds.
+		*/
+		DLL inline unsigned int getBatchWindow() const { return batchWindowMilliseconds; };
+
+		/**
+		* Set the largest amount of data sent in one piece to the host.
+		* Larger packets, such as tasks or results with big data arrays, are split into pieces that are
+		* compressed and sent one at a time, so only one piece at a time is held in memory besides the packet.
+		* @param bytes The largest piece size, in bytes. Set to zero to always send packets whole.
+		* @returns void.
+		*/
+		DLL inline void setChunkSize(std::size_t bytes) { chunkSize = bytes; };
+
+		/**
+		* Get the largest amount of data sent in one piece to the host.
+		* @returns The largest piece size, in bytes, or zero if packets are always sent whole.
+		*/
+		DLL inline std::size_t getChunkSize() const { return chunkSize; };
+
+		/**
+		* Get the capabilities of the host this client is connected to, as received during the connection handshake.
+		* @returns The capabilities of the host.
+		*/
+		DLL inline const NodeCapabilities &getHostCapabilities() const { return hostCapabilities; };
+
 	private:
 
 		//Maximum threads for multi process forking.
@@ -151,6 +232,37 @@ namespace cf
 		//Is network compression enabled on the host?
 		bool compression;
 
+		//Is network compression in use for the current connection? Agreed with the host during the connection handshake.
+		std::atomic<bool> connectionCompression;
+
+		//Zlib compression level used when sending results to the host.
+		std::atomic<int> compressionLevel;
+
+		//Compresses and decompresses packets for the current connection.
+		//Holds the preset compression dictionaries sent by the host during the connection handshake.
+		CompressionEngine compressionEngine;
+
+		//Capabilities of the host, received during the connection handshake.
+		NodeCapabilities hostCapabilities;
+
+		//Maximum number of results sent to the host in one batch packet.
+		std::atomic<unsigned int> batchSize;
+
+		//Time the sender waits for more results to fill a batch packet, in milliseconds.
+		std::atomic<unsigned int> batchWindowMilliseconds;
+
+		//Largest amount of data sent to the host in one piece, in bytes, or zero to send packets whole.
+		std::atomic<std::size_t> chunkSize;
+
+		//ID for the next message sent to the host in chunks. Only used by the sender thread.
+		sf::Uint32 nextChunkMessageID;
+
+		//Puts back together packets the host sends in chunks.
+		ChunkAssembler chunkAssembler;
+
+		//Maximum time to wait for the host to reply to the connection handshake, in milliseconds.
+		unsigned int handshakeTimeoutMilliseconds;
+
 		//Socket for the network connection.
 		sf::TcpSocket socket;
 
@@ -163,6 +275,12 @@ namespace cf
 		//Is the client connected to a host?
 		std::atomic<bool> connected;
 
+		//Mutex for changes to the connection state.
+		std::mutex connectionMutex;
+
+		//Signals the listener thread that a connection to a host has been made.
+		std::condition_variable connectionCondition;
+
 		//Port number to connect to.
 		int port;
 
@@ -181,8 +299,18 @@ namespace cf
 		//Mutex for task queue
 		std::mutex taskQueueMutex;
 
-		//Incomplete results queue.
-		std::list<cf::Result *> resultQueueIncomplete;
+		//Signals the task processing thread that tasks have been added to the task queue.
+		std::condition_variable taskQueueCondition;
+
+		//Cancellation tokens of tasks received from the host, keyed by initial task ID.
+		//Tokens expire once the task and all of its parts have been deleted.
+		std::unordered_multimap<unsigned __int64, std::weak_ptr<std::atomic<bool>>> cancellationTokens;
+
+		//Mutex for cancellation tokens.
+		std::mutex cancellationTokensMutex;
+
+		//Incomplete result sets, waiting for their remaining parts.
+		ResultSetIndex incompleteResults;
 
 		//Complete results queue.
 		std::list<cf::Result *> resultQueueComplete;
@@ -190,15 +318,21 @@ namespace cf
 		//Mutex for results queues
 		std::mutex resultsQueueMutex;
 
-		//Construction map for user defined Tasks.
-		std::map<std::string, std::function<Task *()>> taskConstructMap;
+		//Signals the sender thread that results have been added to the complete results queue.
+		std::condition_variable resultsQueueCondition;
+
+		//Construction callbacks and wire IDs for user defined Tasks.
+		TaskTypeRegistry taskTypes;
 
-		//Construction map for user defined Results.
-		std::map<std::string, std::function<Result *()>> resultConstructMap;
+		//Construction callbacks and wire IDs for user defined Results.
+		ResultTypeRegistry resultTypes;
 
-		//Thread used to process task chunks locally on the host.
+		//Thread used to hand queued tasks to the task thread pool.
 		std::thread taskProcessingThread;
 
+		//Worker threads that run task parts.
+		ThreadPool taskPool;
+
 		//Should the client tasks processing thread continue to run?
 		std::atomic<bool> processTaskThreadRun;
 
@@ -209,10 +343,58 @@ namespace cf
 		void processTaskThread();
 
 		/**
-		* Check the incomplete results queue for complete result sets.
-		* Completed results set that are found are moved to the complete results queue.
+		* Exchange handshake packets with the host after the socket has connected.
+		* Sends the client capabilities, then waits for the host capabilities and the agreed compression status.
+		* The socket must be in blocking mode.
+		* @returns True if the host accepted the handshake, false if not.
+		*/
+		bool handshake();
+
+		/**
+		* Record the cancellation token of a task received from the host, so the host can cancel it.
+		* @param task The task received from the host.
+		* @returns void.
+		*/
+		void trackCancellationToken(Task *task);
+
+		/**
+		* Cancel all parts of a task, as asked by the host. Parts still in the task queue are deleted. 
+		* Running parts are cancelled through their cancellation token, and their results are discarded.
+		* @param taskID The initial task ID of the task to cancel.
+		* @returns void.
+		*/
+		void cancelTask(unsigned __int64 taskID);
+
+		/**
+		* Queue a partial result streamed by a running task part for sending to the host.
+		* @param partial The partial result. Deleted once sent.
+		* @returns void.
+		*/
+		void queuePartialResult(Result *partial);
+
+		/**
+		* Finish a task once all of its parts have been run by the task thread pool.
+		* Merges the part results if the task was split, and places the result in the completed results queue.
+		* The results are discarded if the task was cancelled.
+		* @param taskID The ID of the task.
+		* @param tasks The task parts that were run.
+		* @param results The results of the task parts, in the same order as the task parts.
+		* @param completeDepth The task part stack depth of the task received from the host, which the results are merged back to.
+		* @param start The time the task parts were handed to the task thread pool.
+		* @returns void.
+		*/
+		void completeTask(unsigned __int64 taskID, std::vector<Task *> &tasks, std::vector<Result *> &results, 
+			size_t completeDepth, std::chrono::steady_clock::time_point start);
+
+		/**
+		* Add a newly completed result part to the incomplete result sets, and merge its set if this part completes it.
+		* Merged results are added in turn until a set is still waiting on other parts, or the result is back at 
+		* the task part stack depth of the task received from the host. Complete results are moved to the 
+		* complete results queue.
+		* @param result The newly completed result part.
+		* @param completeDepth The task part stack depth at which a result is complete and ready to send to the host.
 		* @returns void.
 		*/
-		void checkForCompleteResults();
+		void checkForCompleteResults(Result *result, size_t completeDepth);
 	};
 }
\ No newline at end of file
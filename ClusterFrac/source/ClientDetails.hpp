@@ -1,8 +1,15 @@
 #pragma once
 #include <atomic>
 #include <mutex>
+#include <deque>
+#include <chrono>
+#include <unordered_set>
 #include <SFML\Network.hpp>
 #include "Task.h"
+#include "NodeCapabilities.h"
+#include "NativeSockets.hpp"
+#include "CompressionEngine.h"
+#include "ChunkAssembler.h"
 #include "DllExport.h"
 
 namespace cf
@@ -38,11 +45,23 @@ namespace cf
 			for (auto &t : tasks)
 			{
 				delete t;
-				t = nullptr;
 			}
 			tasks.clear();
 			lock.unlock();
 
+			//Delete from memory any messages that were never sent.
+			std::unique_lock<std::mutex> queueLock(sendQueueMutex);
+			for (auto &p : sendQueue)
+			{
+				delete p;
+			}
+			sendQueue.clear();
+			delete openBatch;
+			openBatch = nullptr;
+			delete chunkFrame;
+			chunkFrame = nullptr;
+			queueLock.unlock();
+
 			delete socket;
 			socket = nullptr;
 		};
@@ -53,35 +72,105 @@ namespace cf
 		*/
 		DLL void init()
 		{
-			socket = new sf::TcpSocket();
+			socket = new NativeTcpSocket();
 			socket->setBlocking(false);
-			busy = false;
 			remove = false;
+			throughput = 0;
+			handshakeComplete = false;
+			compression = false;
+			knownTaskTypes = 0;
+			pendingPackets = 0;
+			openBatch = nullptr;
+			openBatchCount = 0;
+			chunkFrame = nullptr;
+			nextChunkMessageID = 0;
 		};
 
 		//Socket used to communicate with this client.
-		sf::TcpSocket *socket;
+		NativeTcpSocket *socket;
 
 		//Socket mutex for this client, for locking the socket during use.
 		std::mutex socketMutex;
 
-		//Is this client busy with a task?
-		std::atomic<bool> busy;
+		//Messages waiting to be sent to this client, oldest first. The front message may be partly sent.
+		std::deque<WorkPacket *> sendQueue;
+
+		//Batch packet still collecting tasks for this client, or nullptr if there is none.
+		//Guarded by the outbound message queue mutex.
+		WorkPacket *openBatch;
+
+		//Number of tasks in the open batch packet, and when the batch was started.
+		//Guarded by the outbound message queue mutex.
+		unsigned int openBatchCount;
+		std::chrono::steady_clock::time_point openBatchStarted;
+
+		//Chunk packet holding the next piece of the front message, if the front message is being sent in chunks.
+		//Only used by the sender I/O thread serving this client.
+		WorkPacket *chunkFrame;
+
+		//ID for the next message sent to this client in chunks.
+		//Only used by the sender I/O thread serving this client.
+		sf::Uint32 nextChunkMessageID;
+
+		//Outbound message queue mutex.
+		std::mutex sendQueueMutex;
+
+		//Data received from this client that does not yet make up a whole packet.
+		//Only used by the listener reactor.
+		std::vector<char> receiveBuffer;
+
+		//Number of packets received from this client that are still waiting to be processed.
+		//The client is not deleted until they have been.
+		std::atomic<unsigned int> pendingPackets;
 
 		//Should this client be removed?
 		std::atomic<bool> remove;
 
+		//Has the client completed the connection handshake? Tasks are only sent to clients that have.
+		std::atomic<bool> handshakeComplete;
+
+		//Is network compression enabled for this client? Agreed during the connection handshake.
+		std::atomic<bool> compression;
+
+		//Number of task subtypes the client was told about during the connection handshake.
+		//Tasks of subtypes registered later are sent with their subtype name.
+		std::atomic<sf::Uint16> knownTaskTypes;
+
+		//Compresses and decompresses packets for this client.
+		//Set up with the host compression level and dictionaries during the connection handshake.
+		CompressionEngine compressionEngine;
+
+		//Puts back together packets this client sends in chunks.
+		ChunkAssembler chunkAssembler;
+
+		//Capabilities reported by the client during the connection handshake.
+		NodeCapabilities capabilities;
+
+		//Estimated task processing throughput of this client, in task work units per second.
+		//Zero until the client has completed a task.
+		std::atomic<double> throughput;
+
 		//Tasks assigned to this client.
-		std::vector<Task *> tasks;
+		std::unordered_set<Task *> tasks;
 
 		//Task tracking list mutex.
 		std::mutex taskMutex;
 
+		//Host time the most recent result from this client was received.
+		//Guarded by the task tracking list mutex.
+		sf::Time lastResultTime;
+
 		/**
 		* Assign a task to this client so that its progress can be tracked.
 		* @returns void.
 		*/
-		DLL inline void trackTask(Task* t) { std::unique_lock<std::mutex> lock(taskMutex); tasks.push_back(t); };
+		DLL inline void trackTask(Task* t) { std::unique_lock<std::mutex> lock(taskMutex); tasks.insert(t); };
+
+		/**
+		* Get the number of tasks sent to this client that are waiting on results.
+		* @returns The number of tasks in flight on this client.
+		*/
+		DLL inline size_t getTaskCount() { std::unique_lock<std::mutex> lock(taskMutex); return tasks.size(); };
 
 		/**
 		* Get client ID.
@@ -1,5 +1,6 @@
 #include "ClientListener.h"
 #include "Client.h"
+#include "PacketPool.h"
 
 namespace cf
 {
@@ -37,7 +38,10 @@ namespace cf
 		if (!started) return;
 
 		//Set listening status to signal listener thread to shut down.
+		std::unique_lock<std::mutex> lock(client->connectionMutex);
 		listen = false;
+		lock.unlock();
+		client->connectionCondition.notify_all();
 
 		//Wait for the listening thread to shut down.
 		if (listenerThread.joinable()) listenerThread.join();
@@ -60,25 +64,36 @@ namespace cf
 
 			cf::WorkPacket packet;
 
-			//Enable compression if requested.
-			packet.setCompression(client->compression);
-
 			CF_SAY("Listener thread started. Waiting for data from host.", Settings::LogLevels::Info);
 			//Endless loop that waits for new connections.
 			//Aborts if listening flag is set false.
 			while (listen && !cf::ConsoleMessager::getInstance()->exceptionThrown)
 			{
-				//Skip checking socket if we're not connected to a host.
-				if (client->connected)
+				//Wait for a connection if we're not connected to a host.
+				//A timeout is set so the thread still responds to exceptions thrown elsewhere.
+				if (!client->connected)
+				{
+					std::unique_lock<std::mutex> connectionLock(client->connectionMutex);
+					client->connectionCondition.wait_for(connectionLock, std::chrono::milliseconds(100), 
+						[this] { return !listen || client->connected; });
+				}
+				else
 				{
 
 					//CF_SAY("Listening.");
 
-					//Attempt to get socket lock. Try again later if another process already has a lock on this socket.
-					//CF_SAY("listenThread incoming client data try lock.");
-					std::unique_lock<std::mutex> lock(client->socketMutex, std::try_to_lock);
-					if (lock.owns_lock())
+					//Make the selector wait for data from the host.
+					//The socket is added again each time as its handle changes when the client reconnects.
+					//A timeout is set to avoid locking the thread indefinitely.
+					selector.clear();
+					selector.add(client->socket);
+					if (selector.wait(sf::milliseconds(100)))
 					{
+						//Get socket lock. Waits if the sender thread is currently using the socket.
+						std::unique_lock<std::mutex> lock(client->socketMutex);
+
+						//Packets sent compressed are decompressed by the connection's compression engine.
+						packet.setCompressionEngine(&client->compressionEngine);
 
 						//Get socket status
 						status = (client->socket).receive(packet);
@@ -95,51 +110,7 @@ namespace cf
 
 							CF_SAY("Incoming data from host.", Settings::LogLevels::Debug);
 
-							if (packet.getFlag() == cf::WorkPacket::Flag::None)
-							{
-								CF_SAY("Received unknown packet from host.", Settings::LogLevels::Error);
-							}
-							else if (packet.getFlag() == cf::WorkPacket::Flag::Task)
-							{
-								CF_SAY("Received task packet from host.", Settings::LogLevels::Info);
-
-								std::string type;
-								std::string subType;
-
-								packet >> type;
-								packet >> subType;
-
-								if (type != "Task")
-								{
-									std::string s = "Received unknown packet from host.";
-									CF_SAY(s, Settings::LogLevels::Error);
-									CF_THROW(s);
-								}
-
-								//Check subtype exists in the constuction map.
-								if (client->taskConstructMap.size() == 0 ||
-									client->taskConstructMap.find(subType) == client->taskConstructMap.end()) {
-									std::string s = "Unknown subtype in packet from host.";
-									CF_SAY(s, Settings::LogLevels::Error);
-									CF_THROW(s);
-								}
-
-								//Instantiate the resulting derived class.
-								cf::Task *task = client->taskConstructMap[subType]();
-
-								task->deserialize(packet);
-
-								//Add task data to the client tasks queue.
-								std::unique_lock<std::mutex> lock2(client->taskQueueMutex);
-								client->taskQueue.push_back(task);
-								CF_SAY("Added task " + std::to_string(task->getInitialTaskID()) + " to queue.", Settings::LogLevels::Info);
-								lock2.unlock();
-
-							}
-							else
-							{
-								CF_THROW("Invalid flag data in packet from host. Are compression options set correctly on host and client?");
-							}
+							processPacket(packet);
 
 							packet.clear();
 						}
@@ -165,9 +136,6 @@ namespace cf
 						}
 					}
 				}
-
-				//Sleep before looping again.
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
 			}
 
 			listening = false;
@@ -185,4 +153,105 @@ namespace cf
 		}
 	}
 
+	void ClientListener::processPacket(WorkPacket &packet)
+	{
+		if (packet.hasReadError()) CF_THROW("Packet from host could not be decoded. Are compression options set correctly on host and client?");
+
+		if (packet.getFlag() == cf::WorkPacket::Flag::Chunk)
+		{
+			//Process the packet this is a piece of, once all its pieces have arrived.
+			cf::WorkPacket *whole = nullptr;
+			if (!client->chunkAssembler.add(packet, whole)) CF_THROW("Invalid chunk packet from host.");
+			if (whole != nullptr)
+			{
+				CF_SAY("Received all pieces of a large packet from host.", Settings::LogLevels::Debug);
+				processPacket(*whole);
+				CF_PACKETS->release(whole);
+				whole = nullptr;
+			}
+		}
+		else if (packet.getFlag() == cf::WorkPacket::Flag::None)
+		{
+			CF_SAY("Received unknown packet from host.", Settings::LogLevels::Error);
+		}
+		else if (packet.getFlag() == cf::WorkPacket::Flag::Task)
+		{
+			CF_SAY("Received task packet from host.", Settings::LogLevels::Info);
+
+			cf::Task *task = receiveTask(packet);
+
+			//Add task data to the client tasks queue.
+			std::unique_lock<std::mutex> lock2(client->taskQueueMutex);
+			client->taskQueue.push_back(task);
+			CF_SAY("Added task " + std::to_string(task->getInitialTaskID()) + " to queue.", Settings::LogLevels::Info);
+			lock2.unlock();
+
+			//Wake the task processing thread.
+			client->taskQueueCondition.notify_one();
+
+		}
+		else if (packet.getFlag() == cf::WorkPacket::Flag::Batch)
+		{
+			sf::Uint8 batchFlag;
+			packet >> batchFlag;
+
+			if (batchFlag != cf::WorkPacket::Flag::Task)
+			{
+				std::string s = "Received unknown batch packet from host.";
+				CF_SAY(s, Settings::LogLevels::Error);
+				CF_THROW(s);
+			}
+
+			//Unpack every task in the batch before queueing them together.
+			std::vector<cf::Task *> tasks;
+			while (!packet.endOfPacket()) tasks.push_back(receiveTask(packet));
+
+			CF_SAY("Received batch of " + std::to_string(tasks.size()) + " tasks from host.", Settings::LogLevels::Info);
+
+			//Add task data to the client tasks queue.
+			std::unique_lock<std::mutex> lock2(client->taskQueueMutex);
+			client->taskQueue.insert(client->taskQueue.end(), tasks.begin(), tasks.end());
+			lock2.unlock();
+
+			//Wake the task processing thread.
+			client->taskQueueCondition.notify_one();
+
+		}
+		else if (packet.getFlag() == cf::WorkPacket::Flag::Cancel)
+		{
+			sf::Uint64 taskID;
+			packet >> taskID;
+
+			CF_SAY("Received cancel packet from host for task " + std::to_string(taskID) + ".", Settings::LogLevels::Info);
+
+			client->cancelTask(taskID);
+		}
+		else
+		{
+			CF_THROW("Invalid flag data in packet from host. Are compression options set correctly on host and client?");
+		}
+	}
+
+	Task *ClientListener::receiveTask(WorkPacket &packet)
+	{
+		//Instantiate the resulting derived class named by the header.
+		cf::Task *task = client->taskTypes.readHeader(packet);
+
+		if (task == nullptr)
+		{
+			std::string s = "Unknown task type in packet from host.";
+			CF_SAY(s, Settings::LogLevels::Error);
+			CF_THROW(s);
+		}
+
+		task->deserialize(packet);
+
+		if (!packet || packet.hasReadError()) CF_THROW("Invalid task data in packet from host.");
+
+		//Record the task cancellation token, so the host can cancel the task.
+		client->trackCancellationToken(task);
+
+		return task;
+	}
+
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "DllExport.h"
 #include <SFML\Network.hpp>
 #include "ConsoleMessager.hpp"
+#include "WorkPacket.h"
+#include "Task.h"
 
 namespace cf
 {
@@ -59,6 +61,9 @@ namespace cf
 		//Connection listening thread.
 		std::thread listenerThread;
 
+		//Selector used to wait for data from the host.
+		sf::SocketSelector selector;
+
 		/**
 		* Listen for incoming connections and messages.
 		* To be used by a dedicated thread.
@@ -66,5 +71,19 @@ namespace cf
 		*/
 		void listenThread();
 
+		/**
+		* Process a packet received from the host.
+		* @param packet The packet to process.
+		* @returns void.
+		*/
+		void processPacket(WorkPacket &packet);
+
+		/**
+		* Read one task from a packet received from the host, and record its cancellation token.
+		* @param packet The packet to read the task from.
+		* @returns The new task, owned by the caller.
+		*/
+		Task *receiveTask(WorkPacket &packet);
+
 	};
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "ClientSender.h"
 #include "Client.h"
+#include "PacketPool.h"
 
 namespace cf
 {
@@ -12,6 +13,9 @@ namespace cf
 		sending = false;
 
 		started = false;
+
+		//Size at which no more results are added to a batch packet, in bytes.
+		maxBatchBytes = 65536;
 	}
 
 	ClientSender::~ClientSender()
@@ -37,7 +41,10 @@ namespace cf
 		if (!started) return;
 
 		//Set send status to signal sender thread to shut down.
+		std::unique_lock<std::mutex> lock(client->resultsQueueMutex);
 		send = false;
+		lock.unlock();
+		client->resultsQueueCondition.notify_all();
 
 		//Wait for the sender thread to shut down.
 		if (senderThread.joinable()) senderThread.join();
@@ -63,66 +70,111 @@ namespace cf
 			//Aborts if send flag is set false.
 			while (send && !cf::ConsoleMessager::getInstance()->exceptionThrown)
 			{
-				//Try to send one completed result object at a time.
-				//Only proceed if there are results to send, and we are connected to the host.
+				//Wait until there are results to send and we are connected to the host.
+				//A timeout is set so the thread still responds to exceptions thrown elsewhere.
 				std::unique_lock<std::mutex> lock(client->resultsQueueMutex);
-				cf::Result *result = client->resultQueueComplete.size() > 0 ? client->resultQueueComplete.front() : nullptr;
-				lock.unlock();
-				if (client->connected && result != nullptr)
+				client->resultsQueueCondition.wait_for(lock, std::chrono::milliseconds(100), 
+					[this] { return !send || (client->connected && client->resultQueueComplete.size() > 0); });
+
+				//Give more results a chance to complete, so they can be sent together in one batch packet.
+				unsigned int batchSize = client->batchSize;
+				if (send && client->resultQueueComplete.size() > 0 && client->resultQueueComplete.size() < batchSize && client->batchWindowMilliseconds > 0)
 				{
+					client->resultsQueueCondition.wait_for(lock, std::chrono::milliseconds(client->batchWindowMilliseconds),
+						[this, batchSize] { return !send || client->resultQueueComplete.size() >= batchSize; });
+				}
 
-					cf::WorkPacket packet(cf::WorkPacket::Flag::Result);
+				//Take up to a batch of completed results from the front of the queue.
+				//Only proceed if there are results to send, and we are connected to the host.
+				std::vector<cf::Result *> results;
+				for (auto &r : client->resultQueueComplete)
+				{
+					if (results.size() >= batchSize) break;
+					results.push_back(r);
+				}
+				lock.unlock();
+				if (client->connected && results.size() > 0)
+				{
 
-					//Enable compression if requested by host.
-					packet.setCompression(client->compression);
+					//A single result is sent in a packet of its own.
+					//Packets come from the packet pool, so their buffers keep their capacity from earlier results.
+					cf::WorkPacket *packet = CF_PACKETS->acquire(results.size() > 1 ? cf::WorkPacket::Flag::Batch : cf::WorkPacket::Flag::Result);
 
-					result->serialize(packet);
+					//Allow compression if agreed with the host. The engine decides whether each packet is worth compressing.
+					packet->setCompression(client->connectionCompression);
+					packet->setCompressionEngine(&client->compressionEngine);
 
-					CF_SAY("Sending results packet.", Settings::LogLevels::Info);
+					if (results.size() > 1) *packet << (sf::Uint8)cf::WorkPacket::Flag::Result;
 
-					//Packet send loop.
-					while (!cf::ConsoleMessager::getInstance()->exceptionThrown)
+					//Stop adding results once the packet is large enough. The rest are sent in the next packet.
+					size_t count = 0;
+					while (count < results.size() && (count == 0 || packet->getDataSize() < maxBatchBytes))
 					{
-						//Get socket lock and send packet.
-						std::unique_lock<std::mutex> lock2(client->socketMutex);
-						status = client->socket.send(packet);
-						lock2.unlock();
+						client->resultTypes.writeHeader(*packet, results[count]);
+						results[count]->serialize(*packet);
+						count++;
+					}
+					results.resize(count);
 
-						if (status == sf::Socket::Status::Done)
-						{
-							//Send was successful. delete result object from memory and from the completed results list.
-							std::unique_lock<std::mutex> lock3(client->resultsQueueMutex);
-							client->resultQueueComplete.erase(std::remove(client->resultQueueComplete.begin(),
-								client->resultQueueComplete.end(), result), client->resultQueueComplete.end());
-							lock3.unlock();
-							delete result;
-							result = nullptr;
-							CF_SAY("Packet sent.", Settings::LogLevels::Info);
-							break;
-						}
-						else if (status == sf::Socket::Status::Partial)
+					CF_SAY("Sending results packet with " + std::to_string(count) + " result(s).", Settings::LogLevels::Info);
+
+					//Large packets are sent in pieces. Each chunk packet is written once the one before it has been sent,
+					//so only one piece at a time is held in memory besides the packet.
+					std::size_t chunkSize = client->chunkSize;
+					if (packet->needsChunks(chunkSize))
+					{
+						cf::WorkPacket *frame = CF_PACKETS->acquire();
+						status = sf::Socket::Status::Done;
+						while (status == sf::Socket::Status::Done && packet->nextChunk(*frame, client->nextChunkMessageID, chunkSize))
 						{
-							//Sending only partially complete, so continue to loop.
+							status = sendPacket(*frame);
 						}
-						else if (status == sf::Socket::Status::Disconnected)
+						client->nextChunkMessageID++;
+
+						//A packet left part way through a send can't be reused.
+						if (status == sf::Socket::Status::Done) CF_PACKETS->release(frame);
+						else delete frame;
+						frame = nullptr;
+					}
+					else
+					{
+						status = sendPacket(*packet);
+					}
+
+					if (status == sf::Socket::Status::Done) CF_PACKETS->release(packet);
+					else delete packet;
+					packet = nullptr;
+
+					if (status == sf::Socket::Status::Done)
+					{
+						//Send was successful. delete result objects from memory and from the completed results list.
+						std::unique_lock<std::mutex> lock3(client->resultsQueueMutex);
+						for (auto &r : results)
 						{
-							//Disconnected while sending.
-							CF_SAY("Disconnected by host during send.", Settings::LogLevels::Error);
-							client->disconnect();
-							break;
+							client->resultQueueComplete.erase(std::remove(client->resultQueueComplete.begin(),
+								client->resultQueueComplete.end(), r), client->resultQueueComplete.end());
 						}
-						else
+						lock3.unlock();
+						for (auto &r : results)
 						{
-							//Error while sending.
-							CF_SAY("Error during send. Forcing reconnect.", Settings::LogLevels::Error);
-							client->disconnect();
-							break;
+							delete r;
+							r = nullptr;
 						}
+						CF_SAY("Packet sent.", Settings::LogLevels::Info);
+					}
+					else if (status == sf::Socket::Status::Disconnected)
+					{
+						//Disconnected while sending.
+						CF_SAY("Disconnected by host during send.", Settings::LogLevels::Error);
+						client->disconnect();
+					}
+					else if (status == sf::Socket::Status::Error)
+					{
+						//Error while sending.
+						CF_SAY("Error during send. Forcing reconnect.", Settings::LogLevels::Error);
+						client->disconnect();
 					}
 				}
-
-				//Sleep before looping again.
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
 			}
 
 			sending = false;
@@ -140,4 +192,35 @@ namespace cf
 		}
 	}
 
+	sf::Socket::Status ClientSender::sendPacket(WorkPacket &packet)
+	{
+		sf::Socket::Status status = sf::Socket::Status::NotReady;
+
+		//Packet send loop.
+		while (!cf::ConsoleMessager::getInstance()->exceptionThrown)
+		{
+			//Get socket lock and send packet.
+			std::unique_lock<std::mutex> lock(client->socketMutex);
+			status = client->socket.send(packet);
+			lock.unlock();
+
+			if (status == sf::Socket::Status::Done)
+			{
+				packet.onSent();
+				break;
+			}
+			else if (status == sf::Socket::Status::Partial || status == sf::Socket::Status::NotReady)
+			{
+				//Sending only partially complete, or the socket send buffer is full, so continue to loop.
+			}
+			else
+			{
+				//Disconnected or error while sending.
+				break;
+			}
+		}
+
+		return status;
+	}
+
 }
\ No newline at end of file
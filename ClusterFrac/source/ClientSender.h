@@ -8,6 +8,7 @@ namespace cf
 {
 	//Forward declarations.
 	class Client;
+	class WorkPacket;
 
 	/**
 	* ClientSender class. Manages the thread that sends messages to the host.
@@ -59,6 +60,9 @@ namespace cf
 		//Sending thread.
 		std::thread senderThread;
 
+		//Size at which no more results are added to a batch packet, in bytes.
+		size_t maxBatchBytes;
+
 		/**
 		* Send completed results to the host.
 		* To be used by a dedicated thread.
@@ -66,5 +70,12 @@ namespace cf
 		*/
 		void sendThread();
 
+		/**
+		* Send a packet to the host, waiting until it has been sent in full or the send fails.
+		* @param packet The packet to send.
+		* @returns The final socket status. Partial or NotReady if sending was abandoned because an exception was thrown elsewhere.
+		*/
+		sf::Socket::Status sendPacket(WorkPacket &packet);
+
 	};
 }
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "CompressionEngine.h"
+#include "WorkPacket.h"
+#include <algorithm>
+
+namespace cf
+{
+	CompressionEngine::CompressionEngine()
+	{
+		//Streams are only set up once there is something to compress or decompress.
+		deflaterReady = false;
+		inflaterReady = false;
+
+		level = Z_DEFAULT_COMPRESSION;
+		deflaterLevel = Z_DEFAULT_COMPRESSION;
+
+		maxDecompressedSize = DEFAULT_MAX_DECOMPRESSED_SIZE;
+
+		//Nothing has been measured yet.
+		linkBandwidth = 0;
+		linkSampleBytes = 0;
+		linkSampleSeconds = 0;
+		compressionThroughput = 0;
+		packetsSinceProbe = 0;
+	}
+
+	CompressionEngine::~CompressionEngine()
+	{
+		if (deflaterReady) deflateEnd(&deflater);
+		if (inflaterReady) inflateEnd(&inflater);
+	}
+
+	void CompressionEngine::setLevel(int newLevel)
+	{
+		if (newLevel != Z_DEFAULT_COMPRESSION && (newLevel < 0 || newLevel > 9)) CF_THROW("Invalid compression level.");
+
+		std::unique_lock<std::mutex> lock(deflateMutex);
+		level = newLevel;
+	}
+
+	int CompressionEngine::getLevel()
+	{
+		std::unique_lock<std::mutex> lock(deflateMutex);
+		return level;
+	}
+
+	void CompressionEngine::setDictionaries(const std::map<sf::Uint8, std::vector<sf::Uint8>> &newDictionaries)
+	{
+		std::unique_lock<std::mutex> lock(deflateMutex);
+		std::unique_lock<std::mutex> lock2(inflateMutex);
+
+		dictionaries.clear();
+		dictionariesByID.clear();
+		for (auto &d : newDictionaries)
+		{
+			if (d.second.size() == 0) continue;
+			if (d.second.size() > MAX_DICTIONARY_SIZE) CF_THROW("Compression dictionary is too large.");
+
+			dictionaries[d.first] = d.second;
+
+			//zlib identifies the dictionary a stream was compressed with by its Adler-32 checksum.
+			dictionariesByID[adler32(adler32(0L, Z_NULL, 0), d.second.data(), (uInt)d.second.size())] = d.second;
+		}
+	}
+
+	void CompressionEngine::compress(const void *data, std::size_t size, sf::Uint8 dictionaryFlag, std::vector<Bytef> &out)
+	{
+		//Zlib by default only supports 32 bits max for the size integer.
+		if (size > 0xFFFFFFFF) CF_THROW("Data too large to compress using Zlib.");
+
+		auto started = std::chrono::steady_clock::now();
+
+		std::unique_lock<std::mutex> lock(deflateMutex);
+
+		if (!deflaterReady)
+		{
+			deflater.zalloc = Z_NULL;
+			deflater.zfree = Z_NULL;
+			deflater.opaque = Z_NULL;
+			if (deflateInit(&deflater, level) != Z_OK) CF_THROW("Failed to start Zlib compression.");
+			deflaterReady = true;
+			deflaterLevel = level;
+		}
+		else
+		{
+			deflateReset(&deflater);
+		}
+
+		//The level can be changed before any data has been compressed.
+		if (deflaterLevel != level)
+		{
+			deflateParams(&deflater, level, Z_DEFAULT_STRATEGY);
+			deflaterLevel = level;
+		}
+
+		auto it = dictionaries.find(dictionaryFlag);
+		if (it != dictionaries.end()) deflateSetDictionary(&deflater, it->second.data(), (uInt)it->second.size());
+
+		uLong srcSize = (uLong)size;
+		uLong dstSize = deflateBound(&deflater, srcSize);
+
+		//Resize the buffer to accomodate the compressed data, plus four bytes for the uncompressed size.
+		out.resize(dstSize + 4);
+
+		//Store srcSize as the first four bytes of the buffer.
+		out[0] = srcSize & 0xFF;
+		out[1] = (srcSize >> 8) & 0xFF;
+		out[2] = (srcSize >> 16) & 0xFF;
+		out[3] = (srcSize >> 24) & 0xFF;
+
+		deflater.next_in = (Bytef *)data;
+		deflater.avail_in = (uInt)srcSize;
+		deflater.next_out = out.data() + 4;
+		deflater.avail_out = (uInt)dstSize;
+
+		if (deflate(&deflater, Z_FINISH) != Z_STREAM_END) CF_THROW("Zlib compression failed.");
+
+		out.resize(deflater.total_out + 4);
+		lock.unlock();
+
+		//Measure how well and how fast the data compressed.
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+		std::unique_lock<std::mutex> statsLock(statsMutex);
+		double &ratio = compressionRatios[dictionaryFlag];
+		ratio = blend(ratio, (double)out.size() / (double)std::max<std::size_t>(size, 1));
+		if (seconds > 0) compressionThroughput = blend(compressionThroughput, size / seconds);
+	}
+
+	bool CompressionEngine::decompress(const void *data, std::size_t size, std::vector<Bytef> &out)
+	{
+		if (size < 4)
+		{
+			CF_SAY("Compressed data is too small to hold its size.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		const Bytef *srcData = static_cast<const Bytef *>(data);
+
+		//Extract the uncompressed data size from the first four bytes.
+		sf::Uint32 uncompressedSize = srcData[3] << 24 | srcData[2] << 16 | srcData[1] << 8 | srcData[0];
+
+		//Refuse sizes too large to accept, before making room for them.
+		if (uncompressedSize > maxDecompressedSize)
+		{
+			CF_SAY("Compressed data claims a size of " + std::to_string(uncompressedSize) + " bytes, more than the limit of " 
+				+ std::to_string(maxDecompressedSize) + " bytes.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		std::unique_lock<std::mutex> lock(inflateMutex);
+
+		if (!inflaterReady)
+		{
+			inflater.zalloc = Z_NULL;
+			inflater.zfree = Z_NULL;
+			inflater.opaque = Z_NULL;
+			inflater.next_in = Z_NULL;
+			inflater.avail_in = 0;
+			if (inflateInit(&inflater) != Z_OK) CF_THROW("Failed to start Zlib decompression.");
+			inflaterReady = true;
+		}
+		else
+		{
+			inflateReset(&inflater);
+		}
+
+		out.resize(uncompressedSize);
+
+		inflater.next_in = (Bytef *)(srcData + 4);
+		inflater.avail_in = (uInt)(size - 4);
+		inflater.next_out = out.data();
+		inflater.avail_out = (uInt)uncompressedSize;
+
+		int status = inflate(&inflater, Z_FINISH);
+
+		//Data compressed with a preset dictionary asks for it by ID.
+		if (status == Z_NEED_DICT)
+		{
+			auto it = dictionariesByID.find(inflater.adler);
+			if (it == dictionariesByID.end())
+			{
+				CF_SAY("Compressed data uses an unknown dictionary. Are compression dictionaries set correctly on host and client?", Settings::LogLevels::Error);
+				return false;
+			}
+
+			inflateSetDictionary(&inflater, it->second.data(), (uInt)it->second.size());
+			status = inflate(&inflater, Z_FINISH);
+		}
+
+		//Check that the uncompressed size is the same as the size we were sent for the buffer.
+		if (status != Z_STREAM_END || inflater.total_out != uncompressedSize)
+		{
+			CF_SAY("Size mismatch during data decompression. Are compression options set correctly on host and client?", Settings::LogLevels::Error);
+			return false;
+		}
+
+		return true;
+	}
+
+	std::vector<sf::Uint8> CompressionEngine::trainDictionary(const std::vector<const WorkPacket *> &samples)
+	{
+		std::vector<sf::Uint8> dictionary;
+		for (auto &p : samples)
+		{
+			const sf::Uint8 *data = static_cast<const sf::Uint8 *>(p->getData());
+			dictionary.insert(dictionary.end(), data, data + p->getDataSize());
+		}
+
+		//Keep the end of the samples, which zlib can refer to most cheaply.
+		if (dictionary.size() > MAX_DICTIONARY_SIZE) dictionary.erase(dictionary.begin(), dictionary.end() - MAX_DICTIONARY_SIZE);
+
+		return dictionary;
+	}
+
+	bool CompressionEngine::shouldCompress(std::size_t size, sf::Uint8 dictionaryFlag)
+	{
+		if (size < MIN_COMPRESS_SIZE) return false;
+
+		std::unique_lock<std::mutex> lock(statsMutex);
+
+		bool probe = ++packetsSinceProbe >= PROBE_INTERVAL;
+		if (probe) packetsSinceProbe = 0;
+
+		//Compress until the compression ratio and speed have been measured.
+		auto it = compressionRatios.find(dictionaryFlag);
+		if (it == compressionRatios.end() || compressionThroughput <= 0) return true;
+
+		//Compress until the link speed has been measured, sending a packet as it is now and then to measure it.
+		if (linkBandwidth <= 0) return !probe;
+
+		//Compressing pays when the time saved on the link is more than the time spent compressing.
+		//Per byte: (1 - ratio) / linkBandwidth saved, against 1 / compressionThroughput spent.
+		bool compress = (1.0 - it->second) * compressionThroughput > linkBandwidth;
+
+		return probe ? !compress : compress;
+	}
+
+	void CompressionEngine::recordSend(std::size_t size, double seconds, bool blocked)
+	{
+		//Sends that never waited for the send buffer only show how fast the socket copies data.
+		if (!blocked || seconds <= 0) return;
+
+		std::unique_lock<std::mutex> lock(statsMutex);
+
+		//Gather sends until there are enough bytes that those sent straight in to the buffer count for little.
+		linkSampleBytes += size;
+		linkSampleSeconds += seconds;
+		if (linkSampleBytes < LINK_SAMPLE_SIZE) return;
+
+		linkBandwidth = blend(linkBandwidth, linkSampleBytes / linkSampleSeconds);
+		linkSampleBytes = 0;
+		linkSampleSeconds = 0;
+	}
+
+	double CompressionEngine::getLinkBandwidth()
+	{
+		std::unique_lock<std::mutex> lock(statsMutex);
+		return linkBandwidth;
+	}
+
+	double CompressionEngine::getCompressionThroughput()
+	{
+		std::unique_lock<std::mutex> lock(statsMutex);
+		return compressionThroughput;
+	}
+
+	double CompressionEngine::blend(double average, double sample)
+	{
+		//The first measurement stands on its own. After that, each new one counts for a quarter.
+		if (average <= 0) return sample;
+		return average * 0.75 + sample * 0.25;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,219 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <SFML\Network.hpp>
+#include <zlib.h>
+#include "DllExport.h"
+#include "ConsoleMessager.hpp"
+
+namespace cf
+{
+	class WorkPacket;
+
+	/**
+	* Compression engine class. Compresses and decompresses work packets for one connection,
+	* using a long lived zlib stream for each direction. The streams are reset rather than
+	* created for each packet, so their buffers are allocated once per connection.
+	* Each packet is still compressed on its own, so packets can be decompressed in any order.
+	* Packets can be compressed with a preset dictionary chosen by packet type. Dictionaries
+	* hold data typical of that type of packet, so small packets that mostly repeat the same
+	* headers compress well. Both ends of a connection must hold the same dictionaries.
+	* The engine also measures the link speed, its own compression speed and recent compression
+	* ratios, to decide for each packet whether compressing it saves more time on the link than
+	* it costs. Now and then it tries the other choice, so the measurements stay up to date.
+	* The link speed can only be seen through how fast the socket accepts data. While the socket
+	* send buffer has room, data is accepted at memory speed, so only sends that had to wait for
+	* a full send buffer are measured. Bytes that fitted in the buffer before the wait still count
+	* towards these sends, so the link speed is somewhat overestimated, less so the longer the
+	* connection stays busy. Connections that never fill their send buffer are never measured,
+	* and packets on them are compressed, as the link is then not what limits them.
+	* Thread safe.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class CompressionEngine
+	{
+
+	public:
+
+		//Largest dictionary zlib can use, in bytes.
+		static const std::size_t MAX_DICTIONARY_SIZE = 32768;
+
+		//Packets smaller than this, in bytes, are never compressed.
+		static const std::size_t MIN_COMPRESS_SIZE = 64;
+
+		//Bytes of sends that waited for a full send buffer to gather before the link speed is measured from them.
+		//Several times larger than a typical socket send buffer, so data that went straight in to the buffer counts for little.
+		static const std::size_t LINK_SAMPLE_SIZE = 4194304;
+
+		//One in this many packets is sent the other way to the current choice, to keep the measurements up to date.
+		static const unsigned int PROBE_INTERVAL = 32;
+
+		//Default largest size of a decompressed packet, in bytes.
+		static const std::size_t DEFAULT_MAX_DECOMPRESSED_SIZE = 1073741824;
+
+		/**
+		* Default constructor.
+		*/
+		DLL CompressionEngine();
+
+		/**
+		* Default destructor.
+		*/
+		DLL ~CompressionEngine();
+
+		/**
+		* Set the zlib compression level.
+		* @param newLevel The compression level, from 0 (no compression) to 9 (best compression), or Z_DEFAULT_COMPRESSION.
+		* @returns void.
+		*/
+		DLL void setLevel(int newLevel);
+
+		/**
+		* Get the zlib compression level.
+		* @returns The compression level.
+		*/
+		DLL int getLevel();
+
+		/**
+		* Set the preset dictionaries, replacing any set before.
+		* @param newDictionaries The dictionaries, by the WorkPacket flag of the packets they are used for.
+		* Batch packets use the dictionary for the type of packet they hold.
+		* @returns void.
+		*/
+		DLL void setDictionaries(const std::map<sf::Uint8, std::vector<sf::Uint8>> &newDictionaries);
+
+		/**
+		* Compress data.
+		* The compressed data is stored after a four byte little endian copy of the uncompressed size.
+		* @param data The data to compress.
+		* @param size The size of the data, in bytes.
+		* @param dictionaryFlag The WorkPacket flag used to choose a preset dictionary.
+		* @param out The buffer to store the compressed data in. It is resized to fit the data.
+		* @returns void.
+		*/
+		DLL void compress(const void *data, std::size_t size, sf::Uint8 dictionaryFlag, std::vector<Bytef> &out);
+
+		/**
+		* Decompress data compressed by compress.
+		* The data comes from the other end of the connection, so it is checked rather than trusted.
+		* @param data The compressed data.
+		* @param size The size of the compressed data, in bytes.
+		* @param out The buffer to store the uncompressed data in. It is resized to fit the data.
+		* @returns True if the data was decompressed, false if it is malformed, uses an unknown dictionary,
+		* or claims to be larger than the largest decompressed size.
+		*/
+		DLL bool decompress(const void *data, std::size_t size, std::vector<Bytef> &out);
+
+		/**
+		* Set the largest size of a decompressed packet. Room for the decompressed data is made before it is
+		* decompressed, so this stops a small packet from claiming a huge size.
+		* @param bytes The largest decompressed size, in bytes.
+		* @returns void.
+		*/
+		DLL inline void setMaxDecompressedSize(std::size_t bytes) { maxDecompressedSize = bytes; };
+
+		/**
+		* Get the largest size of a decompressed packet.
+		* @returns The largest decompressed size, in bytes.
+		*/
+		DLL inline std::size_t getMaxDecompressedSize() const { return maxDecompressedSize; };
+
+		/**
+		* Decide whether a packet about to be sent should be compressed.
+		* Packets are compressed until the engine has measured enough to decide.
+		* @param size The size of the packet, in bytes.
+		* @param dictionaryFlag The WorkPacket flag used to choose a preset dictionary. Compression ratios are tracked for each flag.
+		* @returns True if the packet should be compressed, false if it should be sent as it is.
+		*/
+		DLL bool shouldCompress(std::size_t size, sf::Uint8 dictionaryFlag);
+
+		/**
+		* Record that a packet has been sent in full, to measure the link speed.
+		* Only sends that had to wait for a full socket send buffer are measured, see the class description.
+		* @param size The number of bytes sent.
+		* @param seconds The time taken to send them, from the first send call.
+		* @param blocked True if the send had to wait for room in the socket send buffer.
+		* @returns void.
+		*/
+		DLL void recordSend(std::size_t size, double seconds, bool blocked);
+
+		/**
+		* Get the measured link speed.
+		* @returns The link speed in bytes per second, or zero if it hasn't been measured yet.
+		*/
+		DLL double getLinkBandwidth();
+
+		/**
+		* Get the measured compression speed.
+		* @returns The compression speed in uncompressed bytes per second, or zero if it hasn't been measured yet.
+		*/
+		DLL double getCompressionThroughput();
+
+		/**
+		* Build a preset dictionary from typical packets.
+		* Strings zlib finds near the end of a dictionary are cheaper to refer to, so later samples
+		* should be the most typical.
+		* @param samples The packets to build the dictionary from.
+		* @returns The dictionary, up to MAX_DICTIONARY_SIZE bytes long.
+		*/
+		DLL static std::vector<sf::Uint8> trainDictionary(const std::vector<const WorkPacket *> &samples);
+
+	private:
+
+		//Stream used to compress outgoing packets, and has it been initialised?
+		z_stream deflater;
+		bool deflaterReady;
+
+		//Stream used to decompress incoming packets, and has it been initialised?
+		z_stream inflater;
+		bool inflaterReady;
+
+		//Compression level to use, and the level the compression stream is set to.
+		int level;
+		int deflaterLevel;
+
+		//Preset dictionaries by the WorkPacket flag of the packets they are used for.
+		std::map<sf::Uint8, std::vector<sf::Uint8>> dictionaries;
+
+		//Largest size of a decompressed packet, in bytes.
+		std::atomic<std::size_t> maxDecompressedSize;
+
+		//Preset dictionaries by their zlib dictionary ID, for decompression.
+		std::unordered_map<uLong, std::vector<sf::Uint8>> dictionariesByID;
+
+		//Mutexes for the compression and decompression streams. Both are locked to change dictionaries.
+		std::mutex deflateMutex;
+		std::mutex inflateMutex;
+
+		//Recent link speed in bytes per second, or zero if not measured yet.
+		double linkBandwidth;
+
+		//Bytes and time of sends that waited for a full send buffer, gathered since the last link speed measurement.
+		double linkSampleBytes;
+		double linkSampleSeconds;
+
+		//Recent compression speed in uncompressed bytes per second, or zero if not measured yet.
+		double compressionThroughput;
+
+		//Recent compressed size as a fraction of uncompressed size, by the WorkPacket flag of the packets compressed.
+		std::map<sf::Uint8, double> compressionRatios;
+
+		//Packets decided on since the last one sent the other way to the current choice.
+		unsigned int packetsSinceProbe;
+
+		//Mutex for measurements.
+		std::mutex statsMutex;
+
+		/**
+		* Blend a new measurement into a recent average.
+		* @param average The recent average, or zero if there is none yet.
+		* @param sample The new measurement.
+		* @returns The new recent average.
+		*/
+		static double blend(double average, double sample);
+	};
+}
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 namespace cf
 {
+	const unsigned __int64 Host::HOST_AS_CLIENT_NODE_ID;
+
 	Host::Host()
 	{
 
@@ -19,11 +21,42 @@ namespace cf
 		//Default busy status.
 		busy = false;
 
+		hostAsClientTasksInProgress = 0;
+
+		//Speculative execution of straggling task parts is off by default.
+		speculativeExecution = false;
+		speculationFactor = 1.5;
+		maxPartCompletionTimes = 100;
+
+		//Node throughput is unknown until tasks have been completed.
+		hostAsClientThroughput = 0;
+		throughputSmoothing = 0.3;
+
+		taskEventPending = false;
+
 		//Max benchmark elapsed times to store.
 		maxBenchmarkTimes = 100;
 
 		//Default network compression status for the host.
 		compression = false;
+		compressionLevel = Z_DEFAULT_COMPRESSION;
+
+		//Default number of task parts in flight per client.
+		clientTaskWindow = 2;
+
+		//Tasks queued for a client together are sent together, without waiting for more.
+		batchSize = 16;
+		batchWindowMilliseconds = 0;
+
+		//Packets over a megabyte are sent in pieces.
+		chunkSize = 1048576;
+
+		//Packets from clients over a gigabyte are refused.
+		maxPacketSize = (std::size_t)ChunkAssembler::DEFAULT_MAX_MESSAGE_SIZE;
+
+		//Result sets are merged on a few threads of their own, in steps of at most 16 results.
+		mergeThreads = std::max(2u, std::thread::hardware_concurrency() / 4);
+		mergeFanIn = 16;
 
 	}
 	
@@ -47,7 +80,17 @@ namespace cf
 		//Reset time since startup.
 		clock.restart();
 
+		//Detect host capabilities to send to clients as they connect.
+		capabilities = NodeCapabilities::getLocal(MAX_THREADS);
+		CF_SAY("Host calibration score " + std::to_string(capabilities.calibrationScore) + ", SIMD features: " 
+			+ capabilities.getSIMDFeaturesString() + ".", Settings::LogLevels::Info);
+
+		//Start the merge threads before anything can deliver results.
+		mergePool.start(mergeThreads);
+
 		CF_SAY("Starting ClusterFrac HOST at " + sf::IpAddress::getLocalAddress().toString() + " on port " + std::to_string(port) + ".", Settings::LogLevels::Info);
+		sender.start();
+
 		listener.start();
 
 		watcher.start();
@@ -55,6 +98,8 @@ namespace cf
 		//Launch host as client task processing thread.
 		if (hostAsClient)
 		{
+			hostAsClientTaskPool.start(MAX_THREADS);
+
 			hostAsClientTaskProcessThreadRun = true;
 			hostAsClientTaskProcessingThread = std::thread([this] { hostAsClientProcessTaskThread(); });
 		}
@@ -65,18 +110,32 @@ namespace cf
 		if (hostAsClientTaskProcessThreadRun)
 		{
 			//Shut down host as client processing.
+			std::unique_lock<std::mutex> lock(localHostAsClientTaskQueueMutex);
 			hostAsClientTaskProcessThreadRun = false;
+			lock.unlock();
+			localHostAsClientTaskQueueCondition.notify_all();
 
 			//Wait for host as client task processing thread to finish.
 			if (hostAsClientTaskProcessingThread.joinable()) hostAsClientTaskProcessingThread.join();
 		}
 
+		//Stop the host as client thread pool. Task parts already handed to the pool are finished first,
+		//so their tasks are completed and no longer in flight.
+		hostAsClientTaskPool.stop(true);
+
 		//Stop the listener.
 		listener.stop();
 
 		//Stop the task status watcher.
 		watcher.stop();
 
+		//Stop the merge threads once nothing else can deliver results. Merges still queued are run first,
+		//as each merge job holds the results it merges.
+		mergePool.stop(true);
+
+		//Stop the sender once nothing else can queue messages. Unsent messages are deleted with their clients.
+		sender.stop();
+
 		//Clean up any remaining registered clients.
 		std::unique_lock<std::mutex> clientsLock(clientsMutex);
 		for (auto &c : clients)
@@ -98,14 +157,49 @@ namespace cf
 		//pointer is recorded in two places due to an unusual shutdown.
 		//Unordered set will ignore duplicate entries.
 
+		std::unique_lock<std::mutex> subTaskQueueLock(subTaskQueueMutex);
+		for (auto &s : taskSchedulers) delete s;
+		taskSchedulers.clear();
+		subTaskQueueLock.unlock();
+
 		std::unordered_set<Task *> removeTasks;
 		for (auto &t : localHostAsClientTaskQueue) removeTasks.insert(t);
 		for (auto &t : taskQueue) removeTasks.insert(t);
+		std::unique_lock<std::mutex> inFlightLock(inFlightTasksMutex);
+		for (auto &t : inFlightTasks)
+		{
+			//Tasks still assigned to clients were deleted along with the clients.
+			if (t.second.client == nullptr) removeTasks.insert(t.second.task);
+		}
+		inFlightTasks.clear();
+		for (auto &b : backupTasks)
+		{
+			for (auto &c : b.second)
+			{
+				if (c.client == nullptr) removeTasks.insert(c.task);
+			}
+		}
+		backupTasks.clear();
+		inFlightLock.unlock();
+		std::unique_lock<std::mutex> cancelledLock(cancelledTasksMutex);
+		cancelledTaskIDs.clear();
+		cancelsPending.clear();
+		cancelledHostTasks.clear();
+		cancelledLock.unlock();
 		for (auto &t : removeTasks) delete t;
 
+		//Wake anything waiting on tasks that will now never complete, and delete completed results
+		//that are not held by a task handle.
+		std::unique_lock<std::mutex> statesLock(taskStatesMutex);
+		for (auto &ts : taskStates) ts.second->setAbandoned();
+		taskStates.clear();
+		statesLock.unlock();
+
 		std::unordered_set<Result *> removeResults;
-		for (auto &r : resultQueueComplete) removeResults.insert(r);
-		for (auto &r : resultQueueIncomplete) removeResults.insert(r);
+		std::unique_lock<std::mutex> incompleteLock(resultsQueueIncompleteMutex);
+		for (auto &r : incompleteResults.clear()) removeResults.insert(r);
+		mergesInProgress.clear();
+		incompleteLock.unlock();
 		for (auto &r : removeResults) delete r;
 	}
 
@@ -123,13 +217,278 @@ namespace cf
 		};
 	}
 
-	void Host::addTaskToQueue(Task *task)
+	TaskHandle Host::addTaskToQueue(Task *task, TaskState::PartCallback partCallback)
 	{
 		//Ensure this task has an ID assigned.
 		task->assignID();
+
+		//Create the completion state shared with the task handle.
+		//The handle is created before the task is queued, so the task can't complete before the host knows a handle holds it.
+		std::shared_ptr<TaskState> state = std::make_shared<TaskState>(task->getInitialTaskID());
+		TaskHandle handle(state);
+
+		//Ask the nodes to stream partial results if the application wants results as they arrive.
+		if (partCallback)
+		{
+			state->partCallback = partCallback;
+			task->setStreamResults(true);
+		}
+
+		std::unique_lock<std::mutex> statesLock(taskStatesMutex);
+		taskStates[task->getInitialTaskID()] = state;
+		statesLock.unlock();
+
+		//Record when the task was added, so its deadline can be measured from then.
+		task->setHostTimeAdded(getTime());
+
 		std::unique_lock<std::mutex> lock(taskQueueMutex);
 		taskQueue.push_back(task);
 		CF_SAY("Added task " + std::to_string(task->getInitialTaskID()) + " to queue.", Settings::LogLevels::Info);
+		lock.unlock();
+
+		//Wake the task watcher to send the new task.
+		notifyTaskEvent();
+
+		return handle;
+	}
+
+	void Host::setTaskPriority(unsigned __int64 taskID, Task::Priorities priority)
+	{
+		std::unique_lock<std::mutex> taskQueueLock(taskQueueMutex);
+		for (auto &t : taskQueue)
+		{
+			if (t->getInitialTaskID() == taskID) t->setPriority(priority);
+		}
+		taskQueueLock.unlock();
+
+		std::unique_lock<std::mutex> subTaskQueueLock(subTaskQueueMutex);
+		for (auto &t : subTaskQueue)
+		{
+			if (t->getInitialTaskID() == taskID) t->setPriority(priority);
+		}
+		for (auto &s : taskSchedulers)
+		{
+			if (s->getInitialTaskID() == taskID) s->setPriority(priority);
+		}
+		subTaskQueueLock.unlock();
+
+		//Wake the task watcher, as the task may now be sent to nodes that are not idle.
+		notifyTaskEvent();
+	}
+
+	bool Host::cancelTask(unsigned __int64 taskID)
+	{
+		//Only tasks that have not yet completed can be cancelled.
+		std::shared_ptr<TaskState> state = getTaskState(taskID);
+		if (!state || !state->setCancelled()) return false;
+
+		CF_SAY("Cancelling task " + std::to_string(taskID) + ".", Settings::LogLevels::Info);
+
+		std::unique_lock<std::mutex> lock(cancelledTasksMutex);
+		cancelledTaskIDs.insert(taskID);
+		cancelsPending.push_back(taskID);
+		lock.unlock();
+
+		//Discard result parts that have already arrived.
+		std::unique_lock<std::mutex> resultsLock(resultsQueueIncompleteMutex);
+		std::vector<Result *> parts = incompleteResults.remove(taskID);
+		resultsLock.unlock();
+		for (auto &r : parts)
+		{
+			delete r;
+			r = nullptr;
+		}
+
+		//The task will never have a result, so its state is no longer needed.
+		std::unique_lock<std::mutex> statesLock(taskStatesMutex);
+		taskStates.erase(taskID);
+		statesLock.unlock();
+
+		//Wake the task watcher to remove the parts of the task.
+		notifyTaskEvent();
+
+		return true;
+	}
+
+	bool Host::isTaskCancelled(unsigned __int64 taskID)
+	{
+		std::unique_lock<std::mutex> lock(cancelledTasksMutex);
+		return cancelledTaskIDs.count(taskID) > 0;
+	}
+
+	void Host::deliverPartialResult(Result *partial)
+	{
+		std::shared_ptr<TaskState> state = getTaskState(partial->getInitialTaskID());
+
+		//Partial results are only wanted while their task is still running.
+		if (state && state->partCallback && !state->complete && !isTaskCancelled(partial->getInitialTaskID()))
+		{
+			state->partCallback(*partial, false);
+		}
+
+		delete partial;
+		partial = nullptr;
+	}
+
+	void Host::purgeCancelledTasks()
+	{
+		std::unique_lock<std::mutex> lock(cancelledTasksMutex);
+		if (cancelsPending.size() == 0) return;
+		std::unordered_set<unsigned __int64> taskIDs(cancelsPending.begin(), cancelsPending.end());
+		cancelsPending.clear();
+		lock.unlock();
+
+		std::vector<Task *> removeTasks;
+
+		//Remove parts of the tasks still waiting to be sent.
+		std::unique_lock<std::mutex> taskQueueLock(taskQueueMutex);
+		for (auto it = taskQueue.begin(); it != taskQueue.end();)
+		{
+			if (taskIDs.count((*it)->getInitialTaskID()) > 0)
+			{
+				removeTasks.push_back(*it);
+				it = taskQueue.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		taskQueueLock.unlock();
+
+		std::unique_lock<std::mutex> subTaskQueueLock(subTaskQueueMutex);
+		for (auto it = subTaskQueue.begin(); it != subTaskQueue.end();)
+		{
+			if (taskIDs.count((*it)->getInitialTaskID()) > 0)
+			{
+				removeTasks.push_back(*it);
+				it = subTaskQueue.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		for (auto it = taskSchedulers.begin(); it != taskSchedulers.end();)
+		{
+			if (taskIDs.count((*it)->getInitialTaskID()) > 0)
+			{
+				delete *it;
+				it = taskSchedulers.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		subTaskQueueLock.unlock();
+
+		//Remove parts of the tasks that have been sent, and any backup copies of them.
+		std::vector<InFlightTask> cancelled;
+		std::unique_lock<std::mutex> inFlightLock(inFlightTasksMutex);
+		for (auto it = inFlightTasks.begin(); it != inFlightTasks.end();)
+		{
+			if (taskIDs.count(it->first.initialTaskID) > 0)
+			{
+				cancelled.push_back(it->second);
+				it = inFlightTasks.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		for (auto it = backupTasks.begin(); it != backupTasks.end();)
+		{
+			if (taskIDs.count(it->first.initialTaskID) > 0)
+			{
+				cancelled.insert(cancelled.end(), it->second.begin(), it->second.end());
+				it = backupTasks.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		//Record the parts held by the host-as-client before cancelling them, so their tasks are not retired
+		//while they are still running.
+		std::unique_lock<std::mutex> cancelledLock(cancelledTasksMutex);
+		for (auto &c : cancelled)
+		{
+			if (c.client == nullptr) cancelledHostTasks.insert(c.task);
+		}
+		cancelledLock.unlock();
+
+		//Clients to tell to stop processing each task.
+		std::vector<std::pair<ClientDetails *, unsigned __int64>> clientCancels;
+		for (auto &c : cancelled)
+		{
+			if (c.client != nullptr)
+			{
+				std::unique_lock<std::mutex> taskLock(c.client->taskMutex);
+				c.client->tasks.erase(c.task);
+				taskLock.unlock();
+
+				std::pair<ClientDetails *, unsigned __int64> clientCancel(c.client, c.task->getInitialTaskID());
+				if (std::find(clientCancels.begin(), clientCancels.end(), clientCancel) == clientCancels.end()) clientCancels.push_back(clientCancel);
+
+				removeTasks.push_back(c.task);
+			}
+			else
+			{
+				//The host-as-client deletes its tasks once it finishes with them.
+				c.task->cancel();
+			}
+		}
+		inFlightLock.unlock();
+
+		for (auto &t : removeTasks)
+		{
+			delete t;
+			t = nullptr;
+		}
+
+		for (auto &c : clientCancels) sender.sendCancel(c.first, c.second);
+
+		//Late results from clients are now discarded as their parts are no longer in flight, so tasks with
+		//nothing left running can be forgotten.
+		std::unique_lock<std::mutex> resultsLock(resultsQueueIncompleteMutex);
+		for (auto &id : taskIDs) retireCancelledTask(id);
+	}
+
+	void Host::retireCancelledTask(unsigned __int64 taskID)
+	{
+		//Merges in progress may still produce a result for the task.
+		if (mergesInProgress.count(taskID) > 0) return;
+
+		std::unique_lock<std::mutex> lock(cancelledTasksMutex);
+		if (cancelledTaskIDs.count(taskID) == 0) return;
+
+		//The parts of the task have not been removed yet.
+		if (std::find(cancelsPending.begin(), cancelsPending.end(), taskID) != cancelsPending.end()) return;
+
+		//The host-as-client is still processing part of the task.
+		for (auto &t : cancelledHostTasks)
+		{
+			if (t->getInitialTaskID() == taskID) return;
+		}
+
+		cancelledTaskIDs.erase(taskID);
+		lock.unlock();
+
+		CF_SAY("Retired cancelled task " + std::to_string(taskID) + ".", Settings::LogLevels::Debug);
+	}
+
+	void Host::finishMerge(unsigned __int64 taskID)
+	{
+		std::unique_lock<std::mutex> lock(resultsQueueIncompleteMutex);
+		auto it = mergesInProgress.find(taskID);
+		if (it == mergesInProgress.end() || --it->second > 0) return;
+		mergesInProgress.erase(it);
+
+		//The task may have been cancelled while this was its last merge.
+		retireCancelledTask(taskID);
 	}
 
 	bool Host::divideTasksIntoSubTaskQueue()
@@ -153,16 +512,74 @@ namespace cf
 
 		//Divide tasks among clients.
 		std::vector<Task *> tmpSubTaskQueue;
+		std::vector<TaskScheduler *> tmpTaskSchedulers;
 		std::vector<Task *> dividedTasks;
 
+		//Get the throughput estimate and calibrated capacity of every node that can take tasks.
+		std::vector<unsigned __int64> remoteNodeIDs;
+		std::vector<double> remoteNodeThroughputs;
+		std::vector<double> remoteNodeCapacities;
+		std::unique_lock<std::mutex> clientsLock(clientsMutex);
+		for (auto &client : clients)
+		{
+			if (client->remove || !client->handshakeComplete) continue;
+			remoteNodeIDs.push_back(client->getClientID());
+			remoteNodeThroughputs.push_back(client->throughput);
+			remoteNodeCapacities.push_back(client->capabilities.getCapacity());
+		}
+		clientsLock.unlock();
+
 		CF_SAY("Dividing tasks among clients.", Settings::LogLevels::Info);
 		for (auto &task : taskQueue)
 		{
-			//Only divide task if there's more than one client, and the task allows itself to be split,
+			//Nodes this task may be sent to. The host-as-client only takes remote tasks if there are no remote clients,
+			//in which case there is only one node and the task isn't split.
+			std::vector<unsigned __int64> nodeIDs = remoteNodeIDs;
+			std::vector<double> weights = remoteNodeThroughputs;
+			std::vector<double> capacities = remoteNodeCapacities;
+			if (hostAsClient && task->getNodeTargetType() == cf::Task::NodeTargetTypes::Any)
+			{
+				nodeIDs.push_back(HOST_AS_CLIENT_NODE_ID);
+				weights.push_back(hostAsClientThroughput);
+				capacities.push_back(capabilities.getCapacity());
+			}
+
+			//Only divide task if there's more than one node, and the task allows itself to be split,
 			//and allows itself to be run on remote clients. Otherwise just use pointer to the original task.
-			if (task->allowNodeTaskSplit && task->getNodeTargetType() != cf::Task::NodeTargetTypes::Local && clientCount > 1)
+			if (task->allowNodeTaskSplit && task->getNodeTargetType() != cf::Task::NodeTargetTypes::Local && nodeIDs.size() > 1
+				&& task->getSchedulingMode() != cf::Task::SchedulingModes::Static)
+			{
+				//Tasks using a dynamic scheduling mode are handed out to nodes in chunks as the nodes have room for them.
+				//The number of parts grows as chunks are handed out.
+				std::shared_ptr<TaskState> state = getTaskState(task->getInitialTaskID());
+				if (state) state->partsTotal = 0;
+
+				tmpTaskSchedulers.push_back(new TaskScheduler(task, (unsigned int)nodeIDs.size(), true));
+				task = nullptr;
+				continue;
+			}
+			else if (task->allowNodeTaskSplit && task->getNodeTargetType() != cf::Task::NodeTargetTypes::Local && nodeIDs.size() > 1)
 			{
-				dividedTasks = task->split(clientCount);
+				//Until any node has completed a task, use the capacity each node measured during the connection handshake.
+				if (std::all_of(weights.begin(), weights.end(), [](double w) { return w <= 0; })) weights = capacities;
+
+				//Nodes that have not completed a task yet are given the average throughput of the other nodes.
+				//If no throughputs are known the task is split equally.
+				double knownTotal = 0;
+				int knownCount = 0;
+				for (auto &w : weights)
+				{
+					if (w > 0) { knownTotal += w; knownCount++; }
+				}
+				for (auto &w : weights)
+				{
+					if (w <= 0) w = knownCount > 0 ? knownTotal / knownCount : 1.0;
+				}
+
+				//Split the task in proportion to the throughput of each node, and mark each part for its node.
+				dividedTasks = task->splitWeighted(weights);
+				for (size_t i = 0; i < dividedTasks.size(); i++) dividedTasks[i]->setPreferredNodeID(nodeIDs[i]);
+
 				//Remove original task from memory.
 				delete task;
 				task = nullptr;
@@ -173,6 +590,11 @@ namespace cf
 				//We DON'T remove the original task queue pointer object from memory here as we'll keep using it.
 				dividedTasks = std::vector<Task *>{task};
 			}
+
+			//Record the number of parts for progress reporting.
+			std::shared_ptr<TaskState> state = getTaskState(dividedTasks.front()->getInitialTaskID());
+			if (state) state->partsTotal = (unsigned int)dividedTasks.size();
+
 			tmpSubTaskQueue.insert(tmpSubTaskQueue.end(), dividedTasks.begin(), dividedTasks.end());
 		}
 
@@ -184,46 +606,119 @@ namespace cf
 		//Add sub tasks to sub task queue. 
 		std::unique_lock<std::mutex> subTaskQueueLock(subTaskQueueMutex);
 		subTaskQueue.insert(subTaskQueue.end(), tmpSubTaskQueue.begin(), tmpSubTaskQueue.end());
+		taskSchedulers.insert(taskSchedulers.end(), tmpTaskSchedulers.begin(), tmpTaskSchedulers.end());
 		subTaskQueueLock.unlock();
 
 		return true;
 	}
 
+	void Host::scheduleChunks()
+	{
+		std::unique_lock<std::mutex> subTaskQueueLock(subTaskQueueMutex);
+		if (taskSchedulers.size() == 0) return;
+		size_t waitingCount = subTaskQueue.size();
+		subTaskQueueLock.unlock();
+
+		//Count the free places in the task windows of the nodes, and the nodes with no tasks.
+		size_t freeCount = 0;
+		size_t idleCount = 0;
+		std::unique_lock<std::mutex> clientsLock(clientsMutex);
+		for (auto &client : clients)
+		{
+			if (client->remove || !client->handshakeComplete) continue;
+			size_t taskCount = client->getTaskCount();
+			if (taskCount < clientTaskWindow) freeCount += clientTaskWindow - taskCount;
+			if (taskCount == 0) idleCount++;
+		}
+		clientsLock.unlock();
+		if (hostAsClient && !busy)
+		{
+			freeCount++;
+			idleCount++;
+		}
+
+		//Sub tasks already waiting will take the first free places, starting with idle nodes.
+		if (freeCount <= waitingCount) return;
+		freeCount -= waitingCount;
+		idleCount -= std::min(idleCount, waitingCount);
+
+		//Take chunks from the most urgent tasks first. The sort is stable, so tasks of equal urgency are taken oldest first.
+		subTaskQueueLock.lock();
+		taskSchedulers.sort([](const TaskScheduler *a, const TaskScheduler *b)
+		{
+			return isMoreUrgent(a->getPriority(), a->getHostDeadline(), b->getPriority(), b->getHostDeadline());
+		});
+		auto it = taskSchedulers.begin();
+		while (freeCount > 0 && it != taskSchedulers.end())
+		{
+			TaskScheduler *scheduler = *it;
+
+			//Background tasks only fill nodes that would otherwise be idle. All tasks after this one are background tasks too.
+			size_t count = scheduler->getPriority() < Task::Priorities::Normal ? std::min(freeCount, idleCount) : freeCount;
+			if (count == 0) break;
+
+			std::vector<Task *> chunks = scheduler->next((unsigned int)count);
+
+			//Record the number of parts handed out so far for progress reporting.
+			std::shared_ptr<TaskState> state = getTaskState(scheduler->getInitialTaskID());
+			if (state) state->partsTotal += (unsigned int)chunks.size();
+
+			subTaskQueue.insert(subTaskQueue.end(), chunks.begin(), chunks.end());
+			freeCount -= std::min(freeCount, chunks.size());
+			idleCount -= std::min(idleCount, chunks.size());
+
+			if (scheduler->isFinished())
+			{
+				delete scheduler;
+				scheduler = nullptr;
+				it = taskSchedulers.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		subTaskQueueLock.unlock();
+	}
+
+	bool Host::isMoreUrgent(Task::Priorities priorityA, sf::Time deadlineA, Task::Priorities priorityB, sf::Time deadlineB)
+	{
+		if (priorityA != priorityB) return priorityA > priorityB;
+
+		//Work with a deadline comes before work without one.
+		if (deadlineA == sf::Time::Zero || deadlineB == sf::Time::Zero) return deadlineA != sf::Time::Zero && deadlineB == sf::Time::Zero;
+
+		return deadlineA < deadlineB;
+	}
+
 	void Host::addResultToQueue(Result *result)
 	{
-		std::unique_lock<std::mutex> lock(resultsQueueIncompleteMutex);
-		resultQueueIncomplete.push_back(result);
 		CF_SAY("Added result to queue.", Settings::LogLevels::Info);
+		checkForCompleteResults(result);
 	}
 
 	void Host::removeResultFromQueue(Result *result)
 	{
-		//Aquire lock on result queues.
-		std::unique_lock<std::mutex> lock(resultsQueueCompleteMutex);
-		if (std::find(resultQueueComplete.begin(), resultQueueComplete.end(), result) == resultQueueComplete.end())
+		std::unique_lock<std::mutex> lock(taskStatesMutex);
+		auto it = taskStates.find(result->getInitialTaskID());
+		if (it == taskStates.end() || it->second->result.get() != result)
 		{
 			CF_THROW("Remove failed. Cannot find that result in the completed results queue.");
 		}
-		resultQueueComplete.erase(std::remove(resultQueueComplete.begin(), resultQueueComplete.end(), result), 
-			resultQueueComplete.end());
-		delete result;
+
+		//Removing the task state deletes the result.
+		taskStates.erase(it);
 	}
 
 	Result *Host::getAvailableResult(unsigned __int64 taskID)
 	{
-		//Aquire lock on result queues.
-		std::unique_lock<std::mutex> lock(resultsQueueCompleteMutex);
+		std::shared_ptr<TaskState> state = getTaskState(taskID);
 
-		if (resultQueueComplete.size() > 0)
-		{
-			for (auto &r : resultQueueComplete)
-			{
-				if (r->getInitialTaskID() == taskID) return r;
-			}
-		}
-		
 		//No such task ID found.
-		return nullptr;
+		if (!state) return nullptr;
+
+		std::unique_lock<std::mutex> lock(state->stateMutex);
+		return state->result.get();
 	}
 
 	void Host::setHostAsClient(bool state)
@@ -238,21 +733,29 @@ namespace cf
 			//Start processing thread if it has not already been started, and the host is being set to process tasks locally.
 			if (hostAsClientTaskProcessThreadRun == false && state)
 			{
-				//Shut down host as client processing.
+				//Start host as client processing.
+				hostAsClientTaskPool.start(MAX_THREADS);
+
 				hostAsClientTaskProcessThreadRun = true;
 
 				//Launch host as client task processing thread.
-				if (hostAsClient) hostAsClientTaskProcessingThread = std::thread([this] { hostAsClientProcessTaskThread(); });
+				hostAsClientTaskProcessingThread = std::thread([this] { hostAsClientProcessTaskThread(); });
 			}
 
 			//Shut down processing thread if it has been started, and the host is being set to no longer process tasks locally.
 			if (hostAsClientTaskProcessThreadRun && !state)
 			{
 				//Shut down host as client processing.
+				std::unique_lock<std::mutex> lock(localHostAsClientTaskQueueMutex);
 				hostAsClientTaskProcessThreadRun = false;
+				lock.unlock();
+				localHostAsClientTaskQueueCondition.notify_all();
 
 				//Wait forhost as client task processing thread to finish.
 				if (hostAsClientTaskProcessingThread.joinable()) hostAsClientTaskProcessingThread.join();
+
+				//Finish the task parts already handed to the pool, so their tasks complete.
+				hostAsClientTaskPool.stop(true);
 			}
 		}
 
@@ -269,71 +772,400 @@ namespace cf
 		
 	}
 
-	bool Host::markTaskFinished(Result *result)
+	void Host::trackTask(Task *t, ClientDetails *client)
 	{
-		bool resultValid = false;
+		InFlightTask entry;
+		entry.client = client;
+		entry.task = t;
+		entry.timeSent = t->getHostTimeSent();
 
-		//Check the HOST as a pseudo-client in case it processed the task directly rather than sending to a network client.
-		std::unique_lock<std::mutex> lock(tasksAssignedAsClientMutex);
-		for (auto &t : tasksAssignedAsClient)
-		{
-			if (t->getInitialTaskID() == result->getInitialTaskID() &&
-				t->getTaskPartNumber() == result->getTaskPartNumber())
-			{
-				//Record the time this task was started.
-				result->setHostTimeSent(t->getHostTimeSent());
+		std::unique_lock<std::mutex> lock(inFlightTasksMutex);
+		inFlightTasks[LineageKey(t->getInitialTaskID(), t->getTaskPartNumberStack())] = entry;
 
-				//Remove this task from the host-as-client.
-				delete t;
-				tasksAssignedAsClient.erase(std::remove(tasksAssignedAsClient.begin(),
-					tasksAssignedAsClient.end(), t), tasksAssignedAsClient.end());
-				resultValid = true;
-				break;
-			}
-		}
-		lock.unlock();
+		//Record the task against the client, so it can be redistributed if the client disconnects.
+		if (client != nullptr) client->trackTask(t);
+	}
+
+	sf::Time Host::getPartStartTime(const InFlightTask &entry)
+	{
+		//Nodes may have several tasks queued, so a part is taken to have started when it was sent
+		//or when its node's previous result arrived, whichever is later.
+		if (entry.client == nullptr) return std::max(entry.timeSent, hostAsClientLastResultTime);
+
+		std::unique_lock<std::mutex> taskLock(entry.client->taskMutex);
+		return std::max(entry.timeSent, entry.client->lastResultTime);
+	}
+
+	std::vector<Task *> Host::untrackClientTasks(ClientDetails *client)
+	{
+		std::unique_lock<std::mutex> lock(inFlightTasksMutex);
+		std::unique_lock<std::mutex> taskLock(client->taskMutex);
+
+		std::vector<Task *> tasks(client->tasks.begin(), client->tasks.end());
+		client->tasks.clear();
 
-		//Check CLIENTS to see if one of them processed this task.
-		if (!resultValid)
+		std::vector<Task *> redistTasks;
+		for (auto &t : tasks)
 		{
-			std::unique_lock<std::mutex> clientsLock(clientsMutex);
-			for (auto &c : clients)
+			LineageKey key(t->getInitialTaskID(), t->getTaskPartNumberStack());
+			auto it = inFlightTasks.find(key);
+			auto backupIt = backupTasks.find(key);
+
+			if (it != inFlightTasks.end() && it->second.task == t)
 			{
-				std::unique_lock<std::mutex> lock(c->taskMutex);
-				for (auto &t : c->tasks)
+				if (backupIt != backupTasks.end())
 				{
-					if (t->getInitialTaskID() == result->getInitialTaskID() &&
-						t->getTaskPartNumber() == result->getTaskPartNumber())
-					{
-						//Record the time this task was started.
-						result->setHostTimeSent(t->getHostTimeSent());
-
-						//Remove this task from the client.
-						delete t;
-						c->tasks.erase(std::remove(c->tasks.begin(), c->tasks.end(), t), c->tasks.end());
-						resultValid = true;
-						break;
-					}
+					//The client held the original task, and a backup copy is running elsewhere. 
+					//The backup copy takes the place of the original.
+					it->second = backupIt->second.back();
+					backupIt->second.pop_back();
+					if (backupIt->second.size() == 0) backupTasks.erase(backupIt);
+					delete t;
 				}
-				lock.unlock();
-				if (resultValid) break;
+				else
+				{
+					//The task must be sent again, and may now be sent to any node.
+					inFlightTasks.erase(it);
+					t->setPreferredNodeID(0);
+					redistTasks.push_back(t);
+				}
+			}
+			else if (backupIt != backupTasks.end())
+			{
+				//The client held a backup copy. The original is still running elsewhere, so the copy is dropped.
+				std::vector<InFlightTask> &copies = backupIt->second;
+				copies.erase(std::remove_if(copies.begin(), copies.end(), [t](const InFlightTask &c) { return c.task == t; }), copies.end());
+				if (copies.size() == 0) backupTasks.erase(backupIt);
+				delete t;
 			}
-			clientsLock.unlock();
 		}
 
-		return resultValid;
+		return redistTasks;
 	}
 
-	inline int Host::getClientsCount()
+	void Host::updateThroughput(std::atomic<double> &estimate, const Task *task, sf::Time elapsed)
 	{
-		std::unique_lock<std::mutex> lock(clientsMutex);
+		//Guard against timer resolution on very small tasks.
+		double seconds = std::max(elapsed.asMicroseconds(), (sf::Int64)1) / 1000000.0;
+		double measured = task->getWorkSize() / seconds;
 
-		int count = 0;
+		//Smooth the estimate so a single slow or fast task part doesn't swing the next split.
+		double current = estimate;
+		estimate = current > 0 ? current + (measured - current) * throughputSmoothing : measured;
+	}
 
-		//Count connected clients.
-		for (auto &c : clients)
+	bool Host::isNodeAvailable(unsigned __int64 nodeID)
+	{
+		if (nodeID == HOST_AS_CLIENT_NODE_ID) return hostAsClient;
+
+		std::unique_lock<std::mutex> lock(clientsMutex);
+		for (auto &client : clients)
 		{
-			if (!c->remove) count++;
+			if (client->getClientID() == nodeID) return !client->remove;
+		}
+
+		return false;
+	}
+
+	bool Host::markTaskFinished(Result *result, ClientDetails *client)
+	{
+		LineageKey key(result->getInitialTaskID(), result->getTaskPartNumberStack());
+
+		//Find the task this result was produced from, whether it was processed by a client 
+		//or by the host as a pseudo-client.
+		std::unique_lock<std::mutex> lock(inFlightTasksMutex);
+		auto it = inFlightTasks.find(key);
+
+		//No task is waiting on this result. It may be a late result from a backup copy of a task that has already finished.
+		if (it == inFlightTasks.end()) return false;
+
+		//Gather every copy of the task, the original and any backup copies.
+		std::vector<InFlightTask> copies{ it->second };
+		inFlightTasks.erase(it);
+		auto backupIt = backupTasks.find(key);
+		if (backupIt != backupTasks.end())
+		{
+			copies.insert(copies.end(), backupIt->second.begin(), backupIt->second.end());
+			backupTasks.erase(backupIt);
+		}
+
+		//Find the copy that produced this result. If the node isn't known to hold a copy, credit the original.
+		InFlightTask winner = copies.front();
+		for (auto &c : copies)
+		{
+			if (c.client == client)
+			{
+				winner = c;
+				break;
+			}
+		}
+
+		//Remove every copy of this task from the clients, and update the throughput estimate of the node that processed it.
+		//Nodes may have several tasks queued, so processing of this task is taken to have started when it was
+		//sent or when the node's previous result arrived, whichever is later.
+		sf::Time now = getTime();
+		sf::Time partStarted = winner.timeSent;
+		for (auto &c : copies)
+		{
+			if (c.client != nullptr)
+			{
+				std::unique_lock<std::mutex> taskLock(c.client->taskMutex);
+				c.client->tasks.erase(c.task);
+				if (c.task == winner.task)
+				{
+					partStarted = std::max(c.timeSent, c.client->lastResultTime);
+					c.client->lastResultTime = now;
+				}
+			}
+			else if (c.task == winner.task)
+			{
+				partStarted = std::max(c.timeSent, hostAsClientLastResultTime);
+				hostAsClientLastResultTime = now;
+			}
+		}
+
+		updateThroughput(winner.client != nullptr ? winner.client->throughput : hostAsClientThroughput, winner.task, now - partStarted);
+
+		//Record the part completion time per unit of work, for spotting straggling parts.
+		double workSize = winner.task->getWorkSize();
+		if (workSize > 0)
+		{
+			partCompletionTimes.push_back((now - partStarted).asSeconds() / workSize);
+			if (partCompletionTimes.size() > maxPartCompletionTimes) partCompletionTimes.pop_front();
+		}
+
+		lock.unlock();
+
+		//Record the time this task was started.
+		result->setHostTimeSent(copies.front().timeSent);
+
+		//Update task progress.
+		std::shared_ptr<TaskState> state = getTaskState(result->getInitialTaskID());
+		if (state) state->partsDone++;
+
+		//Stream the part to the application before it is merged.
+		if (state && state->partCallback) state->partCallback(*result, true);
+
+		if (copies.size() > 1) CF_SAY("Task " + std::to_string(result->getInitialTaskID()) + " part finished. Discarding " 
+			+ std::to_string(copies.size() - 1) + " other cop" + (copies.size() > 2 ? "ies." : "y."), Settings::LogLevels::Debug);
+
+		//Delete the copies held by clients. Copies held by the host-as-client are deleted when it finishes processing them.
+		for (auto &c : copies)
+		{
+			if (c.client != nullptr)
+			{
+				delete c.task;
+				c.task = nullptr;
+			}
+		}
+
+		return true;
+	}
+
+	Task *Host::cloneTask(sf::Uint16 typeID, cf::WorkPacket &packet)
+	{
+		Task *copy = taskTypes.create(typeID);
+		if (copy == nullptr) CF_THROW("Cannot copy task. Unknown task subtype.");
+
+		copy->deserialize(packet);
+
+		return copy;
+	}
+
+	void Host::speculateStragglers()
+	{
+		if (!speculativeExecution) return;
+
+		//Tasks with parts still waiting to be sent are not nearly complete.
+		std::unordered_set<unsigned __int64> waitingTaskIDs;
+		std::unique_lock<std::mutex> taskQueueLock(taskQueueMutex);
+		for (auto &t : taskQueue) waitingTaskIDs.insert(t->getInitialTaskID());
+		taskQueueLock.unlock();
+		std::unique_lock<std::mutex> subTaskQueueLock(subTaskQueueMutex);
+		for (auto &t : subTaskQueue) waitingTaskIDs.insert(t->getInitialTaskID());
+		for (auto &s : taskSchedulers) waitingTaskIDs.insert(s->getInitialTaskID());
+		subTaskQueueLock.unlock();
+
+		//Find idle nodes to run backup copies on. These are only candidates, as a client may be
+		//removed once the clients lock is released. Clients are checked again before anything is sent to them.
+		std::vector<ClientDetails *> idleClients;
+		std::unique_lock<std::mutex> clientsLock(clientsMutex);
+		for (auto &client : clients)
+		{
+			if (!client->remove && client->handshakeComplete && client->getTaskCount() == 0) idleClients.push_back(client);
+		}
+		clientsLock.unlock();
+		bool hostIdle = hostAsClient && !busy;
+
+		if (idleClients.size() == 0 && !hostIdle) return;
+
+		//Read the number of parts in each task now, so the task states aren't locked while the in flight tasks are.
+		std::unordered_map<unsigned __int64, unsigned int> partsTotals;
+		std::unique_lock<std::mutex> statesLock(taskStatesMutex);
+		for (auto &ts : taskStates) partsTotals[ts.first] = (unsigned int)ts.second->partsTotal;
+		statesLock.unlock();
+
+		std::unique_lock<std::mutex> lock(inFlightTasksMutex);
+
+		//Wait for enough completed parts to know how long parts usually take.
+		if (partCompletionTimes.size() < 5) return;
+		std::vector<double> times(partCompletionTimes.begin(), partCompletionTimes.end());
+		std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+		double usualTime = times[times.size() / 2];
+
+		//Find parts taking much longer than usual for their size.
+		sf::Time now = getTime();
+		std::unordered_map<unsigned __int64, unsigned int> outstandingParts;
+		std::vector<std::pair<double, InFlightTask>> stragglers;
+		for (auto &t : inFlightTasks)
+		{
+			unsigned __int64 taskID = t.second.task->getInitialTaskID();
+			outstandingParts[taskID]++;
+
+			if (waitingTaskIDs.count(taskID) > 0 || backupTasks.count(t.first) > 0) continue;
+
+			double expected = usualTime * t.second.task->getWorkSize() * speculationFactor;
+			double elapsed = (now - getPartStartTime(t.second)).asSeconds();
+			if (elapsed > expected) stragglers.push_back(std::pair<double, InFlightTask>(expected > 0 ? elapsed / expected : elapsed, t.second));
+		}
+
+		//Most overdue parts first.
+		std::sort(stragglers.begin(), stragglers.end(), 
+			[](const std::pair<double, InFlightTask> &a, const std::pair<double, InFlightTask> &b) { return a.first > b.first; });
+
+		//The originals may finish and be deleted once the lock is released, so each chosen part is 
+		//serialized now and its copy is built from that data later. The node to run the copy on is
+		//recorded with it, or nullptr for the host-as-client.
+		std::vector<std::pair<ClientDetails *, sf::Uint16>> copyTargets;
+		std::vector<cf::WorkPacket *> copyData;
+		for (auto &s : stragglers)
+		{
+			InFlightTask &entry = s.second;
+			unsigned __int64 taskID = entry.task->getInitialTaskID();
+
+			//A task is nearly complete if only its last part, or its last quarter of parts, is still outstanding.
+			auto totalIt = partsTotals.find(taskID);
+			unsigned int partsTotal = totalIt != partsTotals.end() ? totalIt->second : 1;
+			if (outstandingParts[taskID] > 1 && outstandingParts[taskID] * 4 > partsTotal) continue;
+
+			//Can't copy tasks whose type hasn't been registered on the host.
+			sf::Uint16 typeID = taskTypes.getID(entry.task);
+			if (typeID == TaskTypeRegistry::INVALID_ID) continue;
+
+			//Pick an idle node other than the one already processing the part, that the part is allowed to run on.
+			Task::NodeTargetTypes target = entry.task->getNodeTargetType();
+			ClientDetails *backupClient = nullptr;
+			if (target != Task::NodeTargetTypes::Local)
+			{
+				for (auto &c : idleClients)
+				{
+					if (c != entry.client)
+					{
+						backupClient = c;
+						break;
+					}
+				}
+			}
+
+			if (backupClient != nullptr)
+			{
+				idleClients.erase(std::remove(idleClients.begin(), idleClients.end(), backupClient), idleClients.end());
+			}
+			else if (hostIdle && entry.client != nullptr && target != Task::NodeTargetTypes::Remote)
+			{
+				hostIdle = false;
+			}
+			else
+			{
+				continue;
+			}
+
+			cf::WorkPacket *data = new cf::WorkPacket();
+			entry.task->serialize(*data);
+			copyTargets.push_back(std::pair<ClientDetails *, sf::Uint16>(backupClient, typeID));
+			copyData.push_back(data);
+
+			CF_SAY("Task " + std::to_string(taskID) + " part is straggling. Starting a backup copy.", Settings::LogLevels::Info);
+
+			if (idleClients.size() == 0 && !hostIdle) break;
+		}
+
+		lock.unlock();
+
+		if (copyData.size() == 0) return;
+
+		//Build the copies without holding any locks.
+		std::vector<Task *> copies;
+		for (size_t i = 0; i < copyData.size(); i++)
+		{
+			copies.push_back(cloneTask(copyTargets[i].second, *copyData[i]));
+			delete copyData[i];
+			copyData[i] = nullptr;
+		}
+
+		//Hold the clients list while the copies are sent, so a client can't be deleted once it has been checked.
+		//Clients are marked for removal before their tasks are untracked, so a client found not marked for removal
+		//while the in flight tasks are locked will still have any copy tracked against it untracked on disconnect.
+		//Holding the in flight tasks also stops the originals finishing while their copies are sent and tracked.
+		std::vector<Task *> hostCopies;
+		clientsLock.lock();
+		lock.lock();
+		now = getTime();
+		for (size_t i = 0; i < copies.size(); i++)
+		{
+			Task *copy = copies[i];
+			ClientDetails *client = copyTargets[i].first;
+			LineageKey key(copy->getInitialTaskID(), copy->getTaskPartNumberStack());
+
+			//If the original has already finished, or the chosen client has gone, the copy is no longer needed.
+			bool clientGone = client != nullptr && (client->remove || std::find(clients.begin(), clients.end(), client) == clients.end());
+			if (inFlightTasks.count(key) == 0 || clientGone)
+			{
+				delete copy;
+				continue;
+			}
+
+			copy->setHostTimeSent(now);
+			InFlightTask backup;
+			backup.client = client;
+			backup.task = copy;
+			backup.timeSent = now;
+			backupTasks[key].push_back(backup);
+
+			if (client != nullptr)
+			{
+				sender.sendTask(client, copy);
+				client->trackTask(copy);
+			}
+			else
+			{
+				//Copies for the host-as-client are tracked before they are queued, as the host may finish them at any time.
+				hostCopies.push_back(copy);
+			}
+		}
+		lock.unlock();
+		clientsLock.unlock();
+
+		if (hostCopies.size() > 0)
+		{
+			std::unique_lock<std::mutex> hostAsClientLock(localHostAsClientTaskQueueMutex);
+			busy = true;
+			localHostAsClientTaskQueue.insert(localHostAsClientTaskQueue.end(), hostCopies.begin(), hostCopies.end());
+			hostAsClientLock.unlock();
+			localHostAsClientTaskQueueCondition.notify_one();
+		}
+	}
+
+	inline int Host::getClientsCount()
+	{
+		std::unique_lock<std::mutex> lock(clientsMutex);
+
+		int count = 0;
+
+		//Count connected clients that are ready to take tasks.
+		for (auto &c : clients)
+		{
+			if (!c->remove && c->handshakeComplete) count++;
 		}
 
 		if (hostAsClient) count++;
@@ -343,19 +1175,77 @@ namespace cf
 
 	bool Host::checkAvailableResult(unsigned __int64 taskID)
 	{
-		//Aquire lock on result queues.
-		std::unique_lock<std::mutex> lock(resultsQueueCompleteMutex);
+		return getAvailableResult(taskID) != nullptr;
+	}
+
+	bool Host::waitForAvailableResult(unsigned __int64 taskID, unsigned int timeoutMilliseconds)
+	{
+		std::shared_ptr<TaskState> state = getTaskState(taskID);
 
-		if (resultQueueComplete.size() > 0)
+		//No such task ID found.
+		if (!state) return false;
+
+		//Wait for the task to complete.
+		state->future.wait_for(std::chrono::milliseconds(timeoutMilliseconds));
+
+		return checkAvailableResult(taskID);
+	}
+
+	std::shared_ptr<TaskState> Host::getTaskState(unsigned __int64 taskID)
+	{
+		std::unique_lock<std::mutex> lock(taskStatesMutex);
+		auto it = taskStates.find(taskID);
+		if (it == taskStates.end()) return std::shared_ptr<TaskState>();
+		return it->second;
+	}
+
+	void Host::completeTaskState(Result *result)
+	{
+		//Discard results of cancelled tasks.
+		//Checked before taking the task states mutex, so the two mutexes are never held together.
+		if (isTaskCancelled(result->getInitialTaskID()))
+		{
+			delete result;
+			result = nullptr;
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(taskStatesMutex);
+		auto it = taskStates.find(result->getInitialTaskID());
+
+		//Results added directly to the results queue may have no task state yet.
+		if (it == taskStates.end())
 		{
-			for (auto &r : resultQueueComplete)
+			//The task may have been cancelled since it was checked above, which removes its state.
+			lock.unlock();
+			if (isTaskCancelled(result->getInitialTaskID()))
 			{
-				if (r->getInitialTaskID() == taskID) return true;
+				delete result;
+				result = nullptr;
+				return;
 			}
+			lock.lock();
+
+			it = taskStates.emplace(result->getInitialTaskID(), std::make_shared<TaskState>(result->getInitialTaskID())).first;
 		}
 
-		//No such taks ID or no such results set available yet.
-		return false;
+		std::shared_ptr<TaskState> state = it->second;
+
+		//If the application still holds a handle for this task, the handle owns the result from here on.
+		//Otherwise keep the state so the result can be found in the results queue.
+		if (state->handleAlive) taskStates.erase(it);
+
+		lock.unlock();
+
+		state->setComplete(result);
+	}
+
+	void Host::notifyTaskEvent()
+	{
+		std::unique_lock<std::mutex> lock(taskEventMutex);
+		taskEventPending = true;
+		lock.unlock();
+		taskEventCondition.notify_all();
 	}
 
 	void Host::hostAsClientProcessTaskThread()
@@ -366,23 +1256,50 @@ namespace cf
 			while (hostAsClientTaskProcessThreadRun && !cf::ConsoleMessager::getInstance()->exceptionThrown)
 			{
 
+				//Wait for tasks to arrive in the local task queue.
+				//A timeout is set so the thread still responds to exceptions thrown elsewhere.
+				std::unique_lock<std::mutex> lock(localHostAsClientTaskQueueMutex);
+				localHostAsClientTaskQueueCondition.wait_for(lock, std::chrono::milliseconds(100), 
+					[this] { return !hostAsClientTaskProcessThreadRun || localHostAsClientTaskQueue.size() > 0; });
+
 				if (localHostAsClientTaskQueue.size() > 0)
 				{
-					//Copy the local task queue.
-					std::unique_lock<std::mutex> lock(localHostAsClientTaskQueueMutex);
-					std::list<Task *> localHostAsClientTaskQueueCOPY = localHostAsClientTaskQueue;
+					//Take all tasks from the local task queue.
+					std::list<Task *> localHostAsClientTaskQueueCOPY;
+					localHostAsClientTaskQueueCOPY.swap(localHostAsClientTaskQueue);
 					lock.unlock();
 
 					for (auto &t : localHostAsClientTaskQueueCOPY)
 					{
 						CF_SAY("Processing task " + std::to_string(t->getInitialTaskID()) + " locally.", Settings::LogLevels::Info);
 
+						//Pass partial results streamed by the task straight to the application.
+						if (t->getStreamResults()) t->setPartialResultSink([this](Result *partial) { deliverPartialResult(partial); });
+
+						//Results are merged back to the depth of the task being processed.
+						size_t completeDepth = t->getTaskPartNumberStack().size();
+
+						//Tasks using a dynamic scheduling mode are handed to the pool threads in chunks on demand.
+						//The original task is deleted once all of its chunks have completed.
+						if (t->getSchedulingMode() != Task::SchedulingModes::Static && MAX_THREADS > 1)
+						{
+							hostAsClientTasksInProgress++;
+
+							auto start = std::chrono::steady_clock::now();
+
+							hostAsClientTaskPool.runScheduledTask(t, false, [this, t, completeDepth, start](std::vector<Task *> &tasks, std::vector<Result *> &results)
+							{
+								completeHostAsClientTask(t, tasks, results, true, completeDepth, start);
+							});
+							continue;
+						}
+
 						//Split the task among available threads and run.
 						//If there is only one thread, don't split the task and just use the original
 						//task object pointer.
 						std::vector<cf::Task *> tasks;
-						Task *removeTask = t;
-						if (MAX_THREADS > 1)
+						bool split = MAX_THREADS > 1;
+						if (split)
 						{
 							tasks = t->split(MAX_THREADS);
 						}
@@ -391,221 +1308,305 @@ namespace cf
 							tasks = std::vector<cf::Task *>{ t };
 						}
 
-						//Remove the task from the local task parts queue.
-						std::unique_lock<std::mutex> lock3(localHostAsClientTaskQueueMutex);
-						localHostAsClientTaskQueue.erase(std::remove(localHostAsClientTaskQueue.begin(),
-							localHostAsClientTaskQueue.end(), removeTask), localHostAsClientTaskQueue.end());
-						lock3.unlock();
-
-						std::vector<std::future<cf::Result *>> threads = std::vector<std::future<cf::Result *>>();
+						hostAsClientTasksInProgress++;
 
 						//Start benchmark timer.
 						auto start = std::chrono::steady_clock::now();
 
-						for (auto &task : tasks)
+						//Hand the task parts to the thread pool. The last part to finish completes the task.
+						hostAsClientTaskPool.runTasks(tasks, [this, t, tasks, split, completeDepth, start](std::vector<Result *> &results) mutable
 						{
-							threads.push_back(std::async(std::launch::async, [&task]() { return task->run(); }));
-						}
+							completeHostAsClientTask(t, tasks, results, split, completeDepth, start);
+						});
+					}
+				}
+			}
+		}
+		catch (...)
+		{
+			//Do nothing with exceptions in threads. Main thread will see the exception message via ConsoleMessager object.
 
-						std::vector<cf::Result *> results;
+			if (!cf::ConsoleMessager::getInstance()->exceptionThrown)
+			{
+				cf::ConsoleMessager::getInstance()->exceptionThrown = true;
+				cf::ConsoleMessager::getInstance()->exceptionMessage = "Unknown exception in Host hostAsClientProcessTaskThread.";
+			}
+		}
+	}
 
-						unsigned int threadID = 0;
-						for (auto &thread : threads)
-						{
-							CF_SAY("Processing task locally on thread " + std::to_string(threadID++) + ".", Settings::LogLevels::Info);
-							auto result = thread.get();
-							results.push_back(result);
-						}
+	void Host::completeHostAsClientTask(Task *task, std::vector<Task *> &tasks, std::vector<Result *> &results, bool split, size_t completeDepth,
+		std::chrono::steady_clock::time_point start)
+	{
+		//Remove split subtasks from memory. 
+		//If the task was not split, then that means we used the original task object so don't
+		//remove it from memory here.
+		if (split)
+		{
+			for (auto &part : tasks)
+			{
+				delete part;
+				part = nullptr;
+			}
+		}
 
-						//Remove split subtasks from memory. 
-						//If there was just one, then that means we used the original task object so don't
-						//remove it from memory here.
-						if (tasks.size() > 1)
-						{
-							for (auto &task : tasks)
-							{
-								delete task;
-								task = nullptr;
-							}
-						}
+		//Stop benchmark test clock.
+		auto end = std::chrono::steady_clock::now();
+		auto diff = end - start;
 
-						//Stop benchmark test clock.
-						auto end = std::chrono::steady_clock::now();
-						auto diff = end - start;
+		CF_SAY("Local computation time: " + std::to_string(std::chrono::duration <double, std::milli>(diff).count()) + " ms.", Settings::LogLevels::Info);
 
-						CF_SAY("Local computation time: " + std::to_string(std::chrono::duration <double, std::milli>(diff).count()) + " ms.", Settings::LogLevels::Info);
+		//Cancelled tasks are no longer tracked, and their results are not needed.
+		if (task->isCancelled())
+		{
+			for (auto &r : results)
+			{
+				delete r;
+				r = nullptr;
+			}
 
-						cf::Result *result;
+			CF_SAY("Task " + std::to_string(task->getInitialTaskID()) + " processed locally was cancelled. Discarding results.", Settings::LogLevels::Info);
+		}
+		else
+		{
+			cf::Result *result = nullptr;
+
+			//Merge result objects if the task was split, which also unwinds the task part stack
+			//back to that of the original task. Chunks of dynamically scheduled tasks may be at different
+			//depths, so each set is merged as it completes, working back up the task tree.
+			//If the task was not split then the single result object is already at the original depth.
+			ResultSetIndex resultSets;
+			for (auto &r : results)
+			{
+				Result *part = r;
+				r = nullptr;
+				while (part != nullptr && part->getTaskPartNumberStack().size() > completeDepth)
+				{
+					std::vector<Result *> set;
+					if (!resultSets.add(part, set)) CF_THROW("Cannot index result. Task part is out of range, already arrived, or does not match its set.");
+					part = nullptr;
 
-						//Merge result objects if there was more than one in the resulting set.
-						if (results.size() > 1)
-						{
-							if (resultConstructMap.size() == 0 || resultConstructMap.find(results.front()->getSubtype()) == resultConstructMap.end()) CF_THROW("Invalid results type.");
-							result = resultConstructMap[results.front()->getSubtype()]();
+					//The set is still waiting on other parts.
+					if (set.size() == 0) break;
 
-							result->merge(results);
-						}
-						else
-						{
-							result = results.front();
-						}
+					part = resultTypes.createLike(set.front());
+					if (part == nullptr) CF_THROW("Invalid results type.");
+					part->merge(set);
 
-						//Clean up temporary results objects, but only if they were a set of more than one.
-						//If there was just one result than we need to keep the single result object in memory
-						//and just pass it to the completed results list.
-						if (results.size() > 1)
-						{
-							for (auto &r : results)
-							{
-								delete r;
-								r = nullptr;
-							}
-						}
+					//Clean up temporary results objects.
+					for (auto &s : set)
+					{
+						delete s;
+						s = nullptr;
+					}
+				}
 
-						CF_SAY("Processing task locally - completed.", Settings::LogLevels::Info);
+				if (part != nullptr) result = part;
+			}
 
-						//Work out which client, if any, owns the task this result came from.
-						//If a client is found to own the task, remove the task from the client and delete it from memory.
-						//If no clients own this task, ignore it.
-						//The host is also checked in case it was running as a pseudo-client for this task.
-						if (!markTaskFinished(result))
-						{
-							CF_THROW("Results processed locally are invalid. No owner found.");
-						}
+			if (result == nullptr) CF_THROW("Results processed locally are incomplete.");
 
-						//Place the result in the host result parts queue.
-						std::unique_lock<std::mutex> lock2(resultsQueueIncompleteMutex);
-						resultQueueIncomplete.push_back(result);
-						lock2.unlock();
+			CF_SAY("Processing task locally - completed.", Settings::LogLevels::Info);
 
-						//Scan the incomplete results queue for complete results sets and move them to the complete results queue.
-						checkForCompleteResults();
+			//Work out which client, if any, owns the task this result came from.
+			//If a client is found to own the task, remove the task from the client and delete it from memory.
+			//If no clients own this task, ignore it.
+			//The host is also checked in case it was running as a pseudo-client for this task.
+			//If no owner is found, another copy of the task finished first and this result is no longer needed.
+			if (markTaskFinished(result, nullptr))
+			{
+				//Add the result to its result set, and move it to the complete results queue if the set is complete.
+				checkForCompleteResults(result);
+			}
+			else
+			{
+				CF_SAY("Task " + std::to_string(result->getInitialTaskID()) + " part processed locally was already completed by another node. Discarding result.", Settings::LogLevels::Debug);
+				delete result;
+				result = nullptr;
+			}
+		}
 
-					}
+		//A cancelled task may be forgotten once the host-as-client has finished with its last part.
+		unsigned __int64 taskID = task->getInitialTaskID();
+		std::unique_lock<std::mutex> cancelledLock(cancelledTasksMutex);
+		bool retire = cancelledHostTasks.erase(task) > 0;
+		cancelledLock.unlock();
+		if (retire)
+		{
+			std::unique_lock<std::mutex> resultsLock(resultsQueueIncompleteMutex);
+			retireCancelledTask(taskID);
+		}
 
-					busy = false;
-				}
+		//Tasks processed by the host are owned by the host until they are complete.
+		delete task;
+		task = nullptr;
 
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
-			}
-		}
-		catch (...)
+		//The host is free for more work once all of its local tasks have completed.
+		if (--hostAsClientTasksInProgress == 0)
 		{
-			//Do nothing with exceptions in threads. Main thread will see the exception message via ConsoleMessager object.
+			busy = false;
 
-			if (!cf::ConsoleMessager::getInstance()->exceptionThrown)
-			{
-				cf::ConsoleMessager::getInstance()->exceptionThrown = true;
-				cf::ConsoleMessager::getInstance()->exceptionMessage = "Unknown exception in Host hostAsClientProcessTaskThread.";
-			}
+			//Wake the task watcher to send the host more work.
+			notifyTaskEvent();
 		}
 	}
 
-	void Host::checkForCompleteResults()
+	bool Host::checkForCompleteResults(Result *result)
 	{
-		//Aquire lock on result queues.
-		std::unique_lock<std::mutex> lockResCopy(resultsQueueIncompleteMutex);
-		std::list<Result *> resultQueueIncompleteCOPY = resultQueueIncomplete;
-		lockResCopy.unlock();
-
-		std::vector<Result *> set;
-		std::vector<Result *> remove;
-		for (auto &r1 : resultQueueIncompleteCOPY)
+		//Results for tasks that were split have more than one entry in their task part number stack.
+		//Each set is merged as its last part arrives, working back up the task tree to the initial task.
+		if (result->getTaskPartNumberStack().size() > 1)
 		{
-			//If this result part is already in the removal list, then skip it.
-			if (remove.size() > 0 && std::find(remove.begin(), remove.end(), r1) != remove.end()) continue;
+			std::unique_lock<std::mutex> lock(resultsQueueIncompleteMutex);
 
-			set.push_back(r1);
+			//Discard parts of cancelled tasks.
+			if (isTaskCancelled(result->getInitialTaskID()))
+			{
+				lock.unlock();
+				delete result;
+				result = nullptr;
+				return true;
+			}
 
-			for (auto &r2 : resultQueueIncompleteCOPY)
+			std::vector<Result *> set;
+			if (!incompleteResults.add(result, set))
 			{
-				//Skip checking against ourself.
-				if (r1 == r2) continue;
+				lock.unlock();
+				CF_SAY("Task " + std::to_string(result->getInitialTaskID()) + " result part is out of range, already arrived, or does not match its set. Discarding result.", Settings::LogLevels::Error);
+				delete result;
+				result = nullptr;
+				return false;
+			}
 
-				//If this result part is already in the removal list, then skip it.
-				if (remove.size() > 0 && std::find(remove.begin(), remove.end(), r2) != remove.end()) continue;
+			//The set is still waiting on other parts.
+			if (set.size() == 0) return true;
 
-				//Compare initial task ID of the two result parts.
-				if (r2->getInitialTaskID() == r1->getInitialTaskID()) set.push_back(r2);
-			}
+			//A cancelled task is not retired while its results are being merged.
+			mergesInProgress[set.front()->getInitialTaskID()]++;
+			lock.unlock();
 
-			//If all parts of the result set are present, merge them and place the 
-			//combined result on the completed results queue.
-			if (set.size() == r1->getCurrentTaskPartsTotal())
-			{
-				cf::Result *rNew;
-			
-				//Merge if the results set is in multiple parts. 
-				//Otherwise just copy the results set pointer.
-				if (set.size() > 1)
-				{
-					if (resultConstructMap.size() == 0 || resultConstructMap.find(r1->getSubtype()) == resultConstructMap.end()) CF_THROW("Invalid results type.");
-					rNew = resultConstructMap[r1->getSubtype()]();
-					rNew->merge(set);
+			//Merge the set on the merge threads, so the thread that delivered the last part can carry on.
+			mergePool.submit([this, set] { mergeResultSet(set); });
+			return true;
+		}
 
-					//Transfer the task start time from the set to the new merged result.
-					rNew->setHostTimeSent(set[0]->getHostTimeSent());
-				}
-				else
-				{
-					rNew = set.front();
-				}
+		//Record the finish time for this result.
+		result->setHostTimeFinished(getTime());
 
-				//Record the finish time for this result.
-				rNew->setHostTimeFinished(getTime());
+		//Add the elapsed time to the benchmark tracker.
+		addBenchmarkTime(result->getHostTimeFinished() - result->getHostTimeSent());
 
-				//Add the elapsed time to the benchmark tracker.
-				addBenchmarkTime(rNew->getHostTimeFinished() - rNew->getHostTimeSent());
+		//Store the completed result and wake anything waiting on it.
+		completeTaskState(result);
 
-				//Store the completed result.
-				std::unique_lock<std::mutex> lockComp(resultsQueueCompleteMutex);
-				resultQueueComplete.push_back(rNew);
-				lockComp.unlock();
+		return true;
+	}
 
-				//Record these results for removal from the incomplete results set.
-				remove.insert(remove.end(), set.begin(), set.end());
+	void Host::mergeResultSet(std::vector<Result *> set)
+	{
+		sf::Uint16 typeID = resultTypes.getID(set.front());
+		if (typeID == ResultTypeRegistry::INVALID_ID) CF_THROW("Invalid results type.");
 
-			}
-			set.clear();
-		}
+		unsigned __int64 taskID = set.front()->getInitialTaskID();
 
-		std::unique_lock<std::mutex> lockRemove(resultsQueueIncompleteMutex);
-		for (auto &r : remove)
+		//Small sets are merged in one step.
+		if (set.size() <= mergeFanIn)
 		{
+			cf::Result *rNew = resultTypes.create(typeID);
+			rNew->merge(set);
 
-			//Remove completed results from incomplete results set.
-			resultQueueIncomplete.erase(std::remove(resultQueueIncomplete.begin(), resultQueueIncomplete.end(), r), resultQueueIncomplete.end());
+			//Transfer the task start time from the set to the new merged result.
+			rNew->setHostTimeSent(set[0]->getHostTimeSent());
 
-			//If the result is part of a set, delete the result set part from memory 
-			//as we will have merged it into a new results set previously.
-			if (r->getCurrentTaskPartsTotal() > 1)
+			//Delete the result set parts from memory, as we have merged them into a new result.
+			for (auto &r : set)
 			{
 				delete r;
 				r = nullptr;
 			}
 
+			//The merged result may complete a set further up the task tree.
+			checkForCompleteResults(rNew);
+
+			//A merge of a large set finishes when its final step does.
+			finishMerge(taskID);
+			return;
 		}
-		lockRemove.unlock();
 
+		//Large sets are merged as a tree. Runs of consecutive parts are merged in parallel, and the
+		//last run to finish merges the runs in turn. Shared by all jobs for this level of the tree.
+		struct MergeLevel
+		{
+			std::vector<Result *> runs;
+			std::atomic<size_t> remaining;
+		};
+
+		unsigned int fanIn = mergeFanIn;
+		size_t runCount = (set.size() + fanIn - 1) / fanIn;
+
+		std::shared_ptr<MergeLevel> level = std::make_shared<MergeLevel>();
+		level->runs.resize(runCount, nullptr);
+		level->remaining = runCount;
+
+		for (size_t i = 0; i < runCount; i++)
+		{
+			std::vector<Result *> run(set.begin() + i * fanIn, set.begin() + std::min(set.size(), (i + 1) * fanIn));
+
+			mergePool.submit([this, level, run, i, typeID]() mutable
+			{
+				cf::Result *rNew = resultTypes.create(typeID);
+				rNew->mergeRun(run);
+				rNew->setHostTimeSent(run[0]->getHostTimeSent());
+
+				for (auto &r : run)
+				{
+					delete r;
+					r = nullptr;
+				}
+
+				level->runs[i] = rNew;
+
+				//The final run to finish merges the runs, which are already in order.
+				if (--level->remaining == 0) mergeResultSet(level->runs);
+			});
+		}
+
+		CF_SAY("Merging result set of " + std::to_string(set.size()) + " parts as " + std::to_string(runCount) + " runs.", Settings::LogLevels::Debug);
 	}
 
 	void Host::sendSubTasks()
 	{
 
+		//Hand out chunks of dynamically scheduled tasks to nodes with room for them.
+		scheduleChunks();
+
+		std::unique_lock<std::mutex> copyLock(subTaskQueueMutex);
+
 		//Do nothing if subtask queue is empty. 
 		if (subTaskQueue.size() == 0) return;
 
 		//Copy current subtask queue entries for processing.
-		std::unique_lock<std::mutex> copyLock(subTaskQueueMutex);
+		//Queued subtasks are only deleted by the task watcher thread, which is running this, so the copies stay valid.
 		std::list<Task *> subTaskQueueCOPY = subTaskQueue;
 		copyLock.unlock();
 
-		std::list<Task *>::iterator it = subTaskQueueCOPY.begin();
+		//Send the most urgent subtasks first. The sort is stable, so subtasks of equal urgency are sent in the order they were queued.
+		subTaskQueueCOPY.sort([](const Task *a, const Task *b)
+		{
+			return isMoreUrgent(a->getPriority(), a->getHostDeadline(), b->getPriority(), b->getHostDeadline());
+		});
 
-		while (it != subTaskQueueCOPY.end())
+		bool hostAsClientTasksSent = false;
+
+		for (auto &task : subTaskQueueCOPY)
 		{
+			//Task parts split by throughput are kept for the node they were sized for, unless that node has gone.
+			unsigned __int64 preferredNodeID = task->getPreferredNodeID();
+			bool preferredNodeAvailable = preferredNodeID != 0 && isNodeAvailable(preferredNodeID);
 
-			Task *task = *it;
+			//Background tasks are only sent to nodes with no other tasks.
+			//Background tasks that can only run on the host-as-client wait until it is free.
+			bool background = task->isBackground();
+			if (background && hostAsClient && busy && task->getNodeTargetType() == Task::NodeTargetTypes::Local) continue;
 
 			//Can this task ONLY be sent to local node, and host-as-client is enabled?
 			//Then send this task to the local host-as-client regardless of its busy status.
@@ -616,11 +1617,16 @@ namespace cf
 			//so process it locally anyway.
 			if ((hostAsClient && task->getNodeTargetType() == Task::NodeTargetTypes::Local)
 				||
-				(hostAsClient && !busy && task->getNodeTargetType() == Task::NodeTargetTypes::Any)
+				(hostAsClient && !busy && task->getNodeTargetType() == Task::NodeTargetTypes::Any && (!preferredNodeAvailable || preferredNodeID == HOST_AS_CLIENT_NODE_ID))
 				||
 				(hostAsClient && !busy && task->getNodeTargetType() == Task::NodeTargetTypes::Remote && getClientsCount() == 1)
 				)
 			{
+				//Take the task off the subtask queue before it is sent, as it may be completed and deleted at any time after.
+				std::unique_lock<std::mutex> dequeueLock(subTaskQueueMutex);
+				subTaskQueue.remove(task);
+				dequeueLock.unlock();
+
 				std::unique_lock<std::mutex> hostAsClientLock(localHostAsClientTaskQueueMutex);
 				CF_SAY("Sending task to local client.", Settings::LogLevels::Info);
 
@@ -633,18 +1639,28 @@ namespace cf
 				localHostAsClientTaskQueue.push_back(task);
 				hostAsClientLock.unlock();
 
-				it++;
+				hostAsClientTasksSent = true;
 			}
 			else
 			{
-				//Search for the next available client.
+				//Search for the available client with the fewest tasks in flight.
 				ClientDetails *freeClient = nullptr;
+				size_t freeClientTaskCount = 0;
 				std::unique_lock<std::mutex> clientsLock(clientsMutex);
 				for (auto &client : clients)
 				{
-					//Skip busy or removed clients.
-					if (client->busy || client->remove) continue;
-					freeClient = client;
+					//Skip removed clients, and clients that are still connecting.
+					if (client->remove || !client->handshakeComplete) continue;
+					//Skip clients this task part wasn't sized for.
+					if (preferredNodeAvailable && client->getClientID() != preferredNodeID) continue;
+					//Skip clients whose task window is full, or that have any tasks if this is a background task.
+					size_t taskCount = client->getTaskCount();
+					if (taskCount >= clientTaskWindow || (background && taskCount > 0)) continue;
+					if (freeClient == nullptr || taskCount < freeClientTaskCount)
+					{
+						freeClient = client;
+						freeClientTaskCount = taskCount;
+					}
 				}
 				clientsLock.unlock();
 
@@ -652,43 +1668,33 @@ namespace cf
 				{
 					CF_SAY("Sending task to remote client.", Settings::LogLevels::Info);
 
-					freeClient->busy = true;
+					//Take the task off the subtask queue before it is sent, as it may be completed and deleted at any time after.
+					std::unique_lock<std::mutex> dequeueLock(subTaskQueueMutex);
+					subTaskQueue.remove(task);
+					dequeueLock.unlock();
 
 					//Set a host-relative timestamp on the task so we can track how long it is taking.
 					task->setHostTimeSent(getTime());
 
 					//Assign the task to the client so we can track its progress.
-					freeClient->trackTask(task);
+					trackTask(task, freeClient);
 
 					sender.sendTask(freeClient, task);
-
-					it++;
 				}
 
+				//If no client is free, leave the task in the subtask queue. The task watcher
+				//will try again when a client becomes free.
 			}
 
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
-
-		}
-
-		//Empty the subtask queue.
-		subTaskQueue.clear();
-
-		//Wait for sender threads to finish.
-		sender.waitForComplete();
-
-		std::unique_lock<std::mutex> lockRemove(subTaskQueueMutex);
-		for (auto &r : subTaskQueueCOPY)
-		{
-			//Remove subtasks from queue that have been sent.
-			subTaskQueue.erase(std::remove(subTaskQueue.begin(), subTaskQueue.end(), r), subTaskQueue.end());
 		}
-		lockRemove.unlock();
 
+		//Wake the host-as-client processing thread.
+		if (hostAsClientTasksSent) localHostAsClientTaskQueueCondition.notify_one();
 	}
 
 	void Host::addBenchmarkTime(const sf::Time elapsed)
 	{
+		std::unique_lock<std::mutex> lock(benchmarkTimesMutex);
 		benchmarkTimes.push_back(elapsed);
 
 		//Remove excess times stored in list.
@@ -702,6 +1708,7 @@ namespace cf
 	{
 		sf::Time sum;
 
+		std::unique_lock<std::mutex> lock(benchmarkTimesMutex);
 		for (auto &t : benchmarkTimes)
 		{
 			sum += t;
@@ -710,4 +1717,46 @@ namespace cf
 		return sum / (float)benchmarkTimes.size();
 	}
 
+	void Host::setCompressionDictionary(WorkPacket::Flag flag, const std::vector<sf::Uint8> &dictionary)
+	{
+		if (dictionary.size() > CompressionEngine::MAX_DICTIONARY_SIZE) CF_THROW("Compression dictionary is too large.");
+
+		std::unique_lock<std::mutex> lock(compressionDictionariesMutex);
+		if (dictionary.size() == 0) compressionDictionaries.erase((sf::Uint8)flag);
+		else compressionDictionaries[(sf::Uint8)flag] = dictionary;
+		lock.unlock();
+
+		CF_SAY("Compression dictionary for packet type " + std::to_string(flag) + " set to " + std::to_string(dictionary.size()) + " bytes.", Settings::LogLevels::Info);
+	}
+
+	void Host::trainCompressionDictionary(const std::vector<const Task *> &samples)
+	{
+		//Serialize the samples the same way they are sent to clients.
+		std::vector<cf::WorkPacket> packets(samples.size());
+		std::vector<const cf::WorkPacket *> packetPointers;
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			taskTypes.writeHeader(packets[i], samples[i]);
+			samples[i]->serialize(packets[i]);
+			packetPointers.push_back(&packets[i]);
+		}
+
+		setCompressionDictionary(WorkPacket::Flag::Task, CompressionEngine::trainDictionary(packetPointers));
+	}
+
+	void Host::trainCompressionDictionary(const std::vector<const Result *> &samples)
+	{
+		//Serialize the samples the same way clients send them.
+		std::vector<cf::WorkPacket> packets(samples.size());
+		std::vector<const cf::WorkPacket *> packetPointers;
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			resultTypes.writeHeader(packets[i], samples[i]);
+			samples[i]->serialize(packets[i]);
+			packetPointers.push_back(&packets[i]);
+		}
+
+		setCompressionDictionary(WorkPacket::Flag::Result, CompressionEngine::trainDictionary(packetPointers));
+	}
+
 }
\ No newline at end of file
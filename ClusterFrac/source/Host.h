@@ -1,13 +1,18 @@
 #pragma once
 #include <vector>
+#include <algorithm>
 #include <list>
+#include <deque>
 #include <atomic>
 #include <thread>
 #include <future>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <string>
 #include <map>
 #include <unordered_set>
+#include <unordered_map>
 #include <SFML\Network.hpp>
 #include "DllExport.h"
 #include "ConsoleMessager.hpp"
@@ -18,6 +23,13 @@
 #include "HostSender.h"
 #include "HostTaskWatcher.h"
 #include "ClientDetails.hpp"
+#include "ThreadPool.h"
+#include "ResultSetIndex.h"
+#include "LineageKey.hpp"
+#include "TaskHandle.h"
+#include "NodeCapabilities.h"
+#include "TaskScheduler.h"
+#include "TypeRegistry.hpp"
 
 namespace cf
 {
@@ -50,24 +62,28 @@ namespace cf
 		* Register new task construction callback.
 		* @param name The name of the new task.
 		* @param f The callback function to use to construct a new task of this type.
+		* @param poolSize Number of tasks of this type to set aside pooled memory for straight away, so the first
+		* tasks split, received or merged reuse memory. Memory is pooled as tasks are destroyed in any case.
 		* @returns void.
 		*/
-		DLL inline void registerTaskType(std::string name, std::function<Task *()> f)
+		DLL inline void registerTaskType(std::string name, std::function<Task *()> f, unsigned int poolSize = 0)
 		{
 			CF_SAY("Registered task type " + name, Settings::LogLevels::Info); 
-			taskConstuctMap[name] = f; 
+			taskTypes.add(name, f, poolSize);
 		};
 
 		/**
 		* Register new result construction callback.
 		* @param name The name of the new result.
 		* @param f The callback function to use to construct a new result of this type.
+		* @param poolSize Number of results of this type to set aside pooled memory for straight away, so the first
+		* results split, received or merged reuse memory. Memory is pooled as results are destroyed in any case.
 		* @returns void.
 		*/
-		DLL inline void registerResultType(std::string name, std::function<Result *()> f)
+		DLL inline void registerResultType(std::string name, std::function<Result *()> f, unsigned int poolSize = 0)
 		{
 			CF_SAY("Registered result type " + name, Settings::LogLevels::Info);
-			resultConstructMap[name] = f; 
+			resultTypes.add(name, f, poolSize);
 		};
 
 		/**
@@ -93,9 +109,36 @@ namespace cf
 		/**
 		* Add a task to the task queue for sending to clients.
 		* @param task The task to add.
+		* @param partCallback Optional callback for streaming results. If set, each task part result is passed to
+		* the callback as soon as it is accepted, before the parts are merged, and partial results streamed by running
+		* task parts are passed to the callback as they arrive. See Task::streamPartialResult. The callback is run on
+		* host network or processing threads, so should return quickly. It may be run more than once for the same 
+		* partial data if a task part is restarted or copied to another node.
+		* @returns A handle used to wait for the task, follow its progress and take ownership of its result.
+		* While the handle is held, the result is delivered only through the handle. If the handle is discarded
+		* the result is kept in the results queue, for use with checkAvailableResult and getAvailableResult.
+		*/
+		DLL TaskHandle addTaskToQueue(Task *task, TaskState::PartCallback partCallback = nullptr);
+
+		/**
+		* Change the priority of a task that has been added to the task queue.
+		* Parts of the task still waiting on the host take the new priority. Parts already sent to nodes are not affected.
+		* @param taskID The initial task ID of the task.
+		* @param priority The new priority, from the Task::Priorities enum.
 		* @returns void.
 		*/
-		DLL void addTaskToQueue(Task *task);
+		DLL void setTaskPriority(unsigned __int64 taskID, Task::Priorities priority);
+
+		/**
+		* Cancel a task that has been added to the task queue.
+		* Parts of the task still waiting on the host are deleted, and clients processing parts of the task are told
+		* to stop. Parts already running are cancelled through their cancellation token, see Task::isCancelled.
+		* Results that arrive for the task after it is cancelled are discarded.
+		* Any task handle for the task reports the task as cancelled and wakes its waiters.
+		* @param taskID The initial task ID of the task to cancel.
+		* @returns True if the task was cancelled, false if it has already completed or is not known to this host.
+		*/
+		DLL bool cancelTask(unsigned __int64 taskID);
 
 		/**
 		* Divide tasks into subtask queue for processing.
@@ -146,6 +189,14 @@ namespace cf
 		*/
 		DLL Result* getAvailableResult(unsigned __int64 taskID);
 
+		/**
+		* Wait until a result with a specified task ID is available in the results queue, or until a timeout expires.
+		* @param taskID The ID of the task that created the result.
+		* @param timeoutMilliseconds The maximum time to wait, in milliseconds.
+		* @returns True if the result is in the queue, false if the timeout expired first.
+		*/
+		DLL bool waitForAvailableResult(unsigned __int64 taskID, unsigned int timeoutMilliseconds);
+
 		/**
 		* Is host-as-client enabled on this host?
 		* @returns True if host-as-client is enabled, false if not.
@@ -179,18 +230,85 @@ namespace cf
 		};
 
 		/**
-		* Assign a task to this host as a client so that its progress can be tracked.
+		* Assign a task to a client, or to this host as a client, so that its progress can be tracked.
+		* The task is recorded as in flight until its result arrives, it times out, or its client disconnects.
+		* @param t The task to track. Its host time sent should already be set.
+		* @param client The client the task was sent to, or nullptr if the host-as-client is processing the task.
 		* @returns void.
 		*/
-		DLL inline void trackTask(Task* t) { std::unique_lock<std::mutex> lock(tasksAssignedAsClientMutex); tasksAssignedAsClient.push_back(t); };
+		DLL void trackTask(Task *t, ClientDetails *client = nullptr);
 
 		/**
 		* Check which client (or host-as-client) was processing the task associated with a final result object.
-		* Removes the task from that client and deletes the original task object from memory.
+		* Removes the task, and any backup copies of it, from the nodes processing them and deletes them from memory.
+		* Tasks processed by the host-as-client are deleted by the host-as-client once processing finishes.
+		* The first result for a task is accepted. Results for a task that has already finished are not.
 		* @param result A pointer to the result to check.
+		* @param client The client the result was received from, or nullptr if the host-as-client produced the result.
 		* @returns True if a task matching the given result was found, and the task removal was successful, false if not.
 		*/
-		DLL bool markTaskFinished(Result *result);
+		DLL bool markTaskFinished(Result *result, ClientDetails *client = nullptr);
+
+		/**
+		* Enable or disable speculative execution.
+		* When enabled, once a task is nearly complete, parts that are taking much longer than usual are
+		* copied to idle nodes. The first copy to return a result is used, and the other copies are discarded.
+		* Speculative execution is off by default.
+		* @param state Set true to enable speculative execution, false to disable.
+		* @returns void.
+		*/
+		DLL inline void setSpeculativeExecution(bool state) { speculativeExecution = state; };
+
+		/**
+		* Is speculative execution enabled on this host?
+		* @returns True if speculative execution is enabled, false if not.
+		*/
+		DLL inline bool getSpeculativeExecution() const { return speculativeExecution; };
+
+		/**
+		* Set how much longer than usual a task part must take before a backup copy is started.
+		* The usual time is the median of recent task part completion times, scaled by the work size of the part.
+		* @param n The multiple of the usual completion time. Must be at least 1.
+		* @returns void.
+		*/
+		DLL inline void setSpeculationFactor(double n) { if (!(n >= 1)) { CF_THROW("Invalid speculation factor."); } speculationFactor = n; };
+
+		/**
+		* Get how much longer than usual a task part must take before a backup copy is started.
+		* @returns The multiple of the usual completion time.
+		*/
+		DLL inline double getSpeculationFactor() const { return speculationFactor; };
+
+		/**
+		* Set the number of threads used to merge result sets.
+		* Result sets are merged on these threads rather than on the thread that received the last part of the set.
+		* Changes take effect the next time the host is started.
+		* @param n The number of merge threads. Must be at least 1.
+		* @returns void.
+		*/
+		DLL inline void setMergeConcurrency(unsigned int n) { if (n < 1 || n > 65535) { CF_THROW("Invalid merge concurrency value."); } mergeThreads = n; };
+
+		/**
+		* Get the number of threads used to merge result sets.
+		* @returns The number of merge threads.
+		*/
+		DLL inline unsigned int getMergeConcurrency() const { return mergeThreads; };
+
+		/**
+		* Set the largest number of results merged in one step.
+		* Larger result sets are merged as a tree, with runs of up to this many consecutive parts merged 
+		* in parallel on the merge threads, then the merged runs merged in turn.
+		* Result types used with tree merges must give the same result when runs of a set are merged first.
+		* @param n The largest number of results merged in one step. Must be at least 2.
+		* @returns void.
+		*/
+		DLL inline void setMergeFanIn(unsigned int n) { if (n < 2) { CF_THROW("Invalid merge fan in."); } mergeFanIn = n; };
+
+		/**
+		* Get the largest number of results merged in one step.
+		* @returns The largest number of results merged in one step.
+		*/
+		DLL inline unsigned int getMergeFanIn() const { return mergeFanIn; };
 
 		/**
 		* Get the average elapsed time for task processing.
@@ -200,6 +318,10 @@ namespace cf
 
 		/**
 		* Set network compression on or off on the host.
+		* Compression is used for each client that supports it if it is enabled on either the host or the client.
+		* Each packet is then only compressed if the measured link speed, compression speed and compression
+		* ratio for the connection show that compressing saves time.
+		* Changes take effect for clients that connect after the change.
 		* @param newStatus Set true to enable compression, false to disable.
 		* @returns void.
 		*/
@@ -211,6 +333,128 @@ namespace cf
 		*/
 		DLL inline bool getCompression() const { return compression; };
 
+		/**
+		* Set the zlib compression level used when sending to clients.
+		* Changes take effect for clients that connect after the change.
+		* @param newLevel The compression level, from 0 (no compression) to 9 (best compression). Lower levels use less CPU time.
+		* @returns void.
+		*/
+		DLL inline void setCompressionLevel(int newLevel) { if (newLevel < 0 || newLevel > 9) { CF_THROW("Invalid compression level."); } compressionLevel = newLevel; };
+
+		/**
+		* Get the zlib compression level used when sending to clients.
+		* @returns The compression level, or Z_DEFAULT_COMPRESSION if it has not been set.
+		*/
+		DLL inline int getCompressionLevel() const { return compressionLevel; };
+
+		/**
+		* Set the preset compression dictionary for a type of packet.
+		* Dictionaries are sent to each client in the connection handshake, and used in both directions.
+		* Changes take effect for clients that connect after the change.
+		* @param flag The type of packet the dictionary is for. Batch packets use the dictionary for the type they hold.
+		* @param dictionary Data typical of that type of packet, up to CompressionEngine::MAX_DICTIONARY_SIZE bytes. Empty to remove the dictionary.
+		* @returns void.
+		*/
+		DLL void setCompressionDictionary(WorkPacket::Flag flag, const std::vector<sf::Uint8> &dictionary);
+
+		/**
+		* Build the preset compression dictionary for task packets from typical tasks.
+		* The task types must be registered.
+		* Changes take effect for clients that connect after the change.
+		* @param samples Typical tasks, most typical last.
+		* @returns void.
+		*/
+		DLL void trainCompressionDictionary(const std::vector<const Task *> &samples);
+
+		/**
+		* Build the preset compression dictionary for result packets from typical results.
+		* The result types must be registered.
+		* Changes take effect for clients that connect after the change.
+		* @param samples Typical results, most typical last.
+		* @returns void.
+		*/
+		DLL void trainCompressionDictionary(const std::vector<const Result *> &samples);
+
+		/**
+		* Set the maximum number of task parts that may be in flight on each client at once.
+		* Parts beyond the first are queued on the client, so the next part is already there when the
+		* client finishes the current one and no time is lost waiting on the network.
+		* @param n The maximum number of task parts in flight per client. Must be at least 1.
+		* @returns void.
+		*/
+		DLL inline void setClientTaskWindow(unsigned int n) { if (n < 1) { CF_THROW("Invalid client task window."); } clientTaskWindow = n; };
+
+		/**
+		* Get the maximum number of task parts that may be in flight on each client at once.
+		* @returns The maximum number of task parts in flight per client.
+		*/
+		DLL inline unsigned int getClientTaskWindow() const { return clientTaskWindow; };
+
+		/**
+		* Set the maximum number of tasks sent to a client in one batch packet.
+		* Tasks queued for a client close together are sent in a single packet, saving the per packet overhead
+		* for workloads with many small task parts.
+		* @param n The maximum number of tasks per batch. Set to 1 to send each task in its own packet.
+		* @returns void.
+		*/
+		DLL inline void setBatchSize(unsigned int n) { if (n < 1) { CF_THROW("Invalid batch size."); } batchSize = n; };
+
+		/**
+		* Get the maximum number of tasks sent to a client in one batch packet.
+		* @returns The maximum number of tasks per batch.
+		*/
+		DLL inline unsigned int getBatchSize() const { return batchSize; };
+
+		/**
+		* Set how long a batch packet waits for more tasks before it is sent.
+		* With a window of zero, a batch holds the tasks queued for a client before the next send to that client begins.
+		* @param milliseconds The batch window, in milliseconds.
+		* @returns void.
+		*/
+		DLL inline void setBatchWindow(unsigned int milliseconds) { batchWindowMilliseconds = milliseconds; };
+
+		/**
+		* Get how long a batch packet waits for more tasks before it is sent.
+		* @returns The batch window, in milliseconds.
+		*/
+		DLL inline unsigned int getBatchWindow() const { return batchWindowMilliseconds; };
+
+		/**
+		* Set the largest amount of data sent in one piece to a client.
+		* Larger packets, such as tasks or results with big data arrays, are split into pieces that are
+		* compressed and sent one at a time, so only one piece at a time is held in memory besides the packet.
+		* @param bytes The largest piece size, in bytes. Set to zero to always send packets whole.
+		* @returns void.
+		*/
+		DLL inline void setChunkSize(std::size_t bytes) { chunkSize = bytes; };
+
+		/**
+		* Get the largest amount of data sent in one piece to a client.
+		* @returns The largest piece size, in bytes, or zero if packets are always sent whole.
+		*/
+		DLL inline std::size_t getChunkSize() const { return chunkSize; };
+
+		/**
+		* Set the largest packet accepted from a client, whether it is sent whole, in pieces or compressed.
+		* Clients that send a larger packet are disconnected. Must be larger than the chunk size set on clients.
+		* @param bytes The largest packet size, in bytes.
+		* @returns void.
+		*/
+		DLL inline void setMaxPacketSize(std::size_t bytes) { maxPacketSize = bytes; };
+
+		/**
+		* Get the largest packet accepted from a client, whether it is sent whole or in pieces.
+		* @returns The largest packet size, in bytes.
+		*/
+		DLL inline std::size_t getMaxPacketSize() const { return maxPacketSize; };
+
+		/**
+		* Get the capabilities of the host, as sent to clients during the connection handshake.
+		* Capabilities are detected when the host is started.
+		* @returns The capabilities of the host.
+		*/
+		DLL inline const NodeCapabilities &getCapabilities() const { return capabilities; };
+
 	private:
 
 		//clock used to track time since startup.
@@ -228,6 +472,21 @@ namespace cf
 		//Is network compression enabled on the host?
 		bool compression;
 
+		//Zlib compression level used when sending to clients.
+		std::atomic<int> compressionLevel;
+
+		//Preset compression dictionaries, by the WorkPacket flag of the packets they are used for.
+		std::map<sf::Uint8, std::vector<sf::Uint8>> compressionDictionaries;
+
+		//Mutex for preset compression dictionaries.
+		std::mutex compressionDictionariesMutex;
+
+		//Maximum number of task parts in flight on each client at once.
+		std::atomic<unsigned int> clientTaskWindow;
+
+		//Capabilities of the host, detected when the host is started.
+		NodeCapabilities capabilities;
+
 		//Listener object responsible for managing the TCP listener thread.
 		HostListener listener{ this };
 
@@ -243,6 +502,15 @@ namespace cf
 		//Mutex for clients list.
 		std::mutex clientsMutex;
 
+		//Mutex for task event signalling.
+		std::mutex taskEventMutex;
+
+		//Signals the task watcher that tasks, clients or client availability have changed.
+		std::condition_variable taskEventCondition;
+
+		//Has a task event occurred that the task watcher has not yet handled?
+		bool taskEventPending;
+
 		//Task queue.
 		std::list<cf::Task *> taskQueue;
 
@@ -255,17 +523,26 @@ namespace cf
 		//Mutex for subtask queue
 		std::mutex subTaskQueueMutex;
 
-		//Incomplete results queue.
-		std::list<cf::Result *> resultQueueIncomplete;
+		//Tasks using a dynamic scheduling mode, that still have chunks to hand out to nodes.
+		//Guarded by the subtask queue mutex.
+		std::list<TaskScheduler *> taskSchedulers;
+
+		//Incomplete result sets, waiting for their remaining parts.
+		ResultSetIndex incompleteResults;
 
 		//Mutex for incomplete results queue.
 		std::mutex resultsQueueIncompleteMutex;
 
-		//Complete results queue.
-		std::list<cf::Result *> resultQueueComplete;
+		//Number of result set merges in progress for each task, by initial task ID.
+		//Guarded by the incomplete results queue mutex.
+		std::unordered_map<unsigned __int64, unsigned int> mergesInProgress;
 
-		//Mutex for complete results queue.
-		std::mutex resultsQueueCompleteMutex;
+		//Completion state of tasks that are in progress, and of completed tasks whose results are 
+		//in the results queue, keyed by task ID.
+		std::unordered_map<unsigned __int64, std::shared_ptr<TaskState>> taskStates;
+
+		//Mutex for task states.
+		std::mutex taskStatesMutex;
 
 		//Local task queue for host, that it should process as a client if hostAsClient is enabled.
 		std::list<cf::Task *> localHostAsClientTaskQueue;
@@ -273,23 +550,113 @@ namespace cf
 		//Mutex for local task queue.
 		std::mutex localHostAsClientTaskQueueMutex;
 
+		//Signals the host as client processing thread that tasks have been added to the local task queue.
+		std::condition_variable localHostAsClientTaskQueueCondition;
+
 		//Thread used to process task chunks locally on the host.
 		std::thread hostAsClientTaskProcessingThread;
 
 		//Should the host processing tasks as a client thread continue to run?
 		std::atomic<bool> hostAsClientTaskProcessThreadRun;
 
-		//Tasks assigned to this client.
-		std::vector<Task *> tasksAssignedAsClient;
+		//Thread pool used to run task parts locally on the host.
+		ThreadPool hostAsClientTaskPool;
+
+		//Maximum number of tasks sent to a client in one batch packet.
+		std::atomic<unsigned int> batchSize;
+
+		//Time a batch packet waits for more tasks before it is sent, in milliseconds.
+		std::atomic<unsigned int> batchWindowMilliseconds;
+
+		//Largest amount of data sent to a client in one piece, in bytes, or zero to send packets whole.
+		std::atomic<std::size_t> chunkSize;
+
+		//Largest packet accepted from a client, in bytes.
+		std::atomic<std::size_t> maxPacketSize;
+
+		//Thread pool used to merge result sets.
+		ThreadPool mergePool;
+
+		//Number of threads in the merge thread pool.
+		unsigned int mergeThreads;
+
+		//Largest number of results merged in one step. Larger sets are merged as a tree.
+		std::atomic<unsigned int> mergeFanIn;
+
+		//Number of tasks handed to the host as client thread pool that have not yet completed.
+		std::atomic<unsigned int> hostAsClientTasksInProgress;
+
+		//Estimated task processing throughput of the host-as-client, in task work units per second.
+		//Zero until the host-as-client has completed a task.
+		std::atomic<double> hostAsClientThroughput;
+
+		//Host time the most recent result from the host-as-client was received.
+		//Guarded by the in flight tasks mutex.
+		sf::Time hostAsClientLastResultTime;
+
+		//Weight given to each new measurement when updating node throughput estimates.
+		double throughputSmoothing;
+
+		//Preferred node ID used for task parts intended for the host-as-client.
+		//Client IDs start at 1, and 0 means any node.
+		static const unsigned __int64 HOST_AS_CLIENT_NODE_ID = 0xFFFFFFFFFFFFFFFF;
+
+		/**
+		* Details of a task that has been sent for processing and is waiting on its result.
+		*/
+		struct InFlightTask
+		{
+			//The client processing the task, or nullptr if the host-as-client is processing the task.
+			ClientDetails *client;
+
+			//The task.
+			Task *task;
+
+			//Host time the task was sent.
+			sf::Time timeSent;
+		};
+
+		//Tasks waiting on results, keyed by the lineage of each task.
+		std::unordered_map<LineageKey, InFlightTask, LineageKeyHash> inFlightTasks;
+
+		//Mutex for in flight tasks.
+		std::mutex inFlightTasksMutex;
+
+		//Backup copies of straggling tasks, keyed by the lineage of each task.
+		//Guarded by the in flight tasks mutex.
+		std::unordered_map<LineageKey, std::vector<InFlightTask>, LineageKeyHash> backupTasks;
+
+		//Recent task part completion times, in seconds per task work unit.
+		//Guarded by the in flight tasks mutex.
+		std::deque<double> partCompletionTimes;
+
+		//Max number of task part completion times to store.
+		unsigned int maxPartCompletionTimes;
+
+		//Is speculative execution of straggling task parts enabled?
+		std::atomic<bool> speculativeExecution;
+
+		//Multiple of the usual completion time after which a task part is treated as straggling.
+		std::atomic<double> speculationFactor;
 
-		//Task tracking list mutex.
-		std::mutex tasksAssignedAsClientMutex;
+		//Initial IDs of tasks that have been cancelled. Kept until the last part of the task has been retired,
+		//so late results can be discarded.
+		std::unordered_set<unsigned __int64> cancelledTaskIDs;
 
-		//Construction map for user defined Tasks.
-		std::map<std::string, std::function<Task *()>> taskConstuctMap;
+		//Initial IDs of cancelled tasks whose queued and in flight parts have not been removed yet.
+		std::vector<unsigned __int64> cancelsPending;
 
-		//Construction map for user defined Results.
-		std::map<std::string, std::function<Result *()>> resultConstructMap;
+		//Parts of cancelled tasks still being processed by the host-as-client.
+		std::unordered_set<Task *> cancelledHostTasks;
+
+		//Mutex for cancelled tasks.
+		std::mutex cancelledTasksMutex;
+
+		//Construction callbacks and wire IDs for user defined Tasks.
+		TaskTypeRegistry taskTypes;
+
+		//Construction callbacks and wire IDs for user defined Results.
+		ResultTypeRegistry resultTypes;
 
 		//Is this host acting as a client for task processing?
 		bool hostAsClient;
@@ -306,6 +673,116 @@ namespace cf
 		//Benchmark elapsed times for results processing.
 		std::list<sf::Time> benchmarkTimes;
 
+		//Mutex for benchmark times, which are added by the result and merge threads.
+		mutable std::mutex benchmarkTimesMutex;
+
+		/**
+		* Get the completion state of a task.
+		* @param taskID The ID of the task.
+		* @returns The task state, or an empty pointer if there is no state for that task ID.
+		*/
+		std::shared_ptr<TaskState> getTaskState(unsigned __int64 taskID);
+
+		/**
+		* Hand a final result to the completion state of its task.
+		* @param result The final result.
+		* @returns void.
+		*/
+		void completeTaskState(Result *result);
+
+		/**
+		* Stop tracking all tasks assigned to a client, so they can be redistributed.
+		* @param client The client to remove the tasks from.
+		* @returns The tasks that were assigned to the client.
+		*/
+		std::vector<Task *> untrackClientTasks(ClientDetails *client);
+
+		/**
+		* Update a node throughput estimate with the time taken to complete a task.
+		* @param estimate The throughput estimate to update.
+		* @param task The completed task.
+		* @param elapsed The time taken to complete the task, from when it was sent.
+		* @returns void.
+		*/
+		void updateThroughput(std::atomic<double> &estimate, const Task *task, sf::Time elapsed);
+
+		/**
+		* Check if the node a task part would prefer to be sent to is still able to take tasks.
+		* @param nodeID The preferred node ID.
+		* @returns True if the node is a connected client, or is the host-as-client while host-as-client is enabled, false if not.
+		*/
+		bool isNodeAvailable(unsigned __int64 nodeID);
+
+		/**
+		* Wake the task watcher so it can divide and send pending tasks.
+		* @returns void.
+		*/
+		void notifyTaskEvent();
+
+		/**
+		* Make a copy of a task, by deserializing data serialized from the original into a new task.
+		* The copy has the same task ID and task part numbering as the original.
+		* @param typeID The local subtype ID of the original task.
+		* @param packet The data serialized from the original task.
+		* @returns The new copy of the task.
+		*/
+		Task *cloneTask(sf::Uint16 typeID, cf::WorkPacket &packet);
+
+		/**
+		* Has a task been cancelled?
+		* @param taskID The initial task ID of the task.
+		* @returns True if the task has been cancelled, false if not.
+		*/
+		bool isTaskCancelled(unsigned __int64 taskID);
+
+		/**
+		* Pass a partial result streamed by a running task part to the application, if the task is still running.
+		* @param partial The partial result. Deleted once delivered.
+		* @returns void.
+		*/
+		void deliverPartialResult(Result *partial);
+
+		/**
+		* Remove the queued and in flight parts of cancelled tasks. Queued parts and parts held by clients are deleted,
+		* and clients are told to stop processing them. Parts held by the host-as-client are cancelled, and deleted once
+		* the host-as-client finishes with them.
+		* Must only be called from the task watcher thread, as it changes the sub task queue.
+		* @returns void.
+		*/
+		void purgeCancelledTasks();
+
+		/**
+		* Forget a cancelled task once its parts have been removed, the host-as-client has finished with its parts,
+		* and no merges of its results are in progress. Nothing can produce a result for the task after this.
+		* Must be called with the incomplete results queue mutex held.
+		* @param taskID The initial task ID of the task.
+		* @returns void.
+		*/
+		void retireCancelledTask(unsigned __int64 taskID);
+
+		/**
+		* Record that a merge of a result set has finished, and retire the task if it was cancelled and this was its last merge.
+		* @param taskID The initial task ID of the merged result set.
+		* @returns void.
+		*/
+		void finishMerge(unsigned __int64 taskID);
+
+		/**
+		* Estimate when a node started processing an in flight task part. Parts queued behind others on a
+		* node are taken to start when the node's previous result arrived. Must be called with the in flight tasks mutex held.
+		* @param entry The in flight task part.
+		* @returns The host time the part is taken to have started.
+		*/
+		sf::Time getPartStartTime(const InFlightTask &entry);
+
+		/**
+		* Send backup copies of straggling task parts to idle nodes, if speculative execution is enabled.
+		* Only parts of tasks that are nearly complete, with no parts still waiting to be sent, are copied.
+		* Each part is copied at most once.
+		* @returns void.
+		*/
+		void speculateStragglers();
+
 		/**
 		* Thread for processing tasks as a virtual client using the local CPU.
 		* @returns void.
@@ -313,18 +790,67 @@ namespace cf
 		void hostAsClientProcessTaskThread();
 
 		/**
-		* Check the incomplete results queue for complete result sets.
-		* Completed results set that are found are moved to the complete results queue.
+		* Complete a task that was processed locally on the host, once all of its parts have run.
+		* Merges the part results if the task was split, and places the result in the incomplete results queue.
+		* The result is discarded if another node already completed a copy of the task.
+		* @param task The task that was processed. Deleted once complete.
+		* @param tasks The task parts that were run.
+		* @param results The results of the task parts, in the same order as the task parts.
+		* @param split True if the task was split into parts, false if the original task was run as is.
+		* @param completeDepth The task part stack depth of the task that was processed, which the results are merged back to.
+		* @param start The time at which processing of the task started.
 		* @returns void.
 		*/
-		void checkForCompleteResults();
+		void completeHostAsClientTask(Task *task, std::vector<Task *> &tasks, std::vector<Result *> &results, bool split, size_t completeDepth,
+			std::chrono::steady_clock::time_point start);
+
+		/**
+		* Add a newly arrived result part to the incomplete result sets, and hand its set to the merge thread pool
+		* if this part completes it. Merged results that are themselves parts of a larger set are added in turn, 
+		* until a set is still waiting on other parts or the result for the initial task is complete. Complete 
+		* results are moved to the complete results queue.
+		* @param result The newly arrived result part.
+		* @returns True if the result was accepted, false if it does not fit its result set and was discarded.
+		*/
+		bool checkForCompleteResults(Result *result);
+
+		/**
+		* Merge a complete result set, and add the merged result to the incomplete result sets in turn.
+		* Sets larger than the merge fan in are merged as a tree, with runs of consecutive parts merged
+		* as separate jobs on the merge thread pool. To be run on the merge thread pool.
+		* @param set The parts of the set, ordered by task part number. Deleted once merged.
+		* @returns void.
+		*/
+		void mergeResultSet(std::vector<Result *> set);
 
 		/**
 		* Send sub tasks to connected clients, and/or to the host as if it were a client if host-as-client is enabled.
+		* Sub tasks are sent in priority order, then earliest deadline first. Background sub tasks are only
+		* sent to nodes with no other tasks.
 		* @returns void.
 		*/
 		void sendSubTasks();
 
+		/**
+		* Take chunks from tasks using a dynamic scheduling mode and add them to the sub task queue,
+		* one for each free place in the task windows of the nodes beyond the sub tasks already waiting.
+		* Chunks are taken from tasks in priority order, then earliest deadline first. Chunks of background
+		* tasks are only taken for nodes with no other tasks.
+		* @returns void.
+		*/
+		void scheduleChunks();
+
+		/**
+		* Should one piece of work be sent before another?
+		* Work with a higher priority comes first, then work with the earliest deadline, then work with no deadline.
+		* @param priorityA The priority of the first piece of work.
+		* @param deadlineA The host deadline of the first piece of work, or sf::Time::Zero for no deadline.
+		* @param priorityB The priority of the second piece of work.
+		* @param deadlineB The host deadline of the second piece of work, or sf::Time::Zero for no deadline.
+		* @returns True if the first piece of work should be sent before the second, false if not.
+		*/
+		static bool isMoreUrgent(Task::Priorities priorityA, sf::Time deadlineA, Task::Priorities priorityB, sf::Time deadlineB);
+
 		/**
 		* Add an elapsed task time to the benchmark list.
 		* @param elapsed The elapsed time in which a task was completed, in sf::Time format.
@@ -1,5 +1,15 @@
 #include "HostListener.h"
 #include "Host.h"
+#include "PacketPool.h"
+
+#if defined(CF_EPOLL_AVAILABLE)
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
 
 namespace cf
 {
@@ -11,7 +21,19 @@ namespace cf
 		listen = false;
 		listening = false;
 
+		//No clients to remove yet.
+		removalPending = false;
+
 		started = false;
+
+#if defined(CF_EPOLL_AVAILABLE)
+		epollFD = -1;
+
+		//Most packet processing is quick, as merges and sends are handled elsewhere.
+		packetThreadCount = 2;
+
+		readBuffer.resize(65536);
+#endif
 	}
 
 	HostListener::~HostListener()
@@ -29,12 +51,30 @@ namespace cf
 		//Initialise incoming connection listener.
 		tcpListener.listen(host->port);
 		tcpListener.setBlocking(false);
+
+#if defined(CF_EPOLL_AVAILABLE)
+		epollFD = epoll_create1(0);
+		if (epollFD < 0) CF_THROW("Unable to create epoll instance for the listener.");
+
+		//Watch the listener for pending connections. Events for the listener carry no client.
+		epoll_event event;
+		event.events = EPOLLIN | EPOLLET;
+		event.data.ptr = nullptr;
+		if (epoll_ctl(epollFD, EPOLL_CTL_ADD, tcpListener.getNativeHandle(), &event) != 0) CF_THROW("Unable to watch the listener socket.");
+
+		packetPool.start(packetThreadCount);
+
+		//Launch reactor thread.
+		listen = true;
+		listenerThread = std::thread([this] { reactorThread(); });
+#else
 		//Add the listener to the selector.
 		selector.add(tcpListener);
 
 		//Launch listener thread.
 		listen = true;
 		listenerThread = std::thread([this] { listenThread(); });
+#endif
 	}
 
 	void HostListener::stop()
@@ -48,6 +88,14 @@ namespace cf
 		//Wait for the listening thread to shut down.
 		if (listenerThread.joinable()) listenerThread.join();
 
+#if defined(CF_EPOLL_AVAILABLE)
+		//Process the packets already received, so each job gives its pooled packet back.
+		packetPool.stop(true);
+
+		close(epollFD);
+		epollFD = -1;
+#endif
+
 		started = false;
 	}
 
@@ -77,31 +125,7 @@ namespace cf
 					if (selector.isReady(tcpListener))
 					{
 						CF_SAY("New incoming connection started.", Settings::LogLevels::Debug);
-						//The listener is ready: there is a pending connection.
-						ClientDetails *newClient = new ClientDetails(CF_ID->getNextClientID());
-						//CF_SAY("listenThread incoming connection lock.");
-						std::unique_lock<std::mutex> lock(newClient->socketMutex);
-						if (tcpListener.accept(*newClient->socket) == sf::Socket::Done)
-						{
-							//Add the new client to the clients list.
-							std::unique_lock<std::mutex> clientsLock(host->clientsMutex);
-							host->clients.push_back(newClient);
-							clientsLock.unlock();
-
-							//Add the new client to the selector so that we will
-							//be notified when it sends something.
-							selector.add(*newClient->socket);
-
-							CF_SAY("Client ID " + std::to_string(newClient->getClientID()) + " from IP "
-								+ (*newClient->socket).getRemoteAddress().toString() + " connected.", Settings::LogLevels::Info);
-						}
-						else
-						{
-							CF_SAY("Incoming connection failed.", Settings::LogLevels::Debug);
-							//Error, we didn't get a new connection, delete the newly created client object.
-							delete newClient;
-							newClient = nullptr;
-						}
+						if (!acceptClient()) CF_SAY("Incoming connection failed.", Settings::LogLevels::Debug);
 					}
 					else
 					{
@@ -152,38 +176,8 @@ namespace cf
 				//If general abort has been called, exit this thread.
 				if (cf::ConsoleMessager::getInstance()->exceptionThrown) break;
 
-				//Erase dead clients from client list.
-				std::vector<ClientDetails *>::iterator deadIt;
-				std::unique_lock<std::mutex> clientsLock(host->clientsMutex);
-				for (deadIt = host->clients.begin(); deadIt != host->clients.end();)
-				{
-					ClientDetails *client = *deadIt;
-
-					bool removedOne = false;
-					if (client->remove)
-					{
-						//Check if any other process still using the client socket.
-						//If so, then try again later.
-						std::unique_lock<std::mutex> lock(client->socketMutex, std::try_to_lock);
-						if (lock.owns_lock())
-						{
-							//Remove the socket from the selector.
-							selector.remove(*client->socket);
-
-							//Immediately unlock as we are about to delete the object that contains the mutex.
-							lock.unlock();
-
-							delete client;
-							client = nullptr;
-							deadIt = host->clients.erase(deadIt);
-							removedOne = true;
-						}
-					}
-
-					if (!removedOne) deadIt++;
-
-				}
-				clientsLock.unlock();
+				//Erase dead clients from client list, if any have been marked for removal.
+				removeDeadClients();
 			}
 
 			listening = false;
@@ -211,10 +205,11 @@ namespace cf
 			std::unique_lock<std::mutex> lock(client->socketMutex);
 
 			// The client has sent some data, we can receive it
-			cf::WorkPacket *packet = new cf::WorkPacket();
+			//Packets come from the packet pool, so their buffers keep their capacity from earlier messages.
+			cf::WorkPacket *packet = CF_PACKETS->acquire();
 
-			//Enable compression if requested by host.
-			packet->setCompression(host->compression);
+			//Packets sent compressed are decompressed by this client's compression engine.
+			packet->setCompressionEngine(&client->compressionEngine);
 
 			sf::Socket::Status status;
 
@@ -228,106 +223,20 @@ namespace cf
 
 				if (status == sf::Socket::Status::Done)
 				{
-					if (packet->getFlag() == cf::WorkPacket::Flag::None)
+					//Data that can't be decoded comes from a misbehaving client, which is disconnected rather than stopping the host.
+					if (packet->hasReadError())
 					{
-						CF_SAY("Received unknown packet from client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Error);
-					}
-					else if (packet->getFlag() == cf::WorkPacket::Flag::Result)
-					{
-
-						CF_SAY("Received result packet from client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Info);
-
-						std::string type;
-						std::string subType;
-
-						*packet >> type;
-						*packet >> subType;
-
-						if (type != "Result")
-						{
-							std::string s = "Received unknown packet from client " + std::to_string(client->getClientID()) + ".";
-							CF_SAY(s, Settings::LogLevels::Error);
-							CF_THROW(s);
-						}
-
-						//Check subtype exists in the constuction map.
-						if (host->resultConstructMap.size() == 0 || host->resultConstructMap.find(subType) == host->resultConstructMap.end()) {
-							std::string s = "Unknown subtype in packet from client " + std::to_string(client->getClientID()) + ".";
-							CF_SAY(s, Settings::LogLevels::Error);
-							CF_THROW(s);
-						}
-
-						//Instantiate the resulting derived class.
-						cf::Result *result = host->resultConstructMap[subType]();
-
-						result->deserialize(*packet);
-
-						//Work out which client, if any, owns the task this result came from.
-						//If a client is found to own the task, remove the task from the client and delete it from memory.
-						//If no clients own this task, ignore it.
-						//The host is also checked in case it was running as a pseudo-client for this task.
-						if (host->markTaskFinished(result))
-						{
-							CF_SAY("Result packet from client " + std::to_string(client->getClientID()) + " is valid.", Settings::LogLevels::Info);
-
-							//Add result data to the host incomplete results queue.
-							std::unique_lock<std::mutex> lock3(host->resultsQueueIncompleteMutex);
-							host->resultQueueIncomplete.push_back(result);
-							lock3.unlock();
-
-							//Scan the incomplete results queue for complete results sets and move them to the complete results queue.
-							host->checkForCompleteResults();
-						}
-						else
-						{
-							CF_SAY("Result packet from client " + std::to_string(client->getClientID()) + " is INVALID. Rejecting.", Settings::LogLevels::Info);
-							delete result;
-							result = nullptr;
-						}
-
-						client->busy = false;
-
-					}
-					else
-					{
-						CF_THROW("Invalid flag data in packet from client " + std::to_string(client->getClientID()) + ". Are compression options set correctly on host and client?");
+						CF_SAY("Packet from client " + std::to_string(client->getClientID()) + " could not be decoded. Disconnecting.", Settings::LogLevels::Error);
+						disconnectClient(client);
+						break;
 					}
 
+					processPacket(client, *packet);
 					break;
-
 				}
 				else if (status == sf::Socket::Status::Disconnected)
 				{
-					CF_SAY("Client ID " + std::to_string(client->getClientID()) + " from IP "
-						+ (*client->socket).getRemoteAddress().toString() + " disconnected.", Settings::LogLevels::Info);
-					selector.remove(*client->socket);
-
-					//Disconnect the client.
-					client->socket->disconnect();
-
-					//Distribute this client's tasks to other available clients.
-					std::unique_lock<std::mutex> lock2(client->taskMutex);
-					std::vector<cf::Task *> redistTasks;
-					if (client->tasks.size() > 0)
-					{
-						CF_SAY("Client ID " + std::to_string(client->getClientID()) + " disconnected with unfinished tasks. Redistributing.", Settings::LogLevels::Info);
-						redistTasks = client->tasks;
-					}
-					client->tasks.clear();
-
-					lock2.unlock();
-
-					//Mark client data for erasure.
-					client->remove = true;
-
-					if (redistTasks.size() > 0)
-					{
-						//Redistribute sub tasks to other clients. 
-						std::unique_lock<std::mutex> lock3(host->subTaskQueueMutex);
-						host->subTaskQueue.insert(host->subTaskQueue.end(), redistTasks.begin(), redistTasks.end());
-						lock3.unlock();
-					}
-
+					disconnectClient(client);
 					break;
 				}
 				else if (status == sf::Socket::Status::Partial)
@@ -346,7 +255,7 @@ namespace cf
 				}
 			}
 
-			delete packet;
+			CF_PACKETS->release(packet);
 			packet = nullptr;
 
 			//Signal to our parent thread that this thread has finished.
@@ -365,4 +274,559 @@ namespace cf
 			}
 		}
 	}
+
+#if defined(CF_EPOLL_AVAILABLE)
+	void HostListener::reactorThread()
+	{
+		try
+		{
+
+			//If there is already a thread listening, abort.
+			if (listening) return;
+
+			//Register listening active.
+			listening = true;
+
+			const int maxEvents = 64;
+			epoll_event events[maxEvents];
+
+			CF_SAY("Listener reactor thread started. Waiting for clients to connect.", Settings::LogLevels::Info);
+			//Endless loop that waits for new connections and data from clients.
+			//Aborts if listening flag is set false.
+			while (listen)
+			{
+				//Wait for events on any socket. Only sockets with activity are returned.
+				//A timeout is set so the thread still responds to shutdown and exceptions thrown elsewhere.
+				int eventCount = epoll_wait(epollFD, events, maxEvents, 100);
+
+				for (int i = 0; i < eventCount; i++)
+				{
+					ClientDetails *client = static_cast<ClientDetails *>(events[i].data.ptr);
+
+					if (client == nullptr)
+					{
+						//Accept every pending connection, as the listener won't be reported again until a new one arrives.
+						while (acceptClient());
+					}
+					else
+					{
+						readClient(client);
+					}
+				}
+
+				//If general abort has been called, exit this thread.
+				if (cf::ConsoleMessager::getInstance()->exceptionThrown) break;
+
+				//Erase dead clients from client list, if any have been marked for removal.
+				removeDeadClients();
+			}
+
+			listening = false;
+			CF_SAY("Listener reactor thread ended.", Settings::LogLevels::Info);
+
+		}
+		catch (...)
+		{
+			//Do nothing with exceptions in threads. Main thread will see the exception message via ConsoleMessager object.
+
+			if (!cf::ConsoleMessager::getInstance()->exceptionThrown)
+			{
+				cf::ConsoleMessager::getInstance()->exceptionThrown = true;
+				cf::ConsoleMessager::getInstance()->exceptionMessage = "Unknown exception in HostListener reactorThread.";
+			}
+		}
+	}
+
+	void HostListener::readClient(ClientDetails *client)
+	{
+		//Skip clients marked for removal.
+		if (client->remove) return;
+
+		int handle = client->socket->getNativeHandle();
+
+		//Edge triggered notifications are only sent for new data, so read until the socket is empty.
+		//Complete packets are handed on after each read, so the buffer never holds more than one packet 
+		//plus one read, and packets too large to accept are refused as soon as their size arrives.
+		std::vector<char> &buffer = client->receiveBuffer;
+		bool disconnected = false;
+		while (!disconnected)
+		{
+			ssize_t received = recv(handle, readBuffer.data(), readBuffer.size(), 0);
+			if (received > 0)
+			{
+				buffer.insert(buffer.end(), readBuffer.data(), readBuffer.data() + received);
+			}
+			else if (received < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			else
+			{
+				//Nothing more to read for now, or the connection has closed.
+				disconnected = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+				break;
+			}
+
+			//Hand each complete packet to the packet thread pool. Packets are sent as a 32 bit size in network 
+			//byte order followed by the packet data.
+			size_t offset = 0;
+			while (buffer.size() - offset >= sizeof(sf::Uint32))
+			{
+				sf::Uint32 size;
+				std::memcpy(&size, buffer.data() + offset, sizeof(size));
+				size = ntohl(size);
+
+				//Refuse packets too large to accept, rather than buffering them.
+				if (size > host->maxPacketSize)
+				{
+					CF_SAY("Client " + std::to_string(client->getClientID()) + " sent a packet of " + std::to_string(size) + " bytes, more than the limit of " 
+						+ std::to_string(host->maxPacketSize) + " bytes. Disconnecting.", Settings::LogLevels::Error);
+					disconnected = true;
+					break;
+				}
+
+				//The rest of this packet hasn't arrived yet.
+				if (buffer.size() - offset - sizeof(size) < size) break;
+
+				//Copy the packet data into a pooled packet with room for it, to hand to the thread pool.
+				cf::WorkPacket *data = CF_PACKETS->acquire(cf::WorkPacket::Flag::None, size);
+				data->append(buffer.data() + offset + sizeof(size), size);
+				offset += sizeof(size) + size;
+
+				client->pendingPackets++;
+				packetPool.submit([this, client, data]()
+				{
+					processReceivedData(client, data);
+					client->pendingPackets--;
+				});
+			}
+			buffer.erase(buffer.begin(), buffer.begin() + offset);
+		}
+
+		if (disconnected)
+		{
+			buffer.clear();
+
+			//The client may already have been disconnected while its packets were processed.
+			std::unique_lock<std::mutex> lock(client->socketMutex);
+			if (!client->remove) disconnectClient(client);
+		}
+	}
+
+	void HostListener::processReceivedData(ClientDetails *client, WorkPacket *data)
+	{
+		//Obtain lock on the client socket.
+		std::unique_lock<std::mutex> lock(client->socketMutex);
+
+		//Packets from a client that has since disconnected are no longer needed.
+		if (client->remove)
+		{
+			CF_PACKETS->release(data);
+			return;
+		}
+
+		if (data->getDataSize() < sizeof(sf::Uint8))
+		{
+			CF_SAY("Invalid data from client. Ignoring.", Settings::LogLevels::Error);
+			CF_PACKETS->release(data);
+			return;
+		}
+
+		cf::WorkPacket *packet = CF_PACKETS->acquire(cf::WorkPacket::Flag::None, data->getDataSize());
+
+		//Packets sent compressed are decompressed by this client's compression engine.
+		packet->setCompressionEngine(&client->compressionEngine);
+
+		bool decoded = packet->setReceivedData(data->getData(), data->getDataSize());
+		CF_PACKETS->release(data);
+		data = nullptr;
+
+		//Data that can't be decoded comes from a misbehaving client, which is disconnected rather than stopping the host.
+		if (!decoded)
+		{
+			CF_SAY("Packet from client " + std::to_string(client->getClientID()) + " could not be decoded. Disconnecting.", Settings::LogLevels::Error);
+			CF_PACKETS->release(packet);
+			packet = nullptr;
+			disconnectClient(client);
+			return;
+		}
+
+		processPacket(client, *packet);
+
+		CF_PACKETS->release(packet);
+		packet = nullptr;
+	}
+#endif
+
+	bool HostListener::acceptClient()
+	{
+		ClientDetails *newClient = new ClientDetails(CF_ID->getNextClientID());
+		std::unique_lock<std::mutex> lock(newClient->socketMutex);
+		if (tcpListener.accept(*newClient->socket) != sf::Socket::Done)
+		{
+			//No connection was waiting, or it failed. Delete the newly created client object.
+			lock.unlock();
+			delete newClient;
+			newClient = nullptr;
+			return false;
+		}
+
+		//Packets sent in pieces, and packets sent compressed, are limited to the same size as packets sent whole.
+		newClient->chunkAssembler.setMaxMessageSize(host->maxPacketSize);
+		newClient->compressionEngine.setMaxDecompressedSize(host->maxPacketSize);
+
+		//Add the new client to the clients list.
+		std::unique_lock<std::mutex> clientsLock(host->clientsMutex);
+		host->clients.push_back(newClient);
+		clientsLock.unlock();
+
+		//Start watching the new client so that we will be notified when it sends something.
+		watchClient(newClient);
+
+		CF_SAY("Client ID " + std::to_string(newClient->getClientID()) + " from IP "
+			+ (*newClient->socket).getRemoteAddress().toString() + " connected. Waiting for handshake.", Settings::LogLevels::Info);
+
+		return true;
+	}
+
+	void HostListener::watchClient(ClientDetails *client)
+	{
+#if defined(CF_EPOLL_AVAILABLE)
+		//Edge triggered, so the reactor is only woken when new data arrives, and must read all of it.
+		epoll_event event;
+		event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+		event.data.ptr = client;
+		if (epoll_ctl(epollFD, EPOLL_CTL_ADD, client->socket->getNativeHandle(), &event) != 0)
+		{
+			CF_SAY("Unable to watch socket for client " + std::to_string(client->getClientID()) + ". Disconnecting.", Settings::LogLevels::Error);
+			client->socket->disconnect();
+			client->remove = true;
+			removalPending = true;
+		}
+#else
+		selector.add(*client->socket);
+#endif
+	}
+
+	void HostListener::unwatchClient(ClientDetails *client)
+	{
+#if defined(CF_EPOLL_AVAILABLE)
+		//Fails harmlessly if the socket is already closed or no longer watched.
+		epoll_ctl(epollFD, EPOLL_CTL_DEL, client->socket->getNativeHandle(), nullptr);
+#else
+		selector.remove(*client->socket);
+#endif
+	}
+
+	void HostListener::processPacket(ClientDetails *client, WorkPacket &packet)
+	{
+		if (packet.getFlag() == cf::WorkPacket::Flag::None)
+		{
+			CF_SAY("Received unknown packet from client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Error);
+		}
+		else if (packet.getFlag() == cf::WorkPacket::Flag::Handshake && !client->handshakeComplete)
+		{
+			CF_SAY("Received handshake packet from client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Info);
+			handshake(client, packet);
+		}
+		else if (!client->handshakeComplete)
+		{
+			//A misbehaving client is disconnected, rather than stopping the host.
+			CF_SAY("Client " + std::to_string(client->getClientID()) + " sent data before completing the connection handshake. Disconnecting.", Settings::LogLevels::Error);
+			disconnectClient(client);
+		}
+		else if (packet.getFlag() == cf::WorkPacket::Flag::Chunk)
+		{
+			//Process the packet this is a piece of, once all its pieces have arrived.
+			cf::WorkPacket *whole = nullptr;
+			if (!client->chunkAssembler.add(packet, whole))
+			{
+				CF_SAY("Invalid chunk packet from client " + std::to_string(client->getClientID()) + ". Disconnecting.", Settings::LogLevels::Error);
+				disconnectClient(client);
+			}
+			else if (whole != nullptr)
+			{
+				CF_SAY("Received all pieces of a large packet from client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Debug);
+				processPacket(client, *whole);
+				CF_PACKETS->release(whole);
+				whole = nullptr;
+			}
+		}
+		else if (packet.getFlag() == cf::WorkPacket::Flag::Result)
+		{
+
+			CF_SAY("Received result packet from client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Info);
+
+			if (!receiveResult(client, packet))
+			{
+				disconnectClient(client);
+				return;
+			}
+
+			//Wake the task watcher to send more tasks to this client, now that a place in its task window is free.
+			host->notifyTaskEvent();
+
+		}
+		else if (packet.getFlag() == cf::WorkPacket::Flag::Batch)
+		{
+			sf::Uint8 batchFlag;
+			packet >> batchFlag;
+
+			if (!packet || batchFlag != cf::WorkPacket::Flag::Result)
+			{
+				CF_SAY("Received unknown batch packet from client " + std::to_string(client->getClientID()) + ". Disconnecting.", Settings::LogLevels::Error);
+				disconnectClient(client);
+				return;
+			}
+
+			//Unpack every result in the batch, then wake the task watcher once for all of them.
+			unsigned int count = 0;
+			while (!packet.endOfPacket())
+			{
+				if (!receiveResult(client, packet))
+				{
+					disconnectClient(client);
+					return;
+				}
+				count++;
+			}
+
+			CF_SAY("Received batch of " + std::to_string(count) + " results from client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Info);
+
+			//Wake the task watcher to send more tasks to this client, now that places in its task window are free.
+			host->notifyTaskEvent();
+
+		}
+		else
+		{
+			CF_SAY("Invalid flag data in packet from client " + std::to_string(client->getClientID()) 
+				+ ". Are compression options set correctly on host and client? Disconnecting.", Settings::LogLevels::Error);
+			disconnectClient(client);
+		}
+	}
+
+	bool HostListener::receiveResult(ClientDetails *client, WorkPacket &packet)
+	{
+		//Instantiate the resulting derived class named by the header.
+		cf::Result *result = host->resultTypes.readHeader(packet);
+
+		if (result == nullptr)
+		{
+			CF_SAY("Unknown result type in packet from client " + std::to_string(client->getClientID()) + ". Disconnecting.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		result->deserialize(packet);
+
+		//Results whose data could not be read, such as a malformed array, are rejected.
+		if (!packet || packet.hasReadError())
+		{
+			CF_SAY("Invalid result data in packet from client " + std::to_string(client->getClientID()) + ". Disconnecting.", Settings::LogLevels::Error);
+			delete result;
+			result = nullptr;
+			return false;
+		}
+
+		//Results with malformed task part stacks can't be matched to their task. The client's tasks are redistributed.
+		if (!ResultSetIndex::isValid(result))
+		{
+			CF_SAY("Invalid task part numbers in result from client " + std::to_string(client->getClientID()) + ". Disconnecting.", Settings::LogLevels::Error);
+			delete result;
+			result = nullptr;
+			return false;
+		}
+
+		//Partial results streamed by a running task part go straight to the application.
+		//Work out which client, if any, owns the task this result came from.
+		//If a client is found to own the task, remove the task from the client and delete it from memory.
+		//If no clients own this task, ignore it.
+		//The host is also checked in case it was running as a pseudo-client for this task.
+		if (result->isPartial())
+		{
+			host->deliverPartialResult(result);
+			result = nullptr;
+		}
+		else if (host->markTaskFinished(result, client))
+		{
+			CF_SAY("Result packet from client " + std::to_string(client->getClientID()) + " is valid.", Settings::LogLevels::Info);
+
+			//Add the result to its result set, and move it to the complete results queue if the set is complete.
+			//A part that does not fit its set has been discarded.
+			if (!host->checkForCompleteResults(result))
+			{
+				CF_SAY("Result from client " + std::to_string(client->getClientID()) + " does not match its result set. Disconnecting.", Settings::LogLevels::Error);
+				return false;
+			}
+		}
+		else
+		{
+			CF_SAY("Result packet from client " + std::to_string(client->getClientID()) + " is INVALID. Rejecting.", Settings::LogLevels::Info);
+			delete result;
+			result = nullptr;
+		}
+
+		return true;
+	}
+
+	void HostListener::disconnectClient(ClientDetails *client)
+	{
+		CF_SAY("Client ID " + std::to_string(client->getClientID()) + " from IP "
+			+ (*client->socket).getRemoteAddress().toString() + " disconnected.", Settings::LogLevels::Info);
+		unwatchClient(client);
+
+		//Disconnect the client.
+		client->socket->disconnect();
+
+		//Mark client data for erasure. This is done before the client's tasks are untracked, so nothing 
+		//checking the client while the in flight tasks are locked will track a new task against it afterwards.
+		//The client isn't deleted while its socket is locked.
+		client->remove = true;
+		removalPending = true;
+
+		//Distribute this client's tasks to other available clients.
+		std::vector<cf::Task *> redistTasks = host->untrackClientTasks(client);
+		if (redistTasks.size() > 0)
+		{
+			CF_SAY("Client ID " + std::to_string(client->getClientID()) + " disconnected with unfinished tasks. Redistributing.", Settings::LogLevels::Info);
+		}
+
+		if (redistTasks.size() > 0)
+		{
+			//Redistribute sub tasks to other clients. 
+			std::unique_lock<std::mutex> lock3(host->subTaskQueueMutex);
+			host->subTaskQueue.insert(host->subTaskQueue.end(), redistTasks.begin(), redistTasks.end());
+			lock3.unlock();
+
+			//Wake the task watcher to send the redistributed tasks.
+			host->notifyTaskEvent();
+		}
+	}
+
+	void HostListener::removeDeadClients()
+	{
+		//Only sweep the clients list when a client has been marked for removal.
+		if (!removalPending.exchange(false)) return;
+
+		std::vector<ClientDetails *>::iterator deadIt;
+		std::unique_lock<std::mutex> clientsLock(host->clientsMutex);
+		for (deadIt = host->clients.begin(); deadIt != host->clients.end();)
+		{
+			ClientDetails *client = *deadIt;
+
+			bool removedOne = false;
+			if (client->remove && client->pendingPackets == 0)
+			{
+				//Check if any other process still using the client socket.
+				//If so, then try again later.
+				std::unique_lock<std::mutex> lock(client->socketMutex, std::try_to_lock);
+				if (lock.owns_lock())
+				{
+					//Stop watching the socket.
+					unwatchClient(client);
+
+					//Stop sending to the client.
+					host->sender.removeClient(client);
+
+					//Immediately unlock as we are about to delete the object that contains the mutex.
+					lock.unlock();
+
+					delete client;
+					client = nullptr;
+					deadIt = host->clients.erase(deadIt);
+					removedOne = true;
+				}
+			}
+
+			if (!removedOne)
+			{
+				//Try again on the next sweep if the client is marked for removal but still in use.
+				if (client->remove) removalPending = true;
+				deadIt++;
+			}
+
+		}
+		clientsLock.unlock();
+	}
+
+	void HostListener::handshake(ClientDetails *client, WorkPacket &packet)
+	{
+		bool compressionRequested;
+
+		client->capabilities.deserialize(packet);
+
+		bool accepted = client->capabilities.protocolVersion == NodeCapabilities::PROTOCOL_VERSION;
+
+		//Only read the rest of the handshake if we understand its layout.
+		if (accepted) packet >> compressionRequested;
+
+		//Use compression if either side asked for it and the client supports it.
+		bool useCompression = accepted && (host->compression || compressionRequested)
+			&& (client->capabilities.codecs & NodeCapabilities::Codecs::CodecZlib);
+
+		//Reply with the host capabilities and the outcome of the handshake.
+		cf::WorkPacket reply(cf::WorkPacket::Flag::Handshake);
+		host->capabilities.serialize(reply);
+		reply << accepted;
+		reply << useCompression;
+
+		//Tell the client the IDs the host uses for each task and result subtype.
+		if (accepted)
+		{
+			client->knownTaskTypes = host->taskTypes.serializeNames(reply);
+			host->resultTypes.serializeNames(reply);
+
+			//Send the preset compression dictionaries, and use them for this client.
+			std::unique_lock<std::mutex> dictionariesLock(host->compressionDictionariesMutex);
+			reply << (sf::Uint8)host->compressionDictionaries.size();
+			for (auto &d : host->compressionDictionaries)
+			{
+				reply << d.first;
+				reply.writeArray(d.second);
+			}
+			client->compressionEngine.setDictionaries(host->compressionDictionaries);
+			dictionariesLock.unlock();
+
+			client->compressionEngine.setLevel(host->compressionLevel);
+		}
+
+		//Socket is in non blocking mode, so more than one call to send may be needed to send all the data.
+		sf::Socket::Status status;
+		while (!cf::ConsoleMessager::getInstance()->exceptionThrown)
+		{
+			status = client->socket->send(reply);
+			if (status == sf::Socket::Status::Done)
+			{
+				break;
+			}
+			else if (status != sf::Socket::Status::Partial)
+			{
+				std::string s = "Error while sending handshake to client " + std::to_string(client->getClientID()) + ". Aborting.";
+				CF_SAY(s, Settings::LogLevels::Error);
+				CF_THROW(s);
+			}
+		}
+
+		if (!accepted)
+		{
+			CF_SAY("Client " + std::to_string(client->getClientID()) + " uses protocol version " + std::to_string(client->capabilities.protocolVersion)
+				+ " but the host uses version " + std::to_string(NodeCapabilities::PROTOCOL_VERSION) + ". Disconnecting.", Settings::LogLevels::Error);
+			unwatchClient(client);
+			client->socket->disconnect();
+
+			//Mark client data for erasure.
+			client->remove = true;
+			removalPending = true;
+			return;
+		}
+
+		client->compression = useCompression;
+		client->handshakeComplete = true;
+
+		CF_SAY("Client " + std::to_string(client->getClientID()) + " ready with " + std::to_string(client->capabilities.threads)
+			+ " thread(s), calibration score " + std::to_string(client->capabilities.calibrationScore) + ", SIMD features: "
+			+ client->capabilities.getSIMDFeaturesString() + ", compression " + (useCompression ? "on." : "off."), Settings::LogLevels::Info);
+
+		//Wake the task watcher to send tasks to the new client.
+		host->notifyTaskEvent();
+	}
 }
\ No newline at end of file
@@ -1,10 +1,19 @@
 #pragma once
 #include <atomic>
+#include <vector>
+#include <thread>
 #include "DllExport.h"
 #include <SFML\Network.hpp>
 #include "ClientDetails.hpp"
+#include "NativeSockets.hpp"
+#include "ThreadPool.h"
 #include "ConsoleMessager.hpp"
 
+//On Linux, the listener uses an epoll reactor instead of a socket selector and receive threads.
+#if defined(__linux__)
+#define CF_EPOLL_AVAILABLE
+#endif
+
 namespace cf
 {
 	//Forward declarations.
@@ -12,6 +21,9 @@ namespace cf
 
 	/**
 	* HostListener class. Manages the thread that listens for incoming connections and messages from clients.
+	* On Linux, a reactor thread waits on an epoll instance with edge triggered notifications, reads whatever 
+	* data each active socket has, assembles it into packets per connection, and hands complete packets to 
+	* a small thread pool. Elsewhere, a socket selector is used and each incoming packet is received by a thread of its own.
 	* This is an essential component of the Host class.
 	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
 	*/
@@ -55,7 +67,7 @@ namespace cf
 		sf::SocketSelector selector;
 
 		//Listener for incoming connections
-		sf::TcpListener tcpListener;
+		NativeTcpListener tcpListener;
 
 		//Should the listener thread be listening for connections?
 		std::atomic<bool> listen;
@@ -63,6 +75,9 @@ namespace cf
 		//Is the server listening for connections?
 		std::atomic<bool> listening;
 
+		//Are there clients marked for removal that haven't been deleted yet?
+		std::atomic<bool> removalPending;
+
 		//Connection listening thread.
 		std::thread listenerThread;
 
@@ -72,6 +87,20 @@ namespace cf
 		//Indicators for when client data recieve threads have finished.
 		std::vector<std::atomic<bool> *> clientReceiveThreadsFinishedFlags;
 
+#if defined(CF_EPOLL_AVAILABLE)
+		//Epoll instance watching the listener and client sockets.
+		int epollFD;
+
+		//Thread pool used to process packets assembled by the reactor.
+		ThreadPool packetPool;
+
+		//Number of threads in the packet processing thread pool.
+		unsigned int packetThreadCount;
+
+		//Buffer used by the reactor to read from client sockets.
+		std::vector<char> readBuffer;
+#endif
+
 		/**
 		* Listen for incoming connections.
 		* To be used by a dedicated thread.
@@ -85,5 +114,96 @@ namespace cf
 		* @returns void.
 		*/
 		void clientReceiveThread(ClientDetails *client, std::atomic<bool> *cFlag);
+
+		/**
+		* Accept a pending incoming connection, add the new client to the host and start watching its socket.
+		* @returns True if a connection was accepted, false if there was none or it failed.
+		*/
+		bool acceptClient();
+
+		/**
+		* Start watching a client socket for incoming data.
+		* @param client The client to watch.
+		* @returns void.
+		*/
+		void watchClient(ClientDetails *client);
+
+		/**
+		* Stop watching a client socket for incoming data.
+		* @param client The client to stop watching.
+		* @returns void.
+		*/
+		void unwatchClient(ClientDetails *client);
+
+		/**
+		* Act on a complete packet received from a client.
+		* The caller must hold the client socket lock.
+		* @param client The client that sent the packet.
+		* @param packet The packet received from the client.
+		* @returns void.
+		*/
+		void processPacket(ClientDetails *client, WorkPacket &packet);
+
+		/**
+		* Read one result from a packet received from a client, and act on it.
+		* The caller must hold the client socket lock.
+		* @param client The client that sent the result.
+		* @param packet The packet to read the result from.
+		* @returns True if a result was read, false if the packet held an unknown result type.
+		*/
+		bool receiveResult(ClientDetails *client, WorkPacket &packet);
+
+		/**
+		* Disconnect a client that has closed its connection, and redistribute its unfinished tasks.
+		* The caller must hold the client socket lock.
+		* @param client The client that disconnected.
+		* @returns void.
+		*/
+		void disconnectClient(ClientDetails *client);
+
+		/**
+		* Delete clients marked for removal that are no longer in use.
+		* Does nothing unless a client has been marked for removal since the last time all such clients were deleted.
+		* @returns void.
+		*/
+		void removeDeadClients();
+
+#if defined(CF_EPOLL_AVAILABLE)
+		/**
+		* Wait for epoll events on the listener and client sockets, and act on each active socket.
+		* To be used by a dedicated thread.
+		* @returns void.
+		*/
+		void reactorThread();
+
+		/**
+		* Read all data available on a client socket, and hand each packet it completes to the packet thread pool.
+		* Disconnects the client if its connection has closed.
+		* @param client The client to read from.
+		* @returns void.
+		*/
+		void readClient(ClientDetails *client);
+
+		/**
+		* Decode and act on a packet assembled by the reactor.
+		* To be used by the packet thread pool.
+		* @param client The client that sent the packet.
+		* @param data The packet data, not including the packet size, held in a pooled packet.
+		* It is given back to the packet pool once decoded.
+		* @returns void.
+		*/
+		void processReceivedData(ClientDetails *client, WorkPacket *data);
+#endif
+
+		/**
+		* Complete the connection handshake with a client, using the handshake packet received from it.
+		* Records the client capabilities, agrees on network compression and replies with the host capabilities.
+		* Clients using a different protocol version are rejected and disconnected.
+		* The caller must hold the client socket lock.
+		* @param client The client that sent the handshake.
+		* @param packet The handshake packet received from the client.
+		* @returns void.
+		*/
+		void handshake(ClientDetails *client, WorkPacket &packet);
 	};
 }
\ No newline at end of file
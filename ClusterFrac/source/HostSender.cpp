@@ -1,89 +1,266 @@
 #include "HostSender.h"
 #include "Host.h"
+#include "PacketPool.h"
 
 namespace cf
 {
 	HostSender::HostSender(Host *newHost)
 	{
 		host = newHost;
+
+		//Sender default status.
+		run = false;
+		started = false;
+
+		//A couple of threads is enough to keep many sockets busy, as no thread ever waits on one socket.
+		ioThreadCount = 2;
+
+		maxBatchBytes = 65536;
 	}
 
 	HostSender::~HostSender()
 	{
-		
+		stop();
+	}
+
+	void HostSender::start()
+	{
+		//If sender is already started, do nothing.
+		if (started) return;
+
+		started = true;
+
+		//Launch I/O threads.
+		run = true;
+		for (unsigned int i = 0; i < ioThreadCount; i++)
+		{
+			ioThreads.push_back(std::thread([this] { ioThread(); }));
+		}
+	}
+
+	void HostSender::stop()
+	{
+		//If already stopped, do nothing.
+		if (!started) return;
+
+		//Signal the I/O threads to shut down.
+		std::unique_lock<std::mutex> lock(senderMutex);
+		run = false;
+		lock.unlock();
+		readyCondition.notify_all();
+
+		//Wait for the I/O threads to shut down.
+		for (auto &thread : ioThreads)
+		{
+			if (thread.joinable()) thread.join();
+		}
+		ioThreads.clear();
+
+		readyClients.clear();
+		scheduledClients.clear();
+		batchWaitClients.clear();
+		activeClients.clear();
+
+		started = false;
 	}
 
 	void HostSender::sendTask(ClientDetails *client, Task *task)
+	{
+		unsigned int batchSize = host->batchSize;
+
+		//Send the task in a packet of its own if batching is off.
+		if (batchSize <= 1)
+		{
+			cf::WorkPacket *packet = CF_PACKETS->acquire(cf::WorkPacket::Flag::Task);
+
+			//Allow compression if agreed with this client. The engine decides whether each packet is worth compressing.
+			packet->setCompression(client->compression);
+			packet->setCompressionEngine(&client->compressionEngine);
+
+			host->taskTypes.writeHeader(*packet, task, client->knownTaskTypes);
+			task->serialize(*packet);
+
+			queuePacket(client, packet);
+
+			CF_SAY("Task queued for client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Debug);
+			return;
+		}
+
+		std::unique_lock<std::mutex> queueLock(client->sendQueueMutex);
+
+		//Start a new batch if the client has none open.
+		if (client->openBatch == nullptr)
+		{
+			client->openBatch = CF_PACKETS->acquire(cf::WorkPacket::Flag::Batch);
+
+			//Allow compression if agreed with this client. The engine decides whether each packet is worth compressing.
+			client->openBatch->setCompression(client->compression);
+			client->openBatch->setCompressionEngine(&client->compressionEngine);
+
+			*client->openBatch << (sf::Uint8)cf::WorkPacket::Flag::Task;
+
+			client->openBatchCount = 0;
+			client->openBatchStarted = std::chrono::steady_clock::now();
+		}
+
+		host->taskTypes.writeHeader(*client->openBatch, task, client->knownTaskTypes);
+		task->serialize(*client->openBatch);
+		client->openBatchCount++;
+
+		//Full batches are sent straight away.
+		if (client->openBatchCount >= batchSize || client->openBatch->getDataSize() >= maxBatchBytes) closeBatch(client, true);
+
+		queueLock.unlock();
+
+		scheduleClient(client);
+
+		CF_SAY("Task queued in batch for client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Debug);
+	}
+
+	void HostSender::sendCancel(ClientDetails *client, unsigned __int64 taskID)
+	{
+		cf::WorkPacket *packet = CF_PACKETS->acquire(cf::WorkPacket::Flag::Cancel);
+
+		//Allow compression if agreed with this client. The engine decides whether each packet is worth compressing.
+		packet->setCompression(client->compression);
+		packet->setCompressionEngine(&client->compressionEngine);
+
+		*packet << (sf::Uint64)taskID;
+
+		queuePacket(client, packet);
+
+		CF_SAY("Cancel for task " + std::to_string(taskID) + " queued for client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Debug);
+	}
+
+	void HostSender::removeClient(ClientDetails *client)
 	{
 		std::unique_lock<std::mutex> lock(senderMutex);
-		taskSendThreads.push_back(std::thread([this, client, task]() { sendTaskThread(client, task); }));
-		CF_SAY("Task send thread started for client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Debug);
+
+		readyClients.erase(std::remove(readyClients.begin(), readyClients.end(), client), readyClients.end());
+		scheduledClients.erase(client);
+		batchWaitClients.erase(client);
+
+		//Wait for any I/O thread still sending to this client. It won't schedule the client again.
+		activeCondition.wait(lock, [this, client] { return activeClients.count(client) == 0; });
+	}
+
+	void HostSender::queuePacket(ClientDetails *client, WorkPacket *packet)
+	{
+		std::unique_lock<std::mutex> queueLock(client->sendQueueMutex);
+		closeBatch(client, true);
+		client->sendQueue.push_back(packet);
+		queueLock.unlock();
+
+		scheduleClient(client);
 	}
 
-	void HostSender::waitForComplete()
+	void HostSender::scheduleClient(ClientDetails *client)
 	{
+		//Schedule the client, unless it is already waiting for or being served by an I/O thread.
+		//A client waiting on its batch window is served now, as it may have more to send.
 		std::unique_lock<std::mutex> lock(senderMutex);
-		//Wait for threads to finish.
-		for (auto &thread : taskSendThreads)
+		if (scheduledClients.insert(client).second || batchWaitClients.erase(client) > 0)
 		{
-			thread.join();
+			readyClients.push_back(client);
+			lock.unlock();
+			readyCondition.notify_one();
 		}
-		taskSendThreads.clear();
 	}
 
-	void HostSender::sendTaskThread(ClientDetails *client, Task *task) const
+	void HostSender::closeBatch(ClientDetails *client, bool force)
+	{
+		if (client->openBatch == nullptr) return;
+
+		if (!force && std::chrono::steady_clock::now() - client->openBatchStarted < std::chrono::milliseconds(host->batchWindowMilliseconds)) return;
+
+		client->sendQueue.push_back(client->openBatch);
+		client->openBatch = nullptr;
+		client->openBatchCount = 0;
+	}
+
+	void HostSender::ioThread()
 	{
 		try
 		{
+			//Number of turns in a row that did not send anything.
+			size_t idleTurns = 0;
 
-			bool done = false;
-			while (!done && !cf::ConsoleMessager::getInstance()->exceptionThrown)
+			while (run && !cf::ConsoleMessager::getInstance()->exceptionThrown)
 			{
+				std::unique_lock<std::mutex> lock(senderMutex);
 
-				std::unique_lock<std::mutex> lock(client->socketMutex, std::try_to_lock);
-				if (lock.owns_lock())
+				//Wait for clients with messages to send, or for the first open batch window to end.
+				//A timeout is set so the thread still responds to exceptions thrown elsewhere.
+				if (run && readyClients.size() == 0)
 				{
-					CF_SAY("Sending task to client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Info);
+					std::chrono::steady_clock::time_point wakeTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+					for (auto &b : batchWaitClients) wakeTime = std::min(wakeTime, b.second);
+					readyCondition.wait_until(lock, wakeTime);
+				}
 
-					cf::WorkPacket packet(cf::WorkPacket::Flag::Task);
+				//Clients whose batch window has ended have a batch to send.
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				for (auto it = batchWaitClients.begin(); it != batchWaitClients.end();)
+				{
+					if (it->second <= now)
+					{
+						readyClients.push_back(it->first);
+						it = batchWaitClients.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
 
-					//Enable compression if requested.
-					packet.setCompression(host->compression);
+				if (!run || readyClients.size() == 0) continue;
 
-					task->serialize(packet);
+				//Every waiting client had its turn without sending anything, so their sockets are full or busy. 
+				//Rest briefly rather than spinning.
+				if (idleTurns > readyClients.size())
+				{
+					idleTurns = 0;
+					readyCondition.wait_for(lock, std::chrono::milliseconds(1));
+					if (!run || readyClients.size() == 0) continue;
+				}
 
-					//Socket is in non blocking mode, so more than one call to send may be needed to send all the data.
-					sf::Socket::Status status;
-					while (!cf::ConsoleMessager::getInstance()->exceptionThrown)
-					{
-						status = client->socket->send(packet);
-						if (status == sf::Socket::Status::Done)
-						{
-							CF_SAY("Sending task finished for client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Info);
-							break;
-						}
-						else if (status == sf::Socket::Status::Partial)
-						{
-							//Partial send, so keep looping to continue sending.
-							CF_SAY("Partial send to client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Debug);
-						}
-						else
-						{
-							std::string s = "Error while sending to client " + std::to_string(client->getClientID()) + ". Aborting.";
-							CF_SAY(s, Settings::LogLevels::Error);
-							CF_THROW(s);
-							break;
-						}
-					};
-
-					packet.clear();
-					lock.unlock();
-
-					done = true;
+				ClientDetails *client = readyClients.front();
+				readyClients.pop_front();
+				activeClients.insert(client);
+				lock.unlock();
 
-				}
+				bool sent = serveClient(client);
+				idleTurns = sent ? 0 : idleTurns + 1;
 
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				lock.lock();
+				activeClients.erase(client);
+
+				//Clients with more to send go to the back of the line, so every client gets a turn.
+				//Clients with only an open batch wait for its window to end, rather than being served again straight away.
+				//Clients removed while being served are not scheduled again.
+				if (scheduledClients.count(client) > 0)
+				{
+					std::unique_lock<std::mutex> queueLock(client->sendQueueMutex);
+					bool more = client->sendQueue.size() > 0;
+					bool batchOpen = client->openBatch != nullptr;
+					std::chrono::steady_clock::time_point batchEnd = client->openBatchStarted + std::chrono::milliseconds(host->batchWindowMilliseconds);
+					queueLock.unlock();
+
+					if (more)
+					{
+						readyClients.push_back(client);
+					}
+					else if (batchOpen)
+					{
+						batchWaitClients[client] = batchEnd;
+					}
+					else
+					{
+						scheduledClients.erase(client);
+					}
+				}
+				lock.unlock();
+				activeCondition.notify_all();
 			}
 		}
 		catch (...)
@@ -93,8 +270,101 @@ namespace cf
 			if (!cf::ConsoleMessager::getInstance()->exceptionThrown)
 			{
 				cf::ConsoleMessager::getInstance()->exceptionThrown = true;
-				cf::ConsoleMessager::getInstance()->exceptionMessage = "Unknown exception in HostSender sendTaskThread.";
+				cf::ConsoleMessager::getInstance()->exceptionMessage = "Unknown exception in HostSender ioThread.";
+			}
+		}
+	}
+
+	bool HostSender::serveClient(ClientDetails *client)
+	{
+		//Attempt to get socket lock. Try again on the client's next turn if the listener is receiving on this socket.
+		std::unique_lock<std::mutex> lock(client->socketMutex, std::try_to_lock);
+		if (!lock.owns_lock()) return false;
+
+		bool sent = false;
+
+		//Only this thread removes packets from the queue while it serves the client, so the front packet
+		//stays in place while it is sent without holding the queue lock.
+		std::unique_lock<std::mutex> queueLock(client->sendQueueMutex);
+
+		//Send the open batch once its window has passed.
+		closeBatch(client, false);
+
+		std::size_t chunkSize = host->chunkSize;
+
+		while (client->sendQueue.size() > 0)
+		{
+			cf::WorkPacket *packet = client->sendQueue.front();
+			queueLock.unlock();
+
+			//Large packets are sent in pieces. Each chunk packet is written once the one before it has been sent.
+			cf::WorkPacket *frame = packet;
+			if (client->chunkFrame != nullptr || packet->needsChunks(chunkSize))
+			{
+				if (client->chunkFrame == nullptr)
+				{
+					client->chunkFrame = CF_PACKETS->acquire();
+					packet->nextChunk(*client->chunkFrame, client->nextChunkMessageID, chunkSize);
+				}
+				frame = client->chunkFrame;
+			}
+
+			//Socket is in non blocking mode, so the packet may only be partly sent. The packet
+			//remembers how much was sent, and the rest is sent on the client's next turn.
+			sf::Socket::Status status = client->socket->send(*frame);
+
+			queueLock.lock();
+			if (status == sf::Socket::Status::Done)
+			{
+				frame->onSent();
+				sent = true;
+
+				if (frame != packet)
+				{
+					//Move on to the next piece, until the whole packet has been sent.
+					if (packet->nextChunk(*frame, client->nextChunkMessageID, chunkSize)) continue;
+
+					CF_PACKETS->release(client->chunkFrame);
+					client->chunkFrame = nullptr;
+					client->nextChunkMessageID++;
+				}
+
+				//Sent packets go back to the packet pool, keeping their buffers for the next message.
+				client->sendQueue.pop_front();
+				CF_PACKETS->release(packet);
+				packet = nullptr;
+			}
+			else if (status == sf::Socket::Status::Partial)
+			{
+				CF_SAY("Partial send to client " + std::to_string(client->getClientID()) + ".", Settings::LogLevels::Debug);
+				sent = true;
+				break;
+			}
+			else if (status == sf::Socket::Status::NotReady)
+			{
+				//Socket send buffer is full.
+				break;
+			}
+			else
+			{
+				//The listener deals with disconnected clients. Drop anything still waiting to be sent.
+				//The packets came from the packet pool, so they go back to it.
+				CF_SAY("Error while sending to client " + std::to_string(client->getClientID()) + ". Discarding unsent messages.", Settings::LogLevels::Error);
+				for (auto &p : client->sendQueue)
+				{
+					CF_PACKETS->release(p);
+					p = nullptr;
+				}
+				client->sendQueue.clear();
+				CF_PACKETS->release(client->openBatch);
+				client->openBatch = nullptr;
+				client->openBatchCount = 0;
+				CF_PACKETS->release(client->chunkFrame);
+				client->chunkFrame = nullptr;
+				break;
 			}
 		}
+
+		return sent;
 	}
 }
\ No newline at end of file
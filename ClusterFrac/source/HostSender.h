@@ -2,6 +2,13 @@
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <chrono>
+#include <condition_variable>
 #include "DllExport.h"
 #include <SFML\Network.hpp>
 #include "ClientDetails.hpp"
@@ -14,7 +21,10 @@ namespace cf
 	class Host;
 
 	/**
-	* HostSender class. Manages the thread that sends messages to clients.
+	* HostSender class. Manages the threads that send messages to clients.
+	* Messages are queued on each client's outbound queue, and a small fixed set of I/O threads drains 
+	* the queues using non blocking writes, taking turns between clients. Queueing a message never waits 
+	* on the network, so one slow client does not hold up sending to the others.
 	* This is an essential component of the Host class.
 	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
 	*/
@@ -35,7 +45,24 @@ namespace cf
 		DLL ~HostSender();
 
 		/**
-		* Send a task to the selected client.
+		* Start the I/O threads.
+		* If the sender is already started, this has no effect.
+		* @returns void.
+		*/
+		DLL void start();
+
+		/**
+		* Stop the I/O threads.
+		* Messages that have not been sent are left on the client outbound queues.
+		* If the sender is already stopped, this has no effect.
+		* @returns void.
+		*/
+		DLL void stop();
+
+		/**
+		* Queue a task to be sent to the selected client. This call does not block.
+		* The task is added to the client's open batch packet if batching is enabled on the host.
+		* The task is serialized straight away, so the caller may delete it at any time after this call.
 		* @param client The client to send the task to.
 		* @param task The task to send to the client.
 		* @returns void.
@@ -43,29 +70,100 @@ namespace cf
 		DLL void sendTask(ClientDetails *client, Task *task);
 
 		/**
-		* Wait for all tasks being sent to clients to complete sending.
+		* Queue a message telling the selected client to cancel all parts of a task. This call does not block.
+		* @param client The client to send the cancel message to.
+		* @param taskID The initial task ID of the task to cancel.
 		* @returns void.
 		*/
-		DLL void waitForComplete();
+		DLL void sendCancel(ClientDetails *client, unsigned __int64 taskID);
+
+		/**
+		* Stop sending to a client that is about to be deleted.
+		* Waits if an I/O thread is currently sending to the client.
+		* @param client The client to stop sending to.
+		* @returns void.
+		*/
+		DLL void removeClient(ClientDetails *client);
 
 	private:
 
 		//The host object this host sender belongs to.
 		Host *host;
 
+		//Has the sender been started?
+		bool started;
+
+		//Should the I/O threads continue to run?
+		std::atomic<bool> run;
+
+		//Number of I/O threads to start.
+		unsigned int ioThreadCount;
+
+		//Size at which a batch packet is sent without waiting for more tasks, in bytes.
+		size_t maxBatchBytes;
+
+		//Threads that drain the client outbound queues.
+		std::vector<std::thread> ioThreads;
+
+		//Clients with messages waiting to be sent, in the order they will be served.
+		std::deque<ClientDetails *> readyClients;
+
+		//Clients that are waiting to be served or being served by an I/O thread.
+		std::unordered_set<ClientDetails *> scheduledClients;
+
+		//Scheduled clients with nothing to send but an open batch, and the time the batch window ends.
+		//They are served again once the window ends, or when another message is queued for them.
+		std::unordered_map<ClientDetails *, std::chrono::steady_clock::time_point> batchWaitClients;
+
+		//Clients being served by an I/O thread.
+		std::unordered_set<ClientDetails *> activeClients;
+
 		//Mutex to lock the sender object.
 		std::mutex senderMutex;
 
-		//Spawn a sender thread for each task.
-		std::vector<std::thread> taskSendThreads;
+		//Signals the I/O threads that clients have messages waiting, or the sender is stopping.
+		std::condition_variable readyCondition;
+
+		//Signals that an I/O thread has finished serving a client.
+		std::condition_variable activeCondition;
+
+		/**
+		* Place a packet on a client's outbound queue, and schedule the client to be served by an I/O thread.
+		* Any open batch packet is queued first, so messages arrive in the order they were queued.
+		* @param client The client to send the packet to.
+		* @param packet The packet to send. Owned by the client's outbound queue from now on.
+		* @returns void.
+		*/
+		void queuePacket(ClientDetails *client, WorkPacket *packet);
 
 		/**
-		* Send task to a client.
+		* Schedule a client to be served by an I/O thread, unless it is already scheduled.
+		* @param client The client to schedule.
+		* @returns void.
+		*/
+		void scheduleClient(ClientDetails *client);
+
+		/**
+		* Move a client's open batch packet to its outbound queue.
+		* The caller must hold the client's outbound message queue lock.
+		* @param client The client whose batch to close.
+		* @param force True to close the batch now, false to only close it once the host's batch window has passed.
+		* @returns void.
+		*/
+		void closeBatch(ClientDetails *client, bool force);
+
+		/**
+		* Serve clients with messages waiting, taking turns between them.
 		* To be used by a dedicated thread.
-		* @param client The client to send the task to.
-		* @param Task the task to send.
 		* @returns void.
 		*/
-		void sendTaskThread(ClientDetails *client, Task *task) const;
+		void ioThread();
+
+		/**
+		* Send as much of a client's outbound queue as its socket will take without blocking.
+		* @param client The client to send to.
+		* @returns True if any data was sent, false if the socket was busy or not ready.
+		*/
+		bool serveClient(ClientDetails *client);
 	};
 }
\ No newline at end of file
@@ -38,6 +38,7 @@ namespace cf
 
 		//Set watch status to signal watcher thread to shut down.
 		watch = false;
+		host->notifyTaskEvent();
 
 		//Wait for the watcher thread to shut down.
 		if (watcherThread.joinable()) watcherThread.join();
@@ -63,35 +64,44 @@ namespace cf
 			{
 
 				//Check client tasks for any that have taken too long.
-				std::unique_lock<std::mutex> clientsLock(host->clientsMutex);
-				for (auto &c : host->clients)
+				std::unique_lock<std::mutex> inFlightLock(host->inFlightTasksMutex);
+				for (auto &t : host->inFlightTasks)
 				{
-					//Skip removed clients.
-					if (c->remove) continue;
+					//Skip tasks being processed by the host-as-client.
+					if (t.second.client == nullptr) continue;
 
-					std::unique_lock<std::mutex> taskLock(c->taskMutex);
-					std::vector<Task *>::iterator it;
-					for (auto &t : c->tasks)
+					//Parts queued behind others on the client are not timed until the client could have started them.
+					if ((host->getTime() - host->getPartStartTime(t.second)).asMilliseconds() > (sf::Int32)t.second.task->getMaxTaskTimeMilliseconds())
 					{
-						if ((host->getTime() - t->getHostTimeSent()).asMilliseconds() > (sf::Int32)t->getMaxTaskTimeMilliseconds())
-						{
-							//Task has taken too long, abort.
-							std::string s = "Client " + std::to_string(c->getClientID()) + " task " + std::to_string(t->getInitialTaskID()) + " timed out. Aborting.";
-							CF_SAY(s, Settings::LogLevels::Error);
-							CF_THROW(s);
-						}
+						//Task has taken too long, abort.
+						std::string s = "Client " + std::to_string(t.second.client->getClientID()) + " task " + std::to_string(t.second.task->getInitialTaskID()) + " timed out. Aborting.";
+						CF_SAY(s, Settings::LogLevels::Error);
+						CF_THROW(s);
 					}
-					taskLock.unlock();
 				}
-				clientsLock.unlock();
+				inFlightLock.unlock();
+
+				//Remove the parts of cancelled tasks.
+				host->purgeCancelledTasks();
 
 				//Divide any pending tasks into the sub task queue.
 				if (host->getTasksCount() > 0 && host->getClientsCount() > 0) host->divideTasksIntoSubTaskQueue();
 
-				//Send pending subtasks waiting on the host to clients.
-				if (host->subTaskQueue.size() > 0) host->sendSubTasks();
-
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				//Send pending subtasks waiting on the host, and chunks of dynamically scheduled tasks, to clients.
+				std::unique_lock<std::mutex> subTaskQueueLock(host->subTaskQueueMutex);
+				bool subTasksPending = host->subTaskQueue.size() > 0 || host->taskSchedulers.size() > 0;
+				subTaskQueueLock.unlock();
+				if (subTasksPending) host->sendSubTasks();
+
+				//Send backup copies of straggling task parts to idle nodes.
+				host->speculateStragglers();
+
+				//Wait for tasks to be added, or for clients to connect, disconnect or become free.
+				//A timeout is set so task time limits are still checked regularly.
+				std::unique_lock<std::mutex> eventLock(host->taskEventMutex);
+				host->taskEventCondition.wait_for(eventLock, std::chrono::milliseconds(100), [this] { return !watch || host->taskEventPending; });
+				host->taskEventPending = false;
+				eventLock.unlock();
 			}
 
 			watching = false;
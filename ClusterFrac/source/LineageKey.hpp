@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <SFML\Network.hpp>
+#include "DllExport.h"
+#include "ObjectPool.h"
+
+namespace cf
+{
+	//Stack of task part numbers or part totals, from the initial task down to a task part.
+	//Every task and result holds two, so they are kept in pooled memory.
+	typedef std::vector<sf::Uint32, PoolAllocator<sf::Uint32>> LineageStack;
+
+	/**
+	* Lineage key class. Identifies a task or result by its initial task ID and its task part
+	* number stack, which together give its position in the tree of split tasks.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class LineageKey
+	{
+
+	public:
+
+		/**
+		* Default constructor.
+		*/
+		DLL LineageKey()
+		{
+			initialTaskID = 0;
+		};
+
+		/**
+		* Constructor with initial task ID and task part number stack.
+		* @param newInitialTaskID The ID of the initial task before it was split.
+		* @param newTaskPartNumberStack The task part number stack.
+		*/
+		DLL LineageKey(sf::Uint64 newInitialTaskID, const LineageStack &newTaskPartNumberStack)
+		{
+			initialTaskID = newInitialTaskID;
+			taskPartNumberStack = newTaskPartNumberStack;
+		};
+
+		/**
+		* Default destructor.
+		*/
+		DLL ~LineageKey() {};
+
+		/**
+		* Compare two lineage keys.
+		* @param other The lineage key to compare to.
+		* @returns True if both keys identify the same task part, false if not.
+		*/
+		DLL inline bool operator==(const LineageKey &other) const
+		{
+			return initialTaskID == other.initialTaskID && taskPartNumberStack == other.taskPartNumberStack;
+		};
+
+		//The ID of the initial task before it was split.
+		sf::Uint64 initialTaskID;
+
+		//Part number stack, from the initial task down to this task part.
+		LineageStack taskPartNumberStack;
+
+	};
+
+	/**
+	* Hash function for lineage keys, for use with unordered containers.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class LineageKeyHash
+	{
+
+	public:
+
+		/**
+		* Hash a lineage key.
+		* @param key The lineage key to hash.
+		* @returns The hash value.
+		*/
+		DLL inline size_t operator()(const LineageKey &key) const
+		{
+			size_t h = std::hash<sf::Uint64>()(key.initialTaskID);
+
+			//Combine the hash of each part number with the running hash.
+			for (auto &n : key.taskPartNumberStack)
+			{
+				h ^= std::hash<sf::Uint32>()(n) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			}
+
+			return h;
+		};
+
+	};
+}
\ No newline at end of file
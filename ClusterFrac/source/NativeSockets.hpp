@@ -0,0 +1,41 @@
+#pragma once
+#include <SFML\Network.hpp>
+#include "DllExport.h"
+
+namespace cf
+{
+
+	/**
+	* TCP socket class that makes the native socket handle available, so the socket can be 
+	* watched with operating system event notification such as epoll.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class NativeTcpSocket : public sf::TcpSocket
+	{
+
+	public:
+
+		/**
+		* Get the native socket handle.
+		* @returns The native socket handle, or an invalid handle if the socket is not connected.
+		*/
+		DLL inline sf::SocketHandle getNativeHandle() const { return getHandle(); };
+	};
+
+	/**
+	* TCP listener class that makes the native socket handle available, so the listener can be 
+	* watched with operating system event notification such as epoll.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class NativeTcpListener : public sf::TcpListener
+	{
+
+	public:
+
+		/**
+		* Get the native socket handle.
+		* @returns The native socket handle, or an invalid handle if the listener is not listening.
+		*/
+		DLL inline sf::SocketHandle getNativeHandle() const { return getHandle(); };
+	};
+}
\ No newline at end of file
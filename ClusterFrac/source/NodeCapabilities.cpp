@@ -0,0 +1,158 @@
+#include "NodeCapabilities.h"
+#include <cmath>
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CF_CPUID_AVAILABLE
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CF_CPUID_AVAILABLE
+#endif
+
+namespace cf
+{
+	const sf::Uint32 NodeCapabilities::PROTOCOL_VERSION;
+
+	NodeCapabilities::NodeCapabilities()
+	{
+		protocolVersion = PROTOCOL_VERSION;
+
+		//Capabilities are unknown until detected or received from a remote node.
+		threads = 0;
+		codecs = 0;
+		simdFeatures = 0;
+		calibrationScore = 0;
+	}
+
+	NodeCapabilities::~NodeCapabilities()
+	{
+	}
+
+	NodeCapabilities NodeCapabilities::getLocal(unsigned int threadCount)
+	{
+		NodeCapabilities c;
+		c.threads = threadCount;
+		c.codecs = CodecZlib;
+		c.simdFeatures = detectSIMDFeatures();
+		c.calibrationScore = calibrate();
+		return c;
+	}
+
+	std::string NodeCapabilities::getSIMDFeaturesString() const
+	{
+		std::string s;
+		if (simdFeatures & SIMDSSE2) s += "SSE2 ";
+		if (simdFeatures & SIMDSSE41) s += "SSE4.1 ";
+		if (simdFeatures & SIMDAVX) s += "AVX ";
+		if (simdFeatures & SIMDAVX2) s += "AVX2 ";
+		if (simdFeatures & SIMDNEON) s += "NEON ";
+
+		if (s.size() == 0) return "none";
+
+		//Remove trailing space.
+		s.pop_back();
+		return s;
+	}
+
+	void NodeCapabilities::serialize(WorkPacket &p) const
+	{
+		p << protocolVersion;
+		p << threads;
+		p << codecs;
+		p << simdFeatures;
+		p << calibrationScore;
+	}
+
+	void NodeCapabilities::deserialize(WorkPacket &p)
+	{
+		p >> protocolVersion;
+
+		//The rest of the data may have a different layout in other protocol versions.
+		if (protocolVersion != PROTOCOL_VERSION) return;
+
+		p >> threads;
+		p >> codecs;
+		p >> simdFeatures;
+		p >> calibrationScore;
+	}
+
+	sf::Uint32 NodeCapabilities::detectSIMDFeatures()
+	{
+		sf::Uint32 features = 0;
+
+#if defined(CF_CPUID_AVAILABLE)
+		//CPUID registers EAX, EBX, ECX, EDX.
+		unsigned int info[4] = { 0, 0, 0, 0 };
+
+#if defined(_MSC_VER)
+		__cpuid((int *)info, 0);
+#else
+		__cpuid(0, info[0], info[1], info[2], info[3]);
+#endif
+		unsigned int maxLeaf = info[0];
+
+		if (maxLeaf >= 1)
+		{
+#if defined(_MSC_VER)
+			__cpuid((int *)info, 1);
+#else
+			__cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+			if (info[3] & (1 << 26)) features |= SIMDSSE2;
+			if (info[2] & (1 << 19)) features |= SIMDSSE41;
+
+			//AVX also needs the OS to save the AVX registers on context switches.
+			bool osSavesAVX = false;
+			if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)))
+			{
+#if defined(_MSC_VER)
+				unsigned __int64 xcr0 = _xgetbv(0);
+#else
+				unsigned int xcr0Low, xcr0High;
+				__asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+				unsigned __int64 xcr0 = ((unsigned __int64)xcr0High << 32) | xcr0Low;
+#endif
+				osSavesAVX = (xcr0 & 6) == 6;
+			}
+			if (osSavesAVX) features |= SIMDAVX;
+
+			if (osSavesAVX && maxLeaf >= 7)
+			{
+#if defined(_MSC_VER)
+				__cpuidex((int *)info, 7, 0);
+#else
+				__cpuid_count(7, 0, info[0], info[1], info[2], info[3]);
+#endif
+				if (info[1] & (1 << 5)) features |= SIMDAVX2;
+			}
+		}
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+		features |= SIMDNEON;
+#endif
+
+		return features;
+	}
+
+	double NodeCapabilities::calibrate()
+	{
+		//A short fixed workload, similar in style to typical numeric tasks.
+		const unsigned int operations = 2000000;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		//Volatile so the workload is not optimised away.
+		volatile double r = 0;
+		for (unsigned int i = 0; i < operations; i++)
+		{
+			r = r + sqrt((double)i) / (double)operations;
+		}
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		//Guard against timer resolution.
+		double seconds = elapsed.count() > 0.000001 ? elapsed.count() : 0.000001;
+
+		return (operations / seconds) / 1000000.0;
+	}
+}
\ No newline at end of file
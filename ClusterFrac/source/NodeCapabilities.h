@@ -0,0 +1,105 @@
+#pragma once
+#include "DllExport.h"
+#include <string>
+#include <SFML\Network.hpp>
+#include "WorkPacket.h"
+
+namespace cf
+{
+	/**
+	* Node capabilities class. Describes the protocol version, processing resources and
+	* supported features of a host or client. Exchanged in the handshake packets sent
+	* when a client connects to a host.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class NodeCapabilities
+	{
+
+	public:
+
+		//Version of the host/client network protocol. Nodes with different protocol versions can't work together.
+		static const sf::Uint32 PROTOCOL_VERSION = 8;
+
+		//Data compression codecs, as bit flags.
+		enum Codecs { CodecZlib = 1 };
+
+		//SIMD instruction set extensions, as bit flags.
+		enum SIMDFeatures { SIMDSSE2 = 1, SIMDSSE41 = 2, SIMDAVX = 4, SIMDAVX2 = 8, SIMDNEON = 16 };
+
+		/**
+		* Default constructor.
+		*/
+		DLL NodeCapabilities();
+
+		/**
+		* Default destructor.
+		*/
+		DLL ~NodeCapabilities();
+
+		//Network protocol version used by the node.
+		sf::Uint32 protocolVersion;
+
+		//Number of threads the node uses to process tasks.
+		sf::Uint32 threads;
+
+		//Data compression codecs supported by the node, from the Codecs enum.
+		sf::Uint32 codecs;
+
+		//SIMD instruction set extensions supported by the node CPU, from the SIMDFeatures enum.
+		sf::Uint32 simdFeatures;
+
+		//Single thread calibration score for the node CPU, in millions of operations per second.
+		//Zero if the node has not been calibrated.
+		double calibrationScore;
+
+		/**
+		* Get the capabilities of this machine.
+		* Detects CPU features and runs a short single thread calibration, which takes a few milliseconds.
+		* @param threadCount The number of threads this node uses to process tasks.
+		* @returns The capabilities of this machine.
+		*/
+		DLL static NodeCapabilities getLocal(unsigned int threadCount);
+
+		/**
+		* Get the estimated processing capacity of the node, for comparing nodes with each other.
+		* @returns The calibration score multiplied by the thread count, or zero if the node has not been calibrated.
+		*/
+		DLL inline double getCapacity() const { return calibrationScore * threads; };
+
+		/**
+		* Get the SIMD features of the node as a readable string, for logging.
+		* @returns The names of the SIMD features supported, or "none".
+		*/
+		DLL std::string getSIMDFeaturesString() const;
+
+		/**
+		* Serialize these capabilities and store the data in a given packet.
+		* The protocol version is always stored first, so nodes using other protocol versions can still read it.
+		* @param p The packet to store the data in.
+		* @returns void.
+		*/
+		DLL void serialize(WorkPacket &p) const;
+
+		/**
+		* Deserialize these capabilities from data provided by a packet.
+		* Only the protocol version is read if it doesn't match the local protocol version.
+		* @param p The packet to retrieve the data from.
+		* @returns void.
+		*/
+		DLL void deserialize(WorkPacket &p);
+
+	private:
+
+		/**
+		* Detect the SIMD instruction set extensions supported by this machine.
+		* @returns The supported features, from the SIMDFeatures enum.
+		*/
+		static sf::Uint32 detectSIMDFeatures();
+
+		/**
+		* Measure the single thread processing speed of this machine.
+		* @returns The calibration score, in millions of operations per second.
+		*/
+		static double calibrate();
+	};
+}
\ No newline at end of file
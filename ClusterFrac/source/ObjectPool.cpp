@@ -0,0 +1,162 @@
+#include "ObjectPool.h"
+#include <new>
+#include <algorithm>
+
+namespace cf
+{
+	const std::size_t ObjectPool::SIZE_CLASS_STEP;
+	const std::size_t ObjectPool::MAX_POOLED_SIZE;
+	const std::size_t ObjectPool::SIZE_CLASSES;
+	const std::size_t ObjectPool::THREAD_BATCH;
+
+	ObjectPool *ObjectPool::getInstance()
+	{
+		//The pool is never destroyed, as objects may still be released to it while static objects are destroyed at exit.
+		static ObjectPool *pool = new ObjectPool();
+
+		return pool;
+	}
+
+	ObjectPool::ObjectPool()
+	{
+		//Keep enough blocks for a few thousand task parts in flight of each size.
+		maxFreeBlocks = 4096;
+	}
+
+	ObjectPool::~ObjectPool()
+	{
+		trim();
+	}
+
+	void *ObjectPool::allocate(std::size_t size)
+	{
+		if (size == 0) size = 1;
+		if (size > MAX_POOLED_SIZE) return ::operator new(size);
+
+		std::size_t c = getSizeClass(size);
+		ThreadCache *cache = getThreadCache();
+
+		if (cache != nullptr)
+		{
+			std::vector<void *> &blocks = cache->blocks[c];
+
+			//Take a batch of blocks from the shared list when the thread has none of its own.
+			if (blocks.size() == 0)
+			{
+				SizeClass &sizeClass = sizeClasses[c];
+				std::unique_lock<std::mutex> lock(sizeClass.mutex);
+				std::size_t n = std::min(THREAD_BATCH, sizeClass.freeBlocks.size());
+				blocks.insert(blocks.end(), sizeClass.freeBlocks.end() - n, sizeClass.freeBlocks.end());
+				sizeClass.freeBlocks.resize(sizeClass.freeBlocks.size() - n);
+			}
+
+			if (blocks.size() > 0)
+			{
+				void *p = blocks.back();
+				blocks.pop_back();
+				return p;
+			}
+		}
+		else
+		{
+			SizeClass &sizeClass = sizeClasses[c];
+			std::unique_lock<std::mutex> lock(sizeClass.mutex);
+			if (sizeClass.freeBlocks.size() > 0)
+			{
+				void *p = sizeClass.freeBlocks.back();
+				sizeClass.freeBlocks.pop_back();
+				return p;
+			}
+		}
+
+		//Every block in a size class is the full size of the class, so any of them fits any size in the class.
+		return ::operator new((c + 1) * SIZE_CLASS_STEP);
+	}
+
+	void ObjectPool::release(void *p, std::size_t size)
+	{
+		if (p == nullptr) return;
+
+		if (size == 0) size = 1;
+		if (size > MAX_POOLED_SIZE)
+		{
+			::operator delete(p);
+			return;
+		}
+
+		std::size_t c = getSizeClass(size);
+		ThreadCache *cache = getThreadCache();
+
+		if (cache != nullptr)
+		{
+			std::vector<void *> &blocks = cache->blocks[c];
+			blocks.push_back(p);
+
+			//Hand a batch back to the shared list once the thread holds more than it is likely to need.
+			if (blocks.size() >= 2 * THREAD_BATCH) giveBack(c, blocks, THREAD_BATCH);
+		}
+		else
+		{
+			std::vector<void *> blocks(1, p);
+			giveBack(c, blocks, 1);
+		}
+	}
+
+	void ObjectPool::giveBack(std::size_t c, std::vector<void *> &blocks, std::size_t count)
+	{
+		SizeClass &sizeClass = sizeClasses[c];
+
+		std::unique_lock<std::mutex> lock(sizeClass.mutex);
+		std::size_t room = sizeClass.freeBlocks.size() < maxFreeBlocks ? maxFreeBlocks - sizeClass.freeBlocks.size() : 0;
+		std::size_t kept = std::min(room, count);
+		sizeClass.freeBlocks.insert(sizeClass.freeBlocks.end(), blocks.end() - kept, blocks.end());
+		lock.unlock();
+
+		blocks.resize(blocks.size() - kept);
+		for (std::size_t i = kept; i < count; i++)
+		{
+			::operator delete(blocks.back());
+			blocks.pop_back();
+		}
+	}
+
+	ObjectPool::ThreadCache *ObjectPool::getThreadCache()
+	{
+		//Set once the thread's blocks have been handed back, so objects destroyed later in the thread's
+		//exit, or by static destructors on the main thread, go straight to the shared lists.
+		static thread_local bool ended = false;
+		if (ended) return nullptr;
+
+		static thread_local struct Owner
+		{
+			ThreadCache cache;
+			~Owner() { ended = true; }
+		} owner;
+
+		return &owner.cache;
+	}
+
+	ObjectPool::ThreadCache::~ThreadCache()
+	{
+		ObjectPool *pool = getInstance();
+		for (std::size_t c = 0; c < SIZE_CLASSES; c++)
+		{
+			if (blocks[c].size() > 0) pool->giveBack(c, blocks[c], blocks[c].size());
+		}
+	}
+
+	void ObjectPool::trim()
+	{
+		for (auto &sizeClass : sizeClasses)
+		{
+			std::unique_lock<std::mutex> lock(sizeClass.mutex);
+			for (auto &p : sizeClass.freeBlocks)
+			{
+				::operator delete(p);
+				p = nullptr;
+			}
+			sizeClass.freeBlocks.clear();
+			sizeClass.freeBlocks.shrink_to_fit();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include "DllExport.h"
+
+#define CF_POOL cf::ObjectPool::getInstance()
+
+namespace cf
+{
+	/**
+	* Object pool class. Recycles the memory of small, short lived objects such as tasks, results
+	* and their task part stacks, which are created and destroyed for every task part at high rates.
+	* Memory blocks are grouped in size classes. A released block is kept for the next object
+	* of the same size class instead of being returned to the system allocator.
+	* Each thread keeps a few blocks of each size class to itself, and trades them with the shared
+	* lists in batches, so most allocations and releases take no lock.
+	* Thread safe.
+	* Singleton class.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class ObjectPool
+	{
+
+	public:
+
+		//Block sizes are rounded up to a multiple of this, in bytes.
+		static const std::size_t SIZE_CLASS_STEP = 16;
+
+		//Largest block size kept in the pool, in bytes. Larger blocks go straight to the system allocator.
+		static const std::size_t MAX_POOLED_SIZE = 1024;
+
+		//Number of size classes.
+		static const std::size_t SIZE_CLASSES = MAX_POOLED_SIZE / SIZE_CLASS_STEP;
+
+		//Number of blocks moved at a time between a thread's own blocks and the shared lists.
+		static const std::size_t THREAD_BATCH = 32;
+
+		/**
+		* Create or get static instance.
+		* @returns A pointer to the single ObjectPool object.
+		*/
+		DLL static ObjectPool *getInstance();
+
+		/**
+		* Allocate a memory block, reusing a released block of the same size class if there is one.
+		* @param size The size of the block, in bytes.
+		* @returns Pointer to the block.
+		*/
+		DLL void *allocate(std::size_t size);
+
+		/**
+		* Release a memory block allocated by allocate, keeping it for reuse.
+		* @param p Pointer to the block.
+		* @param size The size the block was allocated with, in bytes.
+		* @returns void.
+		*/
+		DLL void release(void *p, std::size_t size);
+
+		/**
+		* Set the most released blocks kept for reuse in each size class.
+		* Blocks released beyond this are returned to the system allocator.
+		* @param n The most blocks kept per size class.
+		* @returns void.
+		*/
+		DLL inline void setMaxFreeBlocks(unsigned int n) { maxFreeBlocks = n; };
+
+		/**
+		* Get the most released blocks kept for reuse in each size class.
+		* @returns The most blocks kept per size class.
+		*/
+		DLL inline unsigned int getMaxFreeBlocks() const { return maxFreeBlocks; };
+
+		/**
+		* Return all the blocks kept for reuse in the shared lists to the system allocator.
+		* Blocks kept by each thread are returned as the thread ends.
+		* @returns void.
+		*/
+		DLL void trim();
+
+	private:
+
+		/**
+		* Default constructor.
+		*/
+		ObjectPool();
+
+		/**
+		* Default destructor.
+		*/
+		~ObjectPool();
+
+		//Released blocks of one size, and the mutex that guards them.
+		struct SizeClass
+		{
+			std::vector<void *> freeBlocks;
+			std::mutex mutex;
+		};
+
+		//Size classes, for blocks of SIZE_CLASS_STEP bytes, twice that, and so on up to MAX_POOLED_SIZE.
+		SizeClass sizeClasses[SIZE_CLASSES];
+
+		//Blocks a thread keeps to itself, by size class. Handed back to the shared lists when the thread ends.
+		struct ThreadCache
+		{
+			std::vector<void *> blocks[SIZE_CLASSES];
+
+			~ThreadCache();
+		};
+
+		/**
+		* Get the calling thread's own blocks.
+		* @returns The thread's blocks, or nullptr if the thread is ending and they have been handed back.
+		*/
+		static ThreadCache *getThreadCache();
+
+		/**
+		* Move blocks from a thread's own list to the shared list of a size class,
+		* returning any the shared list has no room for to the system allocator.
+		* @param c The size class index.
+		* @param blocks The thread's own blocks of the size class.
+		* @param count The number of blocks to move, from the end of the thread's list.
+		* @returns void.
+		*/
+		void giveBack(std::size_t c, std::vector<void *> &blocks, std::size_t count);
+
+		//Most released blocks kept for reuse in each size class.
+		std::atomic<unsigned int> maxFreeBlocks;
+
+		/**
+		* Get the size class index for a block size.
+		* @param size The size of the block, in bytes. Must be from 1 to MAX_POOLED_SIZE.
+		* @returns The size class index.
+		*/
+		static inline std::size_t getSizeClass(std::size_t size) { return (size - 1) / SIZE_CLASS_STEP; };
+	};
+
+	/**
+	* Standard library allocator that allocates from the object pool.
+	* Used for small containers held by every task and result.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	template <class T>
+	class PoolAllocator
+	{
+
+	public:
+
+		typedef T value_type;
+
+		/**
+		* Default constructor.
+		*/
+		PoolAllocator() {};
+
+		/**
+		* Construct from an allocator for another type. All pool allocators are interchangeable.
+		*/
+		template <class U>
+		PoolAllocator(const PoolAllocator<U> &) {};
+
+		/**
+		* Allocate memory for a number of objects.
+		* @param n The number of objects.
+		* @returns Pointer to the memory.
+		*/
+		inline T *allocate(std::size_t n) { return static_cast<T *>(CF_POOL->allocate(n * sizeof(T))); };
+
+		/**
+		* Release memory allocated by allocate.
+		* @param p Pointer to the memory.
+		* @param n The number of objects it was allocated for.
+		* @returns void.
+		*/
+		inline void deallocate(T *p, std::size_t n) { CF_POOL->release(p, n * sizeof(T)); };
+	};
+
+	template <class T, class U>
+	inline bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) { return true; }
+
+	template <class T, class U>
+	inline bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) { return false; }
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "PacketPool.h"
+#include <algorithm>
+
+namespace cf
+{
+	const std::size_t PacketPool::SMALL_PACKET_SIZE;
+	const std::size_t PacketPool::LARGE_PACKET_SIZE;
+	const std::size_t PacketPool::DEFAULT_MAX_POOLED_SIZE;
+
+	PacketPool *PacketPool::getInstance()
+	{
+		//The pool is never destroyed, as packets may still be given back to it while static objects are destroyed at exit.
+		static PacketPool *pool = new PacketPool();
+
+		return pool;
+	}
+
+	PacketPool::PacketPool()
+	{
+		//Enough small packets for a batch in flight to each of many clients, and a few larger ones.
+		maxPackets[Small] = 64;
+		maxPackets[Medium] = 16;
+		maxPackets[Large] = 2;
+
+		//Packets that have held very large messages give their memory back.
+		maxPooledSize = DEFAULT_MAX_POOLED_SIZE;
+	}
+
+	PacketPool::~PacketPool()
+	{
+		trim();
+	}
+
+	WorkPacket *PacketPool::acquire(WorkPacket::Flag flag, std::size_t sizeHint)
+	{
+		WorkPacket *packet = nullptr;
+
+		//Only use a pooled packet from the class that fits, so large buffers are kept for large packets.
+		SizeClasses c = getSizeClass(sizeHint);
+		std::unique_lock<std::mutex> lock(poolMutex);
+		if (packets[c].size() > 0)
+		{
+			packet = packets[c].back();
+			packets[c].pop_back();
+		}
+		lock.unlock();
+
+		if (packet == nullptr) packet = new WorkPacket();
+
+		packet->setFlag(flag);
+		return packet;
+	}
+
+	void PacketPool::release(WorkPacket *packet)
+	{
+		if (packet == nullptr) return;
+
+		//Buffers never shrink when cleared, so the largest data the packet has held is a fair measure of its capacity.
+		packet->largestDataSize = std::max(packet->largestDataSize, packet->getDataSize());
+		SizeClasses c = getSizeClass(packet->largestDataSize);
+
+		//Reset the packet, keeping its buffers.
+		packet->clear();
+		packet->init();
+
+		std::unique_lock<std::mutex> lock(poolMutex);
+		if (packets[c].size() < maxPackets[c] && packet->largestDataSize <= maxPooledSize)
+		{
+			packets[c].push_back(packet);
+			return;
+		}
+		lock.unlock();
+
+		delete packet;
+	}
+
+	void PacketPool::setMaxPackets(SizeClasses sizeClass, unsigned int n)
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		maxPackets[sizeClass] = n;
+
+		//Delete any packets over the new limit.
+		while (packets[sizeClass].size() > n)
+		{
+			delete packets[sizeClass].back();
+			packets[sizeClass].pop_back();
+		}
+	}
+
+	unsigned int PacketPool::getMaxPackets(SizeClasses sizeClass)
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		return maxPackets[sizeClass];
+	}
+
+	void PacketPool::setMaxPooledSize(std::size_t bytes)
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		maxPooledSize = bytes;
+
+		//Delete any packets over the new size.
+		for (auto &c : packets)
+		{
+			for (auto it = c.begin(); it != c.end();)
+			{
+				if ((*it)->largestDataSize > bytes)
+				{
+					delete *it;
+					it = c.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+	}
+
+	std::size_t PacketPool::getMaxPooledSize()
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		return maxPooledSize;
+	}
+
+	void PacketPool::trim()
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		for (auto &c : packets)
+		{
+			for (auto &p : c)
+			{
+				delete p;
+				p = nullptr;
+			}
+			c.clear();
+		}
+	}
+
+	PacketPool::SizeClasses PacketPool::getSizeClass(std::size_t size)
+	{
+		if (size <= SMALL_PACKET_SIZE) return Small;
+		if (size <= LARGE_PACKET_SIZE) return Medium;
+		return Large;
+	}
+}
\ No newline at end of file
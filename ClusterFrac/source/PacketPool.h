@@ -0,0 +1,135 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <cstddef>
+#include "DllExport.h"
+#include "WorkPacket.h"
+
+#define CF_PACKETS cf::PacketPool::getInstance()
+
+namespace cf
+{
+	/**
+	* Packet pool class. Keeps work packets that have been used, so their data and compression
+	* buffers keep their capacity for the next packet sent or received, instead of being allocated
+	* again for every message. Large results are several megabytes, so reusing their buffers saves
+	* repeated large allocations and page faults.
+	* Packets are grouped in size classes by the largest data they have held, and a packet is
+	* handed out from the class that fits the size asked for, or newly made if that class is empty.
+	* Larger classes are never used for smaller sizes, so large buffers aren't tied up holding small
+	* packets. Each class keeps a limited number of packets, and packets that have held more than
+	* a set size are not kept at all, so a burst of large messages doesn't hold on to memory for good.
+	* Thread safe.
+	* Singleton class.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class PacketPool
+	{
+
+	public:
+
+		//Packet size classes.
+		//Small - Up to SMALL_PACKET_SIZE bytes, such as single tasks, batches and cancels.
+		//Medium - Up to LARGE_PACKET_SIZE bytes, such as large results and chunk packets.
+		//Large - Any size.
+		enum SizeClasses { Small = 0, Medium = 1, Large = 2 };
+
+		//Largest data size of a small packet, in bytes.
+		static const std::size_t SMALL_PACKET_SIZE = 65536;
+
+		//Largest data size of a medium packet, in bytes. Room for a chunk packet of the default chunk size.
+		static const std::size_t LARGE_PACKET_SIZE = 2097152;
+
+		//Default largest data size of a packet kept for reuse, in bytes.
+		static const std::size_t DEFAULT_MAX_POOLED_SIZE = 67108864;
+
+		/**
+		* Create or get static instance.
+		* @returns A pointer to the single PacketPool object.
+		*/
+		DLL static PacketPool *getInstance();
+
+		/**
+		* Get an empty packet, reusing a pooled one from the size class for the expected size if there is one.
+		* @param flag The packet flag to set.
+		* @param sizeHint The data size the packet is expected to hold, in bytes, or zero if not known.
+		* @returns The packet. Give it back with release when done with it.
+		*/
+		DLL WorkPacket *acquire(WorkPacket::Flag flag = WorkPacket::Flag::None, std::size_t sizeHint = 0);
+
+		/**
+		* Give a packet back to the pool for reuse. The packet is cleared, and deleted if its size class is full
+		* or it has held more data than the largest size kept for reuse.
+		* Packets must not be given back part way through a send, as the socket remembers how much of them was sent.
+		* Delete them instead.
+		* @param packet The packet to give back.
+		* @returns void.
+		*/
+		DLL void release(WorkPacket *packet);
+
+		/**
+		* Set the most packets kept for reuse in a size class.
+		* @param sizeClass The size class, from the SizeClasses enum.
+		* @param n The most packets to keep.
+		* @returns void.
+		*/
+		DLL void setMaxPackets(SizeClasses sizeClass, unsigned int n);
+
+		/**
+		* Get the most packets kept for reuse in a size class.
+		* @param sizeClass The size class, from the SizeClasses enum.
+		* @returns The most packets kept.
+		*/
+		DLL unsigned int getMaxPackets(SizeClasses sizeClass);
+
+		/**
+		* Set the largest data size of a packet kept for reuse. Packets that have held more are deleted when given back.
+		* @param bytes The largest data size, in bytes.
+		* @returns void.
+		*/
+		DLL void setMaxPooledSize(std::size_t bytes);
+
+		/**
+		* Get the largest data size of a packet kept for reuse.
+		* @returns The largest data size, in bytes.
+		*/
+		DLL std::size_t getMaxPooledSize();
+
+		/**
+		* Delete all the packets kept for reuse.
+		* @returns void.
+		*/
+		DLL void trim();
+
+	private:
+
+		/**
+		* Default constructor.
+		*/
+		PacketPool();
+
+		/**
+		* Default destructor.
+		*/
+		~PacketPool();
+
+		//Packets kept for reuse, by size class.
+		std::vector<WorkPacket *> packets[3];
+
+		//Most packets kept for reuse, by size class.
+		unsigned int maxPackets[3];
+
+		//Largest data size of a packet kept for reuse, in bytes.
+		std::size_t maxPooledSize;
+
+		//Mutex for pooled packets.
+		std::mutex poolMutex;
+
+		/**
+		* Get the size class for a data size.
+		* @param size The data size, in bytes.
+		* @returns The size class.
+		*/
+		static SizeClasses getSizeClass(std::size_t size);
+	};
+}
\ No newline at end of file
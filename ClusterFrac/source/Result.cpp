@@ -7,21 +7,63 @@ namespace cf
 		initialTaskID = 0;
 		taskPartNumberStack.push_back(0);
 		taskPartsTotalStack.push_back(1);
+		partial = false;
+		runLength = 1;
 	}
 
 	Result::~Result()
 	{
 	}
 
+	void *Result::operator new(std::size_t size)
+	{
+		return CF_POOL->allocate(size);
+	}
+
+	void Result::operator delete(void *p, std::size_t size)
+	{
+		CF_POOL->release(p, size);
+	}
+
 	void Result::merge(std::vector<Result*> others)
 	{
 		//Sanity check the whole set is here.
-		sf::Uint64 iID = others[0]->initialTaskID;
-		size_t taskPartNumberStackSize = others[0]->taskPartNumberStack.size();
-		size_t taskPartsTotalStackSize = others[0]->taskPartsTotalStack.size();
 		sf::Uint32 taskPartsTotal = others[0]->taskPartsTotalStack.back();
-		if (others.size() != (size_t)taskPartsTotal) CF_THROW("Cannot merge results. Incorrect number of results to merge for this set.");
-		for (auto &r : others)
+		if (checkRun(others) != taskPartsTotal || others[0]->getTaskPartNumber() != 0) CF_THROW("Cannot merge results. Incorrect number of results to merge for this set.");
+
+		//Inherit task data from the results.
+		initialTaskID = others[0]->initialTaskID;
+		taskPartNumberStack = others[0]->taskPartNumberStack;
+		taskPartNumberStack.pop_back(); //Unwind the stack by one.
+		taskPartsTotalStack = others[0]->taskPartsTotalStack;
+		taskPartsTotalStack.pop_back(); //Unwind the stack by one.
+		runLength = 1;
+
+		mergeLocal(others);
+	}
+
+	void Result::mergeRun(std::vector<Result*> run)
+	{
+		sf::Uint32 length = checkRun(run);
+
+		//Inherit task data from the first result in the run. The stack is not unwound, as the set is not yet complete.
+		initialTaskID = run[0]->initialTaskID;
+		taskPartNumberStack = run[0]->taskPartNumberStack;
+		taskPartsTotalStack = run[0]->taskPartsTotalStack;
+		runLength = length;
+
+		mergeLocal(run);
+	}
+
+	sf::Uint32 Result::checkRun(std::vector<Result*> &results)
+	{
+		if (results.size() == 0) CF_THROW("Cannot merge results. No results to merge.");
+
+		sf::Uint64 iID = results[0]->initialTaskID;
+		size_t taskPartNumberStackSize = results[0]->taskPartNumberStack.size();
+		size_t taskPartsTotalStackSize = results[0]->taskPartsTotalStack.size();
+		sf::Uint32 taskPartsTotal = results[0]->taskPartsTotalStack.back();
+		for (auto &r : results)
 		{
 			if (
 				iID != r->initialTaskID
@@ -41,29 +83,29 @@ namespace cf
 			if (taskPartNumberStackSize != taskPartsTotalStackSize) CF_THROW("Cannot merge results. One or more tasks have mismatched task part number and task part total counts.");
 		}
 
-		//Inherit task data from the results.
-		initialTaskID = iID;
-		taskPartNumberStack = others[0]->taskPartNumberStack;
-		taskPartNumberStack.pop_back(); //Unwind the stack by one.
-		taskPartsTotalStack = others[0]->taskPartsTotalStack;
-		taskPartsTotalStack.pop_back(); //Unwind the stack by one.
-
 		//Order of results must be preserved. Reorder parts by part number before passing them to local merge.
-		std::sort(others.begin(), others.end(), 
+		std::sort(results.begin(), results.end(), 
 			[](cf::Result *a, cf::Result *b) 
 			{ 
 				return (a->getTaskPartNumber() < b->getTaskPartNumber());
 			}
 		);
 
-		mergeLocal(others);
+		//Each result must follow straight on from the results before it, allowing for merged runs.
+		sf::Uint32 next = results[0]->taskPartNumberStack.back();
+		for (auto &r : results)
+		{
+			if (r->taskPartNumberStack.back() != next) CF_THROW("Cannot merge results. Results are not from same set or some are missing from the set.");
+			next += r->runLength;
+		}
+
+		if (next > taskPartsTotal) CF_THROW("Cannot merge results. Task part number is out of range.");
+
+		return next - results[0]->taskPartNumberStack.back();
 	}
 
 	void Result::serialize(cf::WorkPacket &p) const
 	{
-		p << getType(); 
-		p << getSubtype(); 
-		
 		p << initialTaskID;
 
 		//Uint32 for best cross platform compatibility for serialisation/deserialisation.
@@ -75,6 +117,8 @@ namespace cf
 		p << size;
 		for (sf::Uint32 i = 0; i < size; i++) p << taskPartsTotalStack[i];
 
+		p << partial;
+
 		serializeLocal(p);
 	}
 
@@ -93,6 +137,8 @@ namespace cf
 		taskPartsTotalStack.resize(size);
 		for (sf::Uint32 i = 0; i < size; i++) p >> taskPartsTotalStack[i];
 
+		p >> partial;
+
 		deserializeLocal(p);
 	}
 }
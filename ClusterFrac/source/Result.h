@@ -6,6 +6,8 @@
 #include <SFML\Network.hpp>
 #include "WorkPacket.h"
 #include "ConsoleMessager.hpp"
+#include "ObjectPool.h"
+#include "LineageKey.hpp"
 
 namespace cf
 {
@@ -35,20 +37,36 @@ namespace cf
 		*/
 		DLL virtual ~Result();
 
+		/**
+		* Allocate memory for a result of any subtype from the object pool.
+		* Results are created and destroyed for every task part, so their memory is recycled rather than freed.
+		* @param size The size of the result, in bytes.
+		* @returns Pointer to the memory.
+		*/
+		DLL static void *operator new(std::size_t size);
+
+		/**
+		* Release the memory of a result to the object pool.
+		* @param p Pointer to the memory.
+		* @param size The size of the result, in bytes.
+		* @returns void.
+		*/
+		DLL static void operator delete(void *p, std::size_t size);
+
 		/**
 		* Get the type ID of this class.
-		* This identifies the base class type during serialisation and deserialisation.
-		* This value must be unique among all classes.
+		* This identifies the base class type. It is no longer sent over the network, as the
+		* subtype header written by the type registry also records whether the object is a task or a result.
 		* @returns The type ID of this class as a string.
 		*/
 		DLL inline virtual std::string getType() const { return "Result"; }
 
 		/**
-		* Get the subtype ID of this class.
-		* Pure virtual function, which identifies the polymorphic derived class type
-		* during serialisation and deserialisation.
-		* This value must be unique among all classes.
-		* @returns The subtype ID of this class as a string.
+		* Get the subtype name of this class.
+		* Pure virtual function, which identifies the polymorphic derived class type.
+		* Must match the name the type is registered with, and be unique among all classes.
+		* Subtypes are sent over the network as numeric IDs agreed when a client connects.
+		* @returns The subtype name of this class as a string.
 		*/
 		DLL virtual std::string getSubtype() const = 0;
 
@@ -65,6 +83,26 @@ namespace cf
 		*/
 		DLL inline int getCurrentTaskPartsTotal() const { if (taskPartsTotalStack.size() == 0) { CF_THROW("Task part total list is empty."); } return taskPartsTotalStack.back(); }
 
+		/**
+		* Get the task part number stack of this result, from the initial task down to this part.
+		* @returns The task part number stack.
+		*/
+		DLL inline const LineageStack &getTaskPartNumberStack() const { return taskPartNumberStack; };
+
+		/**
+		* Get the task parts total stack of this result, from the initial task down to this part.
+		* Entry N is the number of parts the task at depth N was split into.
+		* @returns The task parts total stack.
+		*/
+		DLL inline const LineageStack &getTaskPartsTotalStack() const { return taskPartsTotalStack; };
+
+		/**
+		* Is this a partial result, streamed while its task part was still running?
+		* Partial results are delivered to the application as they arrive, and are never merged.
+		* @returns True if this is a partial result, false if it is the complete result of its task part.
+		*/
+		DLL inline bool isPartial() const { return partial; };
+
 		/**
 		* Get the task ID for this task. The task ID is set when a task is first created.
 		* When a task is split, all sub tasks that for a set for one task share a task ID.
@@ -79,9 +117,28 @@ namespace cf
 		* @returns A pointer to a single new merged result.
 		*/
 		DLL virtual void merge(const std::vector<Result *> others);
+
+		/**
+		* Merge a run of consecutive results from one set into this result, without completing the set.
+		* Used to merge large sets as a tree of partial merges. The merged result keeps the task part number
+		* of the first result in the run and stands in for the whole run, so it can later be merged with the
+		* other runs from the set using merge(). The result's mergeLocal must give the same result when runs 
+		* of a set are merged first, as it does when results are merged in order of task part number.
+		* Merged runs are only used on the node that merged them, and are never sent over the network.
+		* @param run A std::vector of pointers to the consecutive results to merge, in any order.
+		* @returns void.
+		*/
+		DLL void mergeRun(const std::vector<Result *> run);
+
+		/**
+		* Get the number of results from its set that this result stands in for.
+		* @returns 1 for a single result, or the number of results merged into this result by mergeRun().
+		*/
+		DLL inline sf::Uint32 getRunLength() const { return runLength; };
 	
 		/**
 		* Serialize this result and store the data in a given packet.
+		* The subtype header is not included. It is written by the sender's type registry.
 		* @param p The packet to store the data in.
 		* @returns void.
 		*/
@@ -131,13 +188,20 @@ namespace cf
 		//Stored as a stack of all values up the task tree from this point
 		//to allow growing and unrolling of the stack as tasks are split and 
 		//results are merged.
-		std::vector<sf::Uint32> taskPartNumberStack;
+		LineageStack taskPartNumberStack;
 
 		//Total parts since last split.
 		//Stored as a stack of all values up the task tree from this point
 		//to allow growing and unrolling of the stack as tasks are split and 
 		//results are merged.
-		std::vector<sf::Uint32> taskPartsTotalStack;
+		LineageStack taskPartsTotalStack;
+
+		//Is this a partial result, streamed while its task part was still running?
+		bool partial;
+
+		//Number of results from its set that this result stands in for.
+		//Greater than 1 only for runs merged with mergeRun().
+		sf::Uint32 runLength;
 
 		//Host time this task was sent to the client.
 		//Only used by the host.
@@ -155,6 +219,14 @@ namespace cf
 		*/
 		virtual void mergeLocal(const std::vector<Result *> others) = 0;
 
+		/**
+		* Check that results are consecutive parts of one set, and order them by task part number.
+		* Results may be runs merged by mergeRun().
+		* @param results The results to check. Reordered by task part number.
+		* @returns The number of results from the set covered by the given results.
+		*/
+		static sf::Uint32 checkRun(std::vector<Result *> &results);
+
 		/**
 		* Serialize this result and store the data in a given packet.
 		* @param p The packet to store the data in.
@@ -0,0 +1,117 @@
+#include "ResultSetIndex.h"
+
+namespace cf
+{
+	ResultSetIndex::ResultSetIndex()
+	{
+		partsCount = 0;
+	}
+
+	ResultSetIndex::~ResultSetIndex()
+	{
+	}
+
+	bool ResultSetIndex::add(Result *result, std::vector<Result *> &set)
+	{
+		set.clear();
+
+		const LineageStack &partNumbers = result->getTaskPartNumberStack();
+
+		if (partNumbers.size() < 2 || !isValid(result)) return false;
+
+		sf::Uint32 partNumber = partNumbers.back();
+		sf::Uint32 partsTotal = (sf::Uint32)result->getCurrentTaskPartsTotal();
+
+		//The set is identified by the lineage of the task these parts were split from.
+		LineageKey key(result->getInitialTaskID(), LineageStack(partNumbers.begin(), partNumbers.end() - 1));
+
+		auto it = sets.find(key);
+		if (it != sets.end())
+		{
+			//The part must agree with the parts already in its set, and not have arrived before.
+			if (it->second.parts.size() != (size_t)partsTotal || it->second.arrived[partNumber]) return false;
+		}
+		else
+		{
+			//First part of this set to arrive.
+			it = sets.emplace(key, ResultSet()).first;
+			it->second.parts.resize(partsTotal, nullptr);
+			it->second.arrived.resize(partsTotal, false);
+			it->second.arrivedCount = 0;
+		}
+
+		ResultSet &entry = it->second;
+		entry.parts[partNumber] = result;
+		entry.arrived[partNumber] = true;
+		entry.arrivedCount++;
+		partsCount++;
+
+		//Set is still waiting on other parts.
+		if (entry.arrivedCount < partsTotal) return true;
+
+		//Set is complete. Hand its parts to the caller and remove it from the index.
+		set.swap(entry.parts);
+		partsCount -= set.size();
+		sets.erase(it);
+
+		return true;
+	}
+
+	bool ResultSetIndex::isValid(const Result *result)
+	{
+		const LineageStack &partNumbers = result->getTaskPartNumberStack();
+		const LineageStack &partsTotals = result->getTaskPartsTotalStack();
+
+		if (partNumbers.size() == 0 || partNumbers.size() != partsTotals.size()) return false;
+
+		for (size_t i = 0; i < partNumbers.size(); i++)
+		{
+			if (partNumbers[i] >= partsTotals[i]) return false;
+		}
+
+		return true;
+	}
+
+	std::vector<Result *> ResultSetIndex::clear()
+	{
+		std::vector<Result *> parts;
+
+		for (auto &s : sets)
+		{
+			for (auto &r : s.second.parts)
+			{
+				if (r != nullptr) parts.push_back(r);
+			}
+		}
+
+		sets.clear();
+		partsCount = 0;
+
+		return parts;
+	}
+
+	std::vector<Result *> ResultSetIndex::remove(unsigned __int64 initialTaskID)
+	{
+		std::vector<Result *> parts;
+
+		for (auto it = sets.begin(); it != sets.end();)
+		{
+			if (it->first.initialTaskID == initialTaskID)
+			{
+				for (auto &r : it->second.parts)
+				{
+					if (r != nullptr) parts.push_back(r);
+				}
+				it = sets.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		partsCount -= parts.size();
+
+		return parts;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <SFML\Network.hpp>
+#include "DllExport.h"
+#include "ConsoleMessager.hpp"
+#include "LineageKey.hpp"
+#include "Result.h"
+
+namespace cf
+{
+
+	/**
+	* ResultSetIndex class. Holds result parts until every part of their result set has arrived.
+	* Result sets are indexed by initial task ID and the task part number stack of the parent task, 
+	* so adding a part only touches its own set, and the set is complete as soon as its last part is added.
+	* Not thread safe. The owner is responsible for locking.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class ResultSetIndex
+	{
+
+	public:
+
+		/**
+		* Default constructor.
+		*/
+		DLL ResultSetIndex();
+
+		/**
+		* Default destructor.
+		* Result parts still held by the index are not deleted. Use clear() to retrieve them first.
+		*/
+		DLL ~ResultSetIndex();
+
+		/**
+		* Add a result part to the index.
+		* The result must be a part of a split task, so its task part number stack must have at least two entries.
+		* Parts that are not valid, that have already arrived, or whose parts total does not match the other parts of
+		* their set are not added.
+		* @param result The result part to add.
+		* @param set Set to all parts of the result set ordered by task part number if this part completes the set, 
+		* and the set is removed from the index. Otherwise set to an empty std::vector.
+		* @returns True if the part was added, false if it was not. The caller still owns parts that were not added.
+		*/
+		DLL bool add(Result *result, std::vector<Result *> &set);
+
+		/**
+		* Check that the task part stacks of a result are well formed. The part number and parts total stacks must
+		* be the same size, and each part number must be less than its parts total.
+		* @param result The result to check.
+		* @returns True if the result's task part stacks are valid, false if not.
+		*/
+		DLL static bool isValid(const Result *result);
+
+		/**
+		* Get the number of result parts held in the index.
+		* @returns The number of result parts held in the index.
+		*/
+		DLL inline size_t size() const { return partsCount; };
+
+		/**
+		* Remove all result parts from the index.
+		* @returns All result parts that were held in the index. These are not deleted from memory.
+		*/
+		DLL std::vector<Result *> clear();
+
+		/**
+		* Remove all result parts belonging to one initial task from the index.
+		* @param initialTaskID The initial task ID of the parts to remove.
+		* @returns The result parts that were removed. These are not deleted from memory.
+		*/
+		DLL std::vector<Result *> remove(unsigned __int64 initialTaskID);
+
+	private:
+
+		/**
+		* The parts of one result set that have arrived so far.
+		*/
+		struct ResultSet
+		{
+			//Result parts, indexed by task part number.
+			std::vector<Result *> parts;
+
+			//Which task part numbers have arrived.
+			std::vector<bool> arrived;
+
+			//Number of parts that have arrived.
+			sf::Uint32 arrivedCount;
+		};
+
+		//Incomplete result sets, keyed by the lineage of their parent task.
+		std::unordered_map<LineageKey, ResultSet, LineageKeyHash> sets;
+
+		//Number of result parts held in all sets.
+		size_t partsCount;
+
+	};
+}
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <array>
 #include <istream>
 #include <fstream>
+#include <cmath>
+#include <algorithm>
 
 namespace cf
 {
@@ -22,38 +24,127 @@ namespace cf
 		//Allow task splitting between nodes by default.
 		allowNodeTaskSplit = true;
 
+		//Tasks may be sent to any node by default.
+		preferredNodeID = 0;
+
+		//Split tasks once, equally, by default.
+		schedulingMode = (sf::Uint8)SchedulingModes::Static;
+		minGrainSize = 0;
+
+		//Normal priority and no deadline by default.
+		priority = (sf::Uint8)Priorities::Normal;
+		deadlineMilliseconds = 0;
+		hostTimeAdded = sf::Time::Zero;
+
+		//Partial results are not streamed unless asked.
+		streamResults = false;
+
+		//Tasks are not cancelled until asked.
+		cancellationToken = std::make_shared<std::atomic<bool>>(false);
+
 	}
 
 	Task::~Task()
 	{
 	}
 
+	void *Task::operator new(std::size_t size)
+	{
+		return CF_POOL->allocate(size);
+	}
+
+	void Task::operator delete(void *p, std::size_t size)
+	{
+		CF_POOL->release(p, size);
+	}
+
 	std::vector<Task*> Task::split(int count) const
 	{
 		std::vector<Task *> tmp = splitLocal(count); 
+		setSplitParts(tmp);
+		return tmp;
+	}
+
+	std::vector<Task*> Task::splitWeighted(const std::vector<double> &weights) const
+	{
+		if (weights.size() == 0) CF_THROW("Cannot split task. No weights given.");
+		for (auto &w : weights)
+		{
+			if (!(w >= 0)) CF_THROW("Cannot split task. Invalid weight.");
+		}
+
+		std::vector<Task *> tmp = splitWeightedLocal(weights);
+		setSplitParts(tmp);
+		return tmp;
+	}
+
+	std::vector<std::pair<sf::Uint32, sf::Uint32>> Task::divideRange(sf::Uint32 first, sf::Uint32 last, const std::vector<double> &weights)
+	{
+		if (last < first) CF_THROW("Invalid range.");
+
+		//Limit number of sub ranges to the number of items.
+		sf::Uint64 itemCount = ((sf::Uint64)last - first) + 1;
+		size_t count = (size_t)std::min((sf::Uint64)weights.size(), itemCount);
+
+		double weightTotal = 0;
+		for (size_t i = 0; i < count; i++) weightTotal += weights[i];
+
+		std::vector<std::pair<sf::Uint32, sf::Uint32>> ranges;
+		double weightSoFar = 0;
+		sf::Uint64 itemsSoFar = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			weightSoFar += weightTotal > 0 ? weights[i] : 1.0;
+
+			//Place the end of this sub range in proportion to the weights so far, so rounding errors don't accumulate.
+			//The final sub range always takes the remainder of the items.
+			sf::Uint64 itemsEnd = itemCount;
+			if (i < count - 1) itemsEnd = (sf::Uint64)llround(itemCount * (weightSoFar / (weightTotal > 0 ? weightTotal : (double)count)));
+
+			//Every sub range gets at least one item, leaving at least one item for each sub range still to come.
+			itemsEnd = std::max(itemsEnd, itemsSoFar + 1);
+			itemsEnd = std::min(itemsEnd, itemCount - (count - 1 - i));
+
+			ranges.push_back(std::pair<sf::Uint32, sf::Uint32>((sf::Uint32)(first + itemsSoFar), (sf::Uint32)(first + itemsEnd - 1)));
+			itemsSoFar = itemsEnd;
+		}
+
+		return ranges;
+	}
+
+	void Task::setSplitParts(std::vector<Task *> &parts) const
+	{
 		sf::Uint32 i = 0;
-		for (auto &t : tmp)
+		for (auto &t : parts)
 		{
 			t->initialTaskID = initialTaskID;
 			t->maxTaskTimeMilliseconds = maxTaskTimeMilliseconds;
 			t->nodeTargetType = nodeTargetType;
 			t->allowNodeTaskSplit = allowNodeTaskSplit;
+			t->schedulingMode = schedulingMode;
+			t->minGrainSize = minGrainSize;
+			t->priority = priority;
+			t->deadlineMilliseconds = deadlineMilliseconds;
+			t->hostTimeAdded = hostTimeAdded;
+			t->cancellationToken = cancellationToken;
+			t->streamResults = streamResults;
+			t->partialResultSink = partialResultSink;
 			t->taskPartNumberStack = taskPartNumberStack;
 			t->taskPartNumberStack.push_back(i++);
 			t->taskPartsTotalStack = taskPartsTotalStack;
-			t->taskPartsTotalStack.push_back((sf::Uint32)tmp.size());
-		};  
-		return tmp;
+			t->taskPartsTotalStack.push_back((sf::Uint32)parts.size());
+		};
 	}
 
 	void Task::serialize(WorkPacket & p) const
 	{
-		p << getType();
-		p << getSubtype();
 		p << initialTaskID;
 		p << nodeTargetType;
 		p << allowNodeTaskSplit;
 		p << maxTaskTimeMilliseconds;
+		p << schedulingMode;
+		p << minGrainSize;
+		p << streamResults;
 
 		//Uint32 for best cross platform compatibility for serialisation/deserialisation.
 		sf::Uint32 size = (sf::Uint32)taskPartNumberStack.size();
@@ -72,6 +163,9 @@ namespace cf
 		p >> nodeTargetType;
 		p >> allowNodeTaskSplit;
 		p >> maxTaskTimeMilliseconds;
+		p >> schedulingMode;
+		p >> minGrainSize;
+		p >> streamResults;
 
 		//Uint32 for best cross platform compatibility for serialisation/deserialisation.
 		sf::Uint32 size;
@@ -86,6 +180,23 @@ namespace cf
 		deserializeLocal(p);
 	}
 
+	void Task::streamPartialResult(Result *partial) const
+	{
+		if (!streamResults || !partialResultSink || isCancelled())
+		{
+			delete partial;
+			return;
+		}
+
+		//Add task data to the partial result, so it can be matched to this task part.
+		partial->initialTaskID = initialTaskID;
+		partial->taskPartNumberStack = taskPartNumberStack;
+		partial->taskPartsTotalStack = taskPartsTotalStack;
+		partial->partial = true;
+
+		partialResultSink(partial);
+	}
+
 	Result *Task::run() const
 	{
 		Result *result = runLocal();
@@ -3,11 +3,17 @@
 #include <list>
 #include <vector>
 #include <string>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <functional>
 #include <SFML\Network.hpp>
 #include "WorkPacket.h"
 #include "Result.h"
 #include "IDManager.h"
 #include "ConsoleMessager.hpp"
+#include "ObjectPool.h"
+#include "LineageKey.hpp"
 
 namespace cf
 {
@@ -32,6 +38,22 @@ namespace cf
 		*/
 		DLL virtual ~Task();
 
+		/**
+		* Allocate memory for a task of any subtype from the object pool.
+		* Tasks and task parts are created and destroyed for every task part, so their memory is recycled rather than freed.
+		* @param size The size of the task, in bytes.
+		* @returns Pointer to the memory.
+		*/
+		DLL static void *operator new(std::size_t size);
+
+		/**
+		* Release the memory of a task to the object pool.
+		* @param p Pointer to the memory.
+		* @param size The size of the task, in bytes.
+		* @returns void.
+		*/
+		DLL static void operator delete(void *p, std::size_t size);
+
 		//Which node types can this task be run on?
 		//The task distributor will only run the task on the chosen node type.
 		//If "host as client" is not enabled, type "Local" will be treated as "Remote".
@@ -40,24 +62,45 @@ namespace cf
 		//Any - No preference.
 		enum NodeTargetTypes { Local = 0, Remote = 1, Any = 2 };
 
+		//How is this task divided among nodes, and among threads on each node?
+		//Static - Split once into one equal (or throughput weighted) part per node or thread.
+		//Guided - Hand out chunks on demand, each an equal share of the work left at the time.
+		//Factoring - Hand out chunks on demand in batches of one per node or thread, each batch covering half of the work left.
+		//Dynamic modes need the task to override getWorkSize and splitWeightedLocal.
+		enum SchedulingModes { Static = 0, Guided = 1, Factoring = 2 };
+
+		//How urgently should this task be processed?
+		//The host sends waiting tasks in priority order, and then earliest deadline first.
+		//Batch - Bulk work no one is waiting on. Only sent to nodes that would otherwise be idle.
+		//Prefetch - Work that may be needed soon. Only sent to nodes that would otherwise be idle.
+		//Normal - Default priority.
+		//Interactive - Work a user is waiting on.
+		enum Priorities { Batch = 0, Prefetch = 1, Normal = 2, Interactive = 3 };
+
+		//Flag set when a task is cancelled. Shared by a task and all parts split from it on the same node.
+		typedef std::shared_ptr<std::atomic<bool>> CancellationToken;
+
+		//Receives partial results streamed by a running task. Takes ownership of the result.
+		typedef std::function<void(Result *)> PartialResultSink;
+
 		//Is this task allowed to be split between nodes?
 		//Some tasks may perform better when sent to a single node.
 		bool allowNodeTaskSplit;
 
 		/**
 		* Get the type ID of this class.
-		* This identifies the base class type during serialisation and deserialisation.
-		* This value must be unique among all classes.
+		* This identifies the base class type. It is no longer sent over the network, as the
+		* subtype header written by the type registry also records whether the object is a task or a result.
 		* @returns The type ID of this class as a string.
 		*/
 		DLL inline virtual std::string getType() const { return "Task"; }
 
 		/**
-		* Get the subtype ID of this class.
-		* Pure virtual function, which identifies the polymorphic derived class type
-		* during serialisation and deserialisation.
-		* This value must be unique among all classes.
-		* @returns The subtype ID of this class as a string.
+		* Get the subtype name of this class.
+		* Pure virtual function, which identifies the polymorphic derived class type.
+		* Must match the name the type is registered with, and be unique among all classes.
+		* Subtypes are sent over the network as numeric IDs agreed when a client connects.
+		* @returns The subtype name of this class as a string.
 		*/
 		DLL virtual std::string getSubtype() const = 0;
 
@@ -74,6 +117,12 @@ namespace cf
 		*/
 		DLL inline int getCurrentTaskPartsTotal() const { if (taskPartsTotalStack.size() == 0) { CF_THROW("Task part total list is empty."); } return taskPartsTotalStack.back(); }
 
+		/**
+		* Get the task part number stack of this task, from the initial task down to this part.
+		* @returns The task part number stack.
+		*/
+		DLL inline const LineageStack &getTaskPartNumberStack() const { return taskPartNumberStack; };
+
 		/**
 		* Get the task ID for this task. The task ID is set when a task is first created.
 		* When a task is split, all sub tasks that for a set for one task share a task ID.
@@ -89,8 +138,27 @@ namespace cf
 		*/
 		DLL std::vector<Task *> split(int count) const;
 
+		/**
+		* Split this task up in to chunks sized in proportion to a set of weights, and return
+		* a std::vector of pointers to those split tasks. Part N of the split is sized by weight N.
+		* Tasks that do not override splitWeightedLocal are split equally.
+		* Fewer parts than weights may be returned if the task cannot be split that finely.
+		* @param weights The relative size of each part. Must not be empty or contain negative values.
+		* @returns A std::vector of pointers to the new split tasks.
+		*/
+		DLL std::vector<Task *> splitWeighted(const std::vector<double> &weights) const;
+
+		/**
+		* Get the amount of work in this task, in task specific units such as items to process.
+		* Used by the host to estimate the throughput of each node from completed task parts.
+		* Override for range-style tasks so that throughput estimates reflect the size of each part.
+		* @returns The amount of work in this task. Defaults to 1.
+		*/
+		DLL virtual double getWorkSize() const { return 1.0; };
+
 		/**
 		* Serialize this task and store the data in a given packet.
+		* The subtype header is not included. It is written by the sender's type registry.
 		* @param p The packet to store the data in.
 		* @returns void.
 		*/
@@ -167,12 +235,176 @@ namespace cf
 		*/
 		DLL inline void setNodeTargetType(NodeTargetTypes newNodeTargetType) { nodeTargetType = (sf::Uint8)newNodeTargetType; };
 
+		/**
+		* Get the scheduling mode used to divide this task among nodes and threads.
+		* @returns The scheduling mode, from the SchedulingModes enum.
+		*/
+		DLL inline SchedulingModes getSchedulingMode() const { return (SchedulingModes)schedulingMode; };
+
+		/**
+		* Set the scheduling mode used to divide this task among nodes and threads.
+		* @param newSchedulingMode The scheduling mode, from the SchedulingModes enum.
+		* @returns void.
+		*/
+		DLL inline void setSchedulingMode(SchedulingModes newSchedulingMode) { schedulingMode = (sf::Uint8)newSchedulingMode; };
+
+		/**
+		* Get the smallest chunk of this task that will be handed out by a dynamic scheduling mode.
+		* @returns The minimum grain size, in the work units used by getWorkSize.
+		*/
+		DLL inline double getMinGrainSize() const { return minGrainSize; };
+
+		/**
+		* Set the smallest chunk of this task that will be handed out by a dynamic scheduling mode.
+		* Larger grains lower the per-chunk overhead, smaller grains balance the load more finely.
+		* @param n The minimum grain size, in the work units used by getWorkSize. 0 for no minimum.
+		* @returns void.
+		*/
+		DLL inline void setMinGrainSize(double n) { if (!(n >= 0)) { CF_THROW("Invalid minimum grain size for task."); } minGrainSize = n; };
+
+		/**
+		* Get the priority of this task.
+		* @returns The priority, from the Priorities enum.
+		*/
+		DLL inline Priorities getPriority() const { return (Priorities)priority; };
+
+		/**
+		* Set the priority of this task.
+		* This value is only used by the host and is not sent to clients.
+		* @param newPriority The priority, from the Priorities enum.
+		* @returns void.
+		*/
+		DLL inline void setPriority(Priorities newPriority) { priority = (sf::Uint8)newPriority; };
+
+		/**
+		* Is this task only sent to nodes that would otherwise be idle?
+		* @returns True if the priority of this task is below Normal, false if not.
+		*/
+		DLL inline bool isBackground() const { return priority < (sf::Uint8)Priorities::Normal; };
+
+		/**
+		* Get the time allowed for this task to complete, from when it is added to the host task queue.
+		* @returns The deadline in milliseconds, or 0 if the task has no deadline.
+		*/
+		DLL inline unsigned int getDeadlineMilliseconds() const { return deadlineMilliseconds; };
+
+		/**
+		* Set the time allowed for this task to complete, from when it is added to the host task queue.
+		* Among tasks of the same priority, tasks with the earliest deadline are sent first.
+		* The deadline orders work and does not cancel it, so tasks that miss their deadline still complete.
+		* This value is only used by the host and is not sent to clients.
+		* @param n The deadline in milliseconds, or 0 for no deadline.
+		* @returns void.
+		*/
+		DLL inline void setDeadlineMilliseconds(unsigned int n) { deadlineMilliseconds = n; };
+
+		/**
+		* Record the host time this task was added to the host task queue.
+		* @param t The time the task was added, in sf::Time format.
+		* @returns void.
+		*/
+		DLL inline void setHostTimeAdded(sf::Time t) { hostTimeAdded = t; };
+
+		/**
+		* Get the host time by which this task should be complete.
+		* @returns The deadline as a host time, in sf::Time format, or sf::Time::Zero if the task has no deadline.
+		*/
+		DLL inline sf::Time getHostDeadline() const { return deadlineMilliseconds > 0 ? hostTimeAdded + sf::milliseconds(deadlineMilliseconds) : sf::Time::Zero; };
+
+		/**
+		* Has this task been cancelled?
+		* Long running runLocal implementations should check this regularly, and return early if it is set.
+		* The result of a cancelled task is discarded, so it may be incomplete.
+		* @returns True if the task, or the task it was split from, has been cancelled, false if not.
+		*/
+		DLL inline bool isCancelled() const { return *cancellationToken; };
+
+		/**
+		* Cancel this task, and all parts split from it on this node.
+		* @returns void.
+		*/
+		DLL inline void cancel() { *cancellationToken = true; };
+
+		/**
+		* Get the cancellation token shared by this task and all parts split from it on this node.
+		* @returns The cancellation token.
+		*/
+		DLL inline CancellationToken getCancellationToken() const { return cancellationToken; };
+
+		/**
+		* Should partial results streamed by this task be sent to the host?
+		* @returns True if partial results are sent, false if they are discarded.
+		*/
+		DLL inline bool getStreamResults() const { return streamResults; };
+
+		/**
+		* Set whether partial results streamed by this task should be sent to the host.
+		* Set by the host for tasks whose application asked for results as they arrive.
+		* @param state True to send partial results, false to discard them.
+		* @returns void.
+		*/
+		DLL inline void setStreamResults(bool state) { streamResults = state; };
+
+		/**
+		* Set where partial results streamed by this task go. Set by the node running the task.
+		* Parts split from this task after the sink is set share the sink.
+		* @param sink The partial result sink.
+		* @returns void.
+		*/
+		DLL inline void setPartialResultSink(PartialResultSink sink) { partialResultSink = sink; };
+
+		/**
+		* Set the node the host would prefer to send this task to.
+		* This value is only used by the host and is not sent to clients.
+		* @param n The ID of the preferred node, or 0 for any node.
+		* @returns void.
+		*/
+		DLL inline void setPreferredNodeID(sf::Uint64 n) { preferredNodeID = n; };
+
+		/**
+		* Get the node the host would prefer to send this task to.
+		* @returns The ID of the preferred node, or 0 for any node.
+		*/
+		DLL inline sf::Uint64 getPreferredNodeID() const { return preferredNodeID; };
+
+	protected:
+
+		/**
+		* Divide an inclusive range of items in to consecutive inclusive sub ranges sized in 
+		* proportion to a set of weights. Every sub range holds at least one item.
+		* If there are fewer items than weights, only the first N weights are used.
+		* If all weights are zero the range is divided equally.
+		* @param first The first item in the range.
+		* @param last The last item in the range.
+		* @param weights The relative size of each sub range.
+		* @returns A std::vector of first and last item pairs for each sub range.
+		*/
+		DLL static std::vector<std::pair<sf::Uint32, sf::Uint32>> divideRange(sf::Uint32 first, sf::Uint32 last, const std::vector<double> &weights);
+
+		/**
+		* Stream part of this task's result to the application while the task is still running, such as
+		* rows or ranges that have finished. For use by long running runLocal implementations.
+		* Partial results are only sent if the application asked for results as they arrive, and are 
+		* discarded otherwise. They are delivered as they are, and are not merged. The complete result 
+		* returned by runLocal is still required.
+		* @param partial The partial result. ClusterFrac takes ownership of the result.
+		* @returns void.
+		*/
+		DLL void streamPartialResult(Result *partial) const;
+
 	private:
 
 		//Which node type does this task prefer to be run on?
 		//See NodeTargetTypes enum.
 		sf::Uint8 nodeTargetType;
 
+		//How this task is divided among nodes and threads.
+		//See SchedulingModes enum.
+		sf::Uint8 schedulingMode;
+
+		//Smallest chunk handed out by a dynamic scheduling mode, in task work units.
+		double minGrainSize;
+
 		//The ID of the initial task before it was split.
 		sf::Uint64 initialTaskID;
 
@@ -180,13 +412,13 @@ namespace cf
 		//Stored as a stack of all values up the task tree from this point
 		//to allow growing and unrolling of the stack as tasks are split and 
 		//results are merged.
-		std::vector<sf::Uint32> taskPartNumberStack;
+		LineageStack taskPartNumberStack;
 
 		//Total parts since last split.
 		//Stored as a stack of all values up the task tree from this point
 		//to allow growing and unrolling of the stack as tasks are split and 
 		//results are merged.
-		std::vector<sf::Uint32> taskPartsTotalStack;
+		LineageStack taskPartsTotalStack;
 
 		//Maximum time in milliseconds that a client is allowed to spend on this task
 		//(or task part) before the host will cancel the request and try again.
@@ -200,6 +432,42 @@ namespace cf
 		//This value is only used for tasks or task parts sent to the client.
 		sf::Time hostTimeSent;
 
+		//How urgently this task should be processed.
+		//See Priorities enum.
+		//This value is only used by the host and is not sent to clients.
+		sf::Uint8 priority;
+
+		//Time allowed for this task to complete from when it was added to the host task queue, 
+		//in milliseconds, or 0 for no deadline.
+		//This value is only used by the host and is not sent to clients.
+		unsigned int deadlineMilliseconds;
+
+		//Host time this task was added to the host task queue.
+		//This value is only used by the host and is not sent to clients.
+		sf::Time hostTimeAdded;
+
+		//Should partial results streamed by this task be sent to the host?
+		bool streamResults;
+
+		//Where partial results streamed by this task go. Empty if the task is not running on a node.
+		//This value is local to each node and is not serialized.
+		PartialResultSink partialResultSink;
+
+		//Cancellation flag, shared with all parts split from this task.
+		//This value is local to each node and is not serialized.
+		CancellationToken cancellationToken;
+
+		//ID of the node the host would prefer to send this task to, or 0 for any node.
+		//This value is only used for task parts waiting on the host to be sent.
+		sf::Uint64 preferredNodeID;
+
+		/**
+		* Copy task settings and task part numbering from this task to a set of new split tasks.
+		* @param parts The new split tasks, in part number order.
+		* @returns void.
+		*/
+		void setSplitParts(std::vector<Task *> &parts) const;
+
 		/**
 		* Split this task up as equally as possible in to N chunks, and return
 		* a std::vector of pointers to those split tasks.
@@ -208,6 +476,15 @@ namespace cf
 		*/
 		virtual std::vector<Task *> splitLocal(unsigned int count) const = 0;
 
+		/**
+		* Split this task up in to chunks sized in proportion to a set of weights, and return
+		* a std::vector of pointers to those split tasks.
+		* By default weights are ignored and the task is split equally using splitLocal.
+		* @param weights The relative size of each part.
+		* @returns A std::vector of pointers to the new split tasks.
+		*/
+		virtual std::vector<Task *> splitWeightedLocal(const std::vector<double> &weights) const { return splitLocal((unsigned int)weights.size()); };
+
 		/**
 		* Serialize this task and store the data in a given packet.
 		* @param p The packet to store the data in.
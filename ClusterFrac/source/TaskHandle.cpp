@@ -0,0 +1,182 @@
+#include "TaskHandle.h"
+
+namespace cf
+{
+	TaskState::TaskState(unsigned __int64 newTaskID)
+	{
+		taskID = newTaskID;
+
+		future = promise.get_future().share();
+
+		complete = false;
+		abandoned = false;
+		cancelled = false;
+
+		partsDone = 0;
+		partsTotal = 1;
+
+		handleAlive = false;
+	}
+
+	TaskState::~TaskState()
+	{
+	}
+
+	void TaskState::setComplete(Result *r)
+	{
+		std::unique_lock<std::mutex> lock(stateMutex);
+
+		//A task can only complete once, and cancelled tasks never complete.
+		if (complete || abandoned || cancelled)
+		{
+			delete r;
+			return;
+		}
+
+		result.reset(r);
+		partsDone = (unsigned int)partsTotal;
+
+		//Run the callback while holding the lock, so a callback set at the same time is not missed.
+		if (callback) callback(*result);
+
+		complete = true;
+		lock.unlock();
+
+		promise.set_value();
+	}
+
+	void TaskState::setAbandoned()
+	{
+		std::unique_lock<std::mutex> lock(stateMutex);
+
+		if (complete || abandoned || cancelled) return;
+
+		abandoned = true;
+		lock.unlock();
+
+		promise.set_value();
+	}
+
+	bool TaskState::setCancelled()
+	{
+		std::unique_lock<std::mutex> lock(stateMutex);
+
+		if (complete || abandoned || cancelled) return false;
+
+		cancelled = true;
+		lock.unlock();
+
+		promise.set_value();
+
+		return true;
+	}
+
+	TaskHandle::TaskHandle()
+	{
+	}
+
+	TaskHandle::TaskHandle(std::shared_ptr<TaskState> newState)
+	{
+		state = newState;
+		if (state) state->handleAlive = true;
+	}
+
+	TaskHandle::TaskHandle(TaskHandle &&other)
+	{
+		state = std::move(other.state);
+	}
+
+	TaskHandle &TaskHandle::operator=(TaskHandle &&other)
+	{
+		//The task this handle was associated with no longer has a handle.
+		if (state && state != other.state) state->handleAlive = false;
+
+		state = std::move(other.state);
+		return *this;
+	}
+
+	TaskHandle::~TaskHandle()
+	{
+		if (state) state->handleAlive = false;
+	}
+
+	unsigned __int64 TaskHandle::getTaskID() const
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+		return state->taskID;
+	}
+
+	bool TaskHandle::isComplete() const
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+		return state->complete;
+	}
+
+	bool TaskHandle::isCancelled() const
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+		return state->cancelled;
+	}
+
+	unsigned int TaskHandle::getPartsDone() const
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+		return state->partsDone;
+	}
+
+	unsigned int TaskHandle::getPartsTotal() const
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+		return state->partsTotal;
+	}
+
+	std::shared_future<void> TaskHandle::getFuture() const
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+		return state->future;
+	}
+
+	void TaskHandle::wait() const
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+		state->future.wait();
+	}
+
+	bool TaskHandle::waitFor(unsigned int timeoutMilliseconds) const
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+		return state->future.wait_for(std::chrono::milliseconds(timeoutMilliseconds)) == std::future_status::ready;
+	}
+
+	void TaskHandle::setCompletionCallback(TaskState::CompletionCallback callback)
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+
+		std::unique_lock<std::mutex> lock(state->stateMutex);
+
+		//Task already completed, so run the callback now.
+		if (state->complete)
+		{
+			if (state->result) callback(*state->result);
+			return;
+		}
+
+		state->callback = callback;
+	}
+
+	Result *TaskHandle::getResult() const
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+
+		std::unique_lock<std::mutex> lock(state->stateMutex);
+		return state->result.get();
+	}
+
+	std::unique_ptr<Result> TaskHandle::takeResult()
+	{
+		if (!state) CF_THROW("Task handle is empty.");
+
+		std::unique_lock<std::mutex> lock(state->stateMutex);
+		return std::move(state->result);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,243 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include "DllExport.h"
+#include "ConsoleMessager.hpp"
+#include "Result.h"
+
+namespace cf
+{
+	//Forward declarations.
+	class Host;
+	class TaskHandle;
+
+	/**
+	* TaskState class. Completion state of a task submitted to a host, shared between the host 
+	* and the task handle returned to the application.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class TaskState
+	{
+
+		//These classes require full access to the task state.
+		friend class Host;
+		friend class TaskHandle;
+
+	public:
+
+		//Callback run when the task completes, with the final result.
+		typedef std::function<void(const Result &)> CompletionCallback;
+
+		//Callback run as each part of the task arrives, before the parts are merged.
+		//The flag is true for the complete result of a task part, and false for a partial result 
+		//streamed while a task part was still running.
+		typedef std::function<void(const Result &, bool)> PartCallback;
+
+		/**
+		* Constructor with task ID.
+		* @param newTaskID The ID of the task this state belongs to.
+		*/
+		DLL TaskState(unsigned __int64 newTaskID);
+
+		/**
+		* Default destructor.
+		*/
+		DLL ~TaskState();
+
+	private:
+
+		//The ID of the task.
+		unsigned __int64 taskID;
+
+		//Mutex for the result, callback and completion status.
+		std::mutex stateMutex;
+
+		//Promise fulfilled when the task completes, or when the host stops before the task completes.
+		std::promise<void> promise;
+
+		//Future for the promise, shared by all waiters.
+		std::shared_future<void> future;
+
+		//The final result. Empty until the task completes, or after ownership is taken by the application.
+		std::unique_ptr<Result> result;
+
+		//Callback to run when the task completes.
+		CompletionCallback callback;
+
+		//Callback to run as each part of the task arrives. Set before the task is queued, and not changed after.
+		PartCallback partCallback;
+
+		//Has the task completed?
+		std::atomic<bool> complete;
+
+		//Was the task abandoned because the host stopped before it completed?
+		std::atomic<bool> abandoned;
+
+		//Was the task cancelled before it completed?
+		std::atomic<bool> cancelled;
+
+		//Number of task parts that have finished.
+		std::atomic<unsigned int> partsDone;
+
+		//Total number of task parts.
+		std::atomic<unsigned int> partsTotal;
+
+		//Is a task handle still associated with this task? Set and cleared by the task handle.
+		std::atomic<bool> handleAlive;
+
+		/**
+		* Store the final result, run the completion callback and wake all waiters.
+		* @param r The final result. The task state takes ownership of the result.
+		* @returns void.
+		*/
+		void setComplete(Result *r);
+
+		/**
+		* Wake all waiters without a result, as the host has stopped.
+		* @returns void.
+		*/
+		void setAbandoned();
+
+		/**
+		* Wake all waiters without a result, as the task was cancelled.
+		* @returns True if the task was cancelled, false if it had already completed or been abandoned.
+		*/
+		bool setCancelled();
+
+	};
+
+	/**
+	* TaskHandle class. Returned by the host when a task is added to the task queue, and used 
+	* to wait for the task to complete, follow its progress and take ownership of its result.
+	* Task handles can be moved but not copied.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class TaskHandle
+	{
+
+	public:
+
+		/**
+		* Default constructor. Creates an empty handle that is not associated with a task.
+		*/
+		DLL TaskHandle();
+
+		/**
+		* Constructor with task state.
+		* @param newState The state of the task this handle is associated with.
+		*/
+		DLL TaskHandle(std::shared_ptr<TaskState> newState);
+
+		/**
+		* Move constructor.
+		* @param other The handle to move from. The other handle is left empty.
+		*/
+		DLL TaskHandle(TaskHandle &&other);
+
+		/**
+		* Move assignment.
+		* @param other The handle to move from. The other handle is left empty.
+		* @returns This handle.
+		*/
+		DLL TaskHandle &operator=(TaskHandle &&other);
+
+		//Task handles can't be copied, as only one handle may own the result.
+		TaskHandle(const TaskHandle &) = delete;
+		TaskHandle &operator=(const TaskHandle &) = delete;
+
+		/**
+		* Default destructor.
+		* A result that has not been taken from the handle is deleted along with it.
+		*/
+		DLL ~TaskHandle();
+
+		/**
+		* Is this handle associated with a task?
+		* @returns True if the handle is associated with a task, false if it is empty.
+		*/
+		DLL inline bool isValid() const { return state != nullptr; };
+
+		/**
+		* Get the ID of the task this handle is associated with.
+		* @returns The task ID.
+		*/
+		DLL unsigned __int64 getTaskID() const;
+
+		/**
+		* Has the task completed?
+		* @returns True if the task has completed and its result is available, false if not.
+		*/
+		DLL bool isComplete() const;
+
+		/**
+		* Was the task cancelled before it completed?
+		* A cancelled task never produces a result.
+		* @returns True if the task was cancelled, false if not.
+		*/
+		DLL bool isCancelled() const;
+
+		/**
+		* Get the number of task parts that have finished.
+		* @returns The number of task parts that have finished.
+		*/
+		DLL unsigned int getPartsDone() const;
+
+		/**
+		* Get the total number of parts the task was divided into.
+		* For tasks using a dynamic scheduling mode, this grows as chunks are handed out to nodes.
+		* @returns The total number of task parts.
+		*/
+		DLL unsigned int getPartsTotal() const;
+
+		/**
+		* Get a future that becomes ready when the task completes, is cancelled, or when the host stops.
+		* @returns A shared future for the task.
+		*/
+		DLL std::shared_future<void> getFuture() const;
+
+		/**
+		* Block until the task completes, is cancelled, or the host stops.
+		* @returns void.
+		*/
+		DLL void wait() const;
+
+		/**
+		* Block until the task completes, is cancelled, the host stops, or a timeout expires.
+		* Use isComplete() or isCancelled() to find out how a finished task ended.
+		* @param timeoutMilliseconds The maximum time to wait, in milliseconds.
+		* @returns True if the task has finished, whether it completed, was cancelled or the host stopped, false if the timeout expired.
+		*/
+		DLL bool waitFor(unsigned int timeoutMilliseconds) const;
+
+		/**
+		* Set a callback to run when the task completes. The callback is run on the thread that completed
+		* the task, or immediately on this thread if the task has already completed. The callback must not 
+		* call back in to this handle.
+		* @param callback The callback to run, which receives the final result.
+		* @returns void.
+		*/
+		DLL void setCompletionCallback(TaskState::CompletionCallback callback);
+
+		/**
+		* Get the final result without taking ownership of it.
+		* @returns A pointer to the result, or nullptr if the task has not completed or the result was already taken.
+		*/
+		DLL Result *getResult() const;
+
+		/**
+		* Take ownership of the final result.
+		* @returns The result, or an empty pointer if the task has not completed or the result was already taken.
+		*/
+		DLL std::unique_ptr<Result> takeResult();
+
+	private:
+
+		//State of the task, shared with the host.
+		std::shared_ptr<TaskState> state;
+
+	};
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "TaskScheduler.h"
+#include <algorithm>
+
+namespace cf
+{
+	const double TaskScheduler::FINAL_CHUNK_FRACTION = 0.001;
+	const unsigned int TaskScheduler::MAX_CHUNKS;
+
+	TaskScheduler::TaskScheduler(Task *newTask, unsigned int newWorkers, bool newOwnsTask)
+	{
+		if (newTask == nullptr) CF_THROW("Cannot schedule an empty task.");
+		if (newWorkers < 1) CF_THROW("Invalid worker count for task scheduler.");
+		if (newTask->getSchedulingMode() == Task::SchedulingModes::Static) CF_THROW("Task scheduler requires a dynamic scheduling mode.");
+
+		workers = newWorkers;
+		mode = newTask->getSchedulingMode();
+		minGrainSize = newTask->getMinGrainSize();
+		batchChunksLeft = 0;
+		batchChunkSize = 0;
+		initialTaskID = newTask->getInitialTaskID();
+		taskDepth = newTask->getTaskPartNumberStack().size();
+		priority = newTask->getPriority();
+		hostDeadline = newTask->getHostDeadline();
+
+		//Split the task into every chunk at once. If the task can't be split as finely as planned, 
+		//it is handed out in as many chunks as it could be split into.
+		std::vector<Task *> parts = newTask->splitWeighted(planChunks(newTask->getWorkSize()));
+		chunks.assign(parts.begin(), parts.end());
+
+		if (newOwnsTask) delete newTask;
+	}
+
+	TaskScheduler::~TaskScheduler()
+	{
+		for (auto &c : chunks) delete c;
+		chunks.clear();
+	}
+
+	std::vector<Task *> TaskScheduler::next(unsigned int count)
+	{
+		std::unique_lock<std::mutex> lock(schedulerMutex);
+
+		if (chunks.size() == 0 || count == 0) return std::vector<Task *>();
+
+		//Hand out everything if the task has been cancelled, as its parts will return straight away.
+		if (chunks.front()->isCancelled()) count = (unsigned int)chunks.size();
+
+		size_t taken = std::min((size_t)count, chunks.size());
+		std::vector<Task *> parts(chunks.begin(), chunks.begin() + taken);
+		chunks.erase(chunks.begin(), chunks.begin() + taken);
+
+		return parts;
+	}
+
+	bool TaskScheduler::isFinished()
+	{
+		std::unique_lock<std::mutex> lock(schedulerMutex);
+		return chunks.size() == 0;
+	}
+
+	void TaskScheduler::setPriority(Task::Priorities newPriority)
+	{
+		std::unique_lock<std::mutex> lock(schedulerMutex);
+		priority = newPriority;
+		for (auto &c : chunks) c->setPriority(newPriority);
+	}
+
+	double TaskScheduler::nextChunkSize(double left)
+	{
+		double size;
+
+		if (mode == Task::SchedulingModes::Factoring)
+		{
+			//Factoring hands out chunks in batches of one per worker. Each batch covers half of the work left when the batch began.
+			if (batchChunksLeft == 0)
+			{
+				batchChunkSize = left / (2.0 * workers);
+				batchChunksLeft = workers;
+			}
+			batchChunksLeft--;
+			size = batchChunkSize;
+		}
+		else
+		{
+			//Guided scheduling hands out an equal share of the work left at the time of each request.
+			size = left / workers;
+		}
+
+		return std::max(size, minGrainSize);
+	}
+
+	std::vector<double> TaskScheduler::planChunks(double total)
+	{
+		std::vector<double> weights;
+		double left = total;
+		while (left > 0)
+		{
+			double size = nextChunkSize(left);
+
+			//Take everything if what would be left over is only a sliver of the task, or if the chunk limit has been reached.
+			if (left - size <= total * FINAL_CHUNK_FRACTION || weights.size() + 1 >= MAX_CHUNKS) size = left;
+
+			weights.push_back(size);
+			left -= size;
+		}
+
+		//A task with no work to measure is handed out whole.
+		if (weights.size() == 0) weights.push_back(1.0);
+
+		return weights;
+	}
+}
\ No newline at end of file
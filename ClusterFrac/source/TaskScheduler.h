@@ -0,0 +1,142 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <mutex>
+#include "DllExport.h"
+#include "ConsoleMessager.hpp"
+#include "Task.h"
+
+namespace cf
+{
+	/**
+	* TaskScheduler class. Hands out a task in progressively smaller chunks on demand, following
+	* the guided or factoring schedule chosen by the task's scheduling mode, and never smaller
+	* than the task's minimum grain size. The whole chunk sequence is planned when the scheduler is
+	* created, and the task is split into those chunks once, so every chunk is one level below the
+	* task in the task part stack however many are handed out. Chunk results merge back into the 
+	* original task's result as usual.
+	* Chunks are sized using the work sizes reported by Task::getWorkSize, so tasks should override
+	* getWorkSize and splitWeightedLocal. Tasks that don't are split into equal chunks.
+	* Thread safe.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class TaskScheduler
+	{
+
+	public:
+
+		//Once the work left to plan is less than this fraction of the task, the last chunk takes all of it.
+		static const double FINAL_CHUNK_FRACTION;
+
+		//Most chunks a task is split into.
+		static const unsigned int MAX_CHUNKS = 4096;
+
+		/**
+		* Constructor with task to schedule.
+		* @param newTask The task to hand out in chunks. Its scheduling mode must not be Static.
+		* @param newWorkers The number of workers (nodes or threads) the chunks are shared among. Must be at least 1.
+		* @param newOwnsTask True if the scheduler should delete the task once it has been split, false if the caller keeps ownership.
+		* The task is split straight away.
+		*/
+		DLL TaskScheduler(Task *newTask, unsigned int newWorkers, bool newOwnsTask);
+
+		/**
+		* Default destructor.
+		* Deletes any work not yet handed out.
+		*/
+		DLL ~TaskScheduler();
+
+		/**
+		* Take the next chunks of the task.
+		* The chunks are new tasks, owned by the caller.
+		* @param count The maximum number of chunks to take.
+		* @returns Up to count chunks, or an empty vector if the whole task has been handed out.
+		*/
+		DLL std::vector<Task *> next(unsigned int count);
+
+		/**
+		* Has the whole task been handed out?
+		* @returns True if no work is left to hand out, false if not.
+		*/
+		DLL bool isFinished();
+
+		/**
+		* Get the initial ID of the task being scheduled.
+		* @returns The initial task ID.
+		*/
+		DLL inline unsigned __int64 getInitialTaskID() const { return initialTaskID; };
+
+		/**
+		* Get the task part number stack depth of the task being scheduled. Chunk results are
+		* merged back to this depth to form the result for the task.
+		* @returns The task part number stack depth of the task being scheduled.
+		*/
+		DLL inline size_t getTaskDepth() const { return taskDepth; };
+
+		/**
+		* Get the priority of the task being scheduled.
+		* @returns The priority, from the Task::Priorities enum.
+		*/
+		DLL inline Task::Priorities getPriority() const { return priority; };
+
+		/**
+		* Change the priority of the task being scheduled. Chunks taken from now on have the new priority.
+		* @param newPriority The new priority, from the Task::Priorities enum.
+		* @returns void.
+		*/
+		DLL void setPriority(Task::Priorities newPriority);
+
+		/**
+		* Get the host time by which the task being scheduled should be complete.
+		* @returns The deadline as a host time, or sf::Time::Zero if the task has no deadline.
+		*/
+		DLL inline sf::Time getHostDeadline() const { return hostDeadline; };
+
+	private:
+
+		//Chunks not yet handed out, in the order they are handed out.
+		std::deque<Task *> chunks;
+
+		//Number of workers the chunks are shared among.
+		unsigned int workers;
+
+		//Scheduling mode of the task.
+		Task::SchedulingModes mode;
+
+		//Minimum chunk size, in task work units.
+		double minGrainSize;
+
+		//Factoring schedule: chunks still to hand out in the current batch, and their size.
+		unsigned int batchChunksLeft;
+		double batchChunkSize;
+
+		//Initial ID of the task being scheduled.
+		unsigned __int64 initialTaskID;
+
+		//Task part number stack depth of the task being scheduled.
+		size_t taskDepth;
+
+		//Priority of the task being scheduled.
+		Task::Priorities priority;
+
+		//Host time by which the task being scheduled should be complete, or sf::Time::Zero for no deadline.
+		sf::Time hostDeadline;
+
+		//Mutex for scheduler state.
+		std::mutex schedulerMutex;
+
+		/**
+		* Get the size of the next chunk according to the scheduling mode.
+		* @param left The work not yet handed out, in task work units.
+		* @returns The size of the next chunk, in task work units.
+		*/
+		double nextChunkSize(double left);
+
+		/**
+		* Plan the size of every chunk in the order they will be handed out.
+		* @param total The work size of the whole task, in task work units.
+		* @returns The chunk sizes, in task work units.
+		*/
+		std::vector<double> planChunks(double total);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "ThreadPool.h"
+
+namespace cf
+{
+	//The pool and worker index the current thread belongs to, if it is a pool worker thread.
+	static thread_local ThreadPool *currentPool = nullptr;
+	static thread_local unsigned int currentWorkerIndex = 0;
+
+	ThreadPool::ThreadPool()
+	{
+		//Default run status.
+		run = false;
+		draining = false;
+
+		nextWorker = 0;
+
+		queuedJobs = 0;
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		stop();
+	}
+
+	void ThreadPool::start(unsigned int threadCount)
+	{
+		//If pool is already started, do nothing.
+		if (run) return;
+
+		if (threadCount < 1) CF_THROW("Invalid thread pool size.");
+
+		run = true;
+
+		//Create all workers before launching threads, as workers steal from each other.
+		for (unsigned int i = 0; i < threadCount; i++) workers.push_back(new Worker());
+
+		for (unsigned int i = 0; i < threadCount; i++)
+		{
+			workers[i]->thread = std::thread([this, i] { workerThread(i); });
+		}
+
+		CF_SAY("Thread pool started with " + std::to_string(threadCount) + " thread(s).", Settings::LogLevels::Debug);
+	}
+
+	void ThreadPool::stop(bool drain)
+	{
+		//If already stopped, do nothing.
+		if (!run) return;
+
+		//Signal all workers to shut down, once the queued jobs have run if draining.
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		draining = drain;
+		run = false;
+		lock.unlock();
+		wakeCondition.notify_all();
+
+		//Wait for the worker threads to finish their current jobs.
+		for (auto &w : workers)
+		{
+			if (w->thread.joinable()) w->thread.join();
+		}
+
+		//Workers stop once they find nothing left to take, so a job running on another worker may have queued 
+		//more jobs after they stopped. Run any such jobs here.
+		if (draining)
+		{
+			Job job;
+			while (takeJob(0, job))
+			{
+				job();
+				job = nullptr;
+			}
+			draining = false;
+		}
+
+		//Discard jobs that were never started.
+		for (auto &w : workers)
+		{
+			delete w;
+			w = nullptr;
+		}
+		workers.clear();
+
+		queuedJobs = 0;
+	}
+
+	void ThreadPool::submit(Job job)
+	{
+		//Jobs may still be submitted while the pool is draining.
+		if (!run && !draining) CF_THROW("Cannot submit job. Thread pool not started.");
+
+		//Place jobs created by our own workers on that worker's deque, so a worker keeps
+		//its own work local. Jobs from outside the pool are spread among the workers.
+		unsigned int index;
+		if (currentPool == this)
+		{
+			index = currentWorkerIndex;
+		}
+		else
+		{
+			index = nextWorker++ % (unsigned int)workers.size();
+		}
+
+		std::unique_lock<std::mutex> jobsLock(workers[index]->jobsMutex);
+		workers[index]->jobs.push_back(job);
+		jobsLock.unlock();
+
+		//Update the queued job count under the wake mutex so a worker about to sleep can't miss it.
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		queuedJobs++;
+		lock.unlock();
+		wakeCondition.notify_one();
+	}
+
+	void ThreadPool::runTasks(std::vector<Task *> tasks, std::function<void(std::vector<Result *> &)> onComplete)
+	{
+		//Results for the set, and a count of the tasks still running.
+		//Shared by all jobs in the set and released when the final job finishes.
+		struct TaskSet
+		{
+			std::vector<Result *> results;
+			std::atomic<size_t> remaining;
+			std::function<void(std::vector<Result *> &)> onComplete;
+		};
+
+		std::shared_ptr<TaskSet> set = std::make_shared<TaskSet>();
+		set->results.resize(tasks.size(), nullptr);
+		set->remaining = tasks.size();
+		set->onComplete = onComplete;
+
+		for (size_t i = 0; i < tasks.size(); i++)
+		{
+			Task *task = tasks[i];
+			submit([set, task, i]()
+			{
+				set->results[i] = task->run();
+
+				//The final task in the set to finish hands the results on.
+				if (--set->remaining == 0) set->onComplete(set->results);
+			});
+		}
+	}
+
+	void ThreadPool::runScheduledTask(Task *task, bool ownsTask, std::function<void(std::vector<Task *> &, std::vector<Result *> &)> onComplete)
+	{
+		//Chunks handed out so far and their results, and a count of the jobs still running.
+		//Shared by all jobs for the task and released when the final job finishes.
+		struct ScheduledSet
+		{
+			ScheduledSet(Task *task, unsigned int workers, bool ownsTask) : scheduler(task, workers, ownsTask) {};
+			TaskScheduler scheduler;
+			std::mutex resultsMutex;
+			std::vector<Task *> tasks;
+			std::vector<Result *> results;
+			std::atomic<unsigned int> remaining;
+			std::function<void(std::vector<Task *> &, std::vector<Result *> &)> onComplete;
+		};
+
+		unsigned int jobCount = getThreadCount();
+
+		std::shared_ptr<ScheduledSet> set = std::make_shared<ScheduledSet>(task, jobCount, ownsTask);
+		set->remaining = jobCount;
+		set->onComplete = onComplete;
+
+		for (unsigned int i = 0; i < jobCount; i++)
+		{
+			submit([set]()
+			{
+				//Keep taking chunks until the whole task has been handed out.
+				std::vector<Task *> chunks;
+				while ((chunks = set->scheduler.next(1)).size() > 0)
+				{
+					for (auto &chunk : chunks)
+					{
+						Result *result = chunk->run();
+
+						std::unique_lock<std::mutex> lock(set->resultsMutex);
+						set->tasks.push_back(chunk);
+						set->results.push_back(result);
+					}
+				}
+
+				//The final job to finish hands the results on.
+				if (--set->remaining == 0) set->onComplete(set->tasks, set->results);
+			});
+		}
+	}
+
+	void ThreadPool::workerThread(unsigned int index)
+	{
+		try
+		{
+			currentPool = this;
+			currentWorkerIndex = index;
+
+			Job job;
+			while (!cf::ConsoleMessager::getInstance()->exceptionThrown)
+			{
+				//Stop straight away unless the pool is draining.
+				if (!run && !draining) break;
+
+				if (takeJob(index, job))
+				{
+					job();
+					job = nullptr;
+				}
+				else if (!run)
+				{
+					//Nothing left to drain.
+					break;
+				}
+				else
+				{
+					//Nothing to do anywhere in the pool. Sleep until a job is submitted or the pool stops.
+					std::unique_lock<std::mutex> lock(wakeMutex);
+					wakeCondition.wait(lock, [this] { return !run || queuedJobs > 0; });
+				}
+			}
+		}
+		catch (...)
+		{
+			//Do nothing with exceptions in threads. Main thread will see the exception message via ConsoleMessager object.
+
+			if (!cf::ConsoleMessager::getInstance()->exceptionThrown)
+			{
+				cf::ConsoleMessager::getInstance()->exceptionThrown = true;
+				cf::ConsoleMessager::getInstance()->exceptionMessage = "Unknown exception in ThreadPool workerThread.";
+			}
+		}
+	}
+
+	bool ThreadPool::takeJob(unsigned int index, Job &job)
+	{
+		unsigned int count = (unsigned int)workers.size();
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			Worker *w = workers[(index + i) % count];
+
+			std::unique_lock<std::mutex> lock(w->jobsMutex);
+			if (w->jobs.size() == 0) continue;
+
+			//Take the oldest job, whether from our own deque or stolen from another worker, so
+			//parts of earlier tasks are finished before parts of later ones.
+			job = std::move(w->jobs.front());
+			w->jobs.pop_front();
+			lock.unlock();
+
+			queuedJobs--;
+			return true;
+		}
+
+		return false;
+	}
+}
\ No newline at end of file
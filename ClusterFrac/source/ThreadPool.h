@@ -0,0 +1,154 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+#include "DllExport.h"
+#include "ConsoleMessager.hpp"
+#include "Task.h"
+#include "Result.h"
+#include "TaskScheduler.h"
+
+namespace cf
+{
+	/**
+	* ThreadPool class. Maintains a fixed set of long-lived worker threads, each with its own
+	* job deque. Workers take jobs from their own deque and steal from other workers' deques
+	* when their own is empty, so task parts from consecutive tasks overlap and no OS thread
+	* is created per task part.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	class ThreadPool
+	{
+
+	public:
+
+		//A unit of work to be run by the pool.
+		typedef std::function<void()> Job;
+
+		/**
+		* Default constructor.
+		*/
+		DLL ThreadPool();
+
+		/**
+		* Default destructor.
+		*/
+		DLL ~ThreadPool();
+
+		/**
+		* Start the worker threads.
+		* If the pool is already started, this has no effect.
+		* @param threadCount The number of worker threads to start. Must be at least 1.
+		* @returns void.
+		*/
+		DLL void start(unsigned int threadCount);
+
+		/**
+		* Stop the worker threads.
+		* Unless the pool is drained, jobs that have not yet started are discarded without being run, 
+		* so jobs must either be safe to drop, or their owner must drain the pool.
+		* When draining, every queued job is run before the pool stops, including jobs queued by other 
+		* jobs while the pool is stopping.
+		* If the pool is already stopped, this has no effect.
+		* @param drain True to run every queued job before stopping, false to discard jobs not yet started.
+		* @returns void.
+		*/
+		DLL void stop(bool drain = false);
+
+		/**
+		* Add a job to the pool.
+		* Jobs added from a worker thread of this pool are placed on that worker's own deque.
+		* Jobs added from any other thread are distributed among the workers in turn.
+		* @param job The job to run.
+		* @returns void.
+		*/
+		DLL void submit(Job job);
+
+		/**
+		* Run each task in a set of tasks as a separate job, and call a completion callback once
+		* every task in the set has produced its result. This call does not block.
+		* The callback is run on the worker thread that completed the final task in the set.
+		* @param tasks The tasks to run.
+		* @param onComplete The callback to run with the results, in the same order as the tasks.
+		* @returns void.
+		*/
+		DLL void runTasks(std::vector<Task *> tasks, std::function<void(std::vector<Result *> &)> onComplete);
+
+		/**
+		* Run a task using its dynamic scheduling mode. One job per worker thread repeatedly takes the next chunk
+		* of the task and runs it, until the whole task has been handed out. Calls a completion callback once 
+		* every chunk has produced its result. This call does not block.
+		* The callback is run on the worker thread that completed the final chunk, and owns the chunks and results.
+		* @param task The task to run. Its scheduling mode must not be Static.
+		* @param ownsTask True if the task should be deleted once it has been split into chunks, false if the caller keeps ownership.
+		* @param onComplete The callback to run with the chunks and their results, in the same order as each other.
+		* @returns void.
+		*/
+		DLL void runScheduledTask(Task *task, bool ownsTask, std::function<void(std::vector<Task *> &, std::vector<Result *> &)> onComplete);
+
+		/**
+		* Get the number of worker threads in the pool.
+		* @returns The number of worker threads in the pool.
+		*/
+		DLL inline unsigned int getThreadCount() const { return (unsigned int)workers.size(); };
+
+	private:
+
+		/**
+		* Worker thread details.
+		*/
+		struct Worker
+		{
+			//Jobs queued on this worker.
+			std::deque<Job> jobs;
+
+			//Mutex for the jobs deque.
+			std::mutex jobsMutex;
+
+			//The worker's thread.
+			std::thread thread;
+		};
+
+		//Worker threads and their job deques.
+		std::vector<Worker *> workers;
+
+		//Should the worker threads continue to run?
+		std::atomic<bool> run;
+
+		//Is the pool stopping once its queued jobs have run?
+		std::atomic<bool> draining;
+
+		//Next worker to receive a job submitted from outside the pool.
+		std::atomic<unsigned int> nextWorker;
+
+		//Number of jobs waiting in all worker deques.
+		std::atomic<int> queuedJobs;
+
+		//Mutex used by idle workers while waiting for jobs.
+		std::mutex wakeMutex;
+
+		//Signals idle workers that jobs are available or the pool is stopping.
+		std::condition_variable wakeCondition;
+
+		/**
+		* Process jobs from the worker's own deque, stealing from other workers when it is empty.
+		* To be used by a dedicated thread.
+		* @param index The index of the worker this thread belongs to.
+		* @returns void.
+		*/
+		void workerThread(unsigned int index);
+
+		/**
+		* Take the next job for a worker. Tries the worker's own deque first, then the other workers.
+		* @param index The index of the worker taking a job.
+		* @param job Receives the job that was taken.
+		* @returns True if a job was taken, false if all deques were empty.
+		*/
+		bool takeJob(unsigned int index, Job &job);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,337 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <functional>
+#include <mutex>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <SFML\Network.hpp>
+#include "DllExport.h"
+#include "WorkPacket.h"
+#include "ConsoleMessager.hpp"
+#include "ObjectPool.h"
+
+namespace cf
+{
+	class Task;
+	class Result;
+
+	/**
+	* Type registry class. Stores the construction callbacks for user defined task or result
+	* subtypes, and gives each subtype a compact numeric ID in registration order.
+	* Objects are written to packets with a fixed size binary header holding a kind byte and
+	* the subtype ID, instead of the type and subtype names.
+	* The host's IDs are used on the wire. The host sends its subtype names to each client in
+	* the handshake, and the client maps between the host's IDs and its own.
+	* Subtypes the other end was not told about, such as those registered on the host after a client
+	* connected, are sent with their name inline after the header and looked up by name.
+	* Subtype IDs of objects are found from their C++ type, so getSubtype() is only called the
+	* first time an object of each C++ type is seen. Each C++ type must always return the same subtype.
+	* Thread safe.
+	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
+	*/
+	template <class T, sf::Uint8 KIND>
+	class TypeRegistry
+	{
+
+	public:
+
+		//ID used for subtypes that are not registered. In a header, it means the subtype name follows.
+		static const sf::Uint16 INVALID_ID = 0xFFFF;
+
+		/**
+		* Default constructor.
+		*/
+		DLL TypeRegistry()
+		{
+			//Wire IDs are the same as local IDs until a remote subtype list is set.
+			remoteMapped = false;
+		};
+
+		/**
+		* Default destructor.
+		*/
+		DLL ~TypeRegistry()
+		{
+		};
+
+		/**
+		* Register a subtype construction callback.
+		* Registering a name again replaces its callback and keeps its ID.
+		* @param name The subtype name, as returned by getSubtype().
+		* @param f The callback function to use to construct a new object of this subtype.
+		* @param poolSize Number of objects of this subtype to set aside pooled memory for.
+		* @returns void.
+		*/
+		DLL void add(const std::string &name, std::function<T *()> f, unsigned int poolSize = 0)
+		{
+			reserve(f, poolSize);
+
+			std::unique_lock<std::mutex> lock(registryMutex);
+
+			auto it = ids.find(name);
+			if (it != ids.end())
+			{
+				factories[it->second] = f;
+				return;
+			}
+
+			if (names.size() >= INVALID_ID) CF_THROW("Too many types registered.");
+
+			sf::Uint16 id = (sf::Uint16)names.size();
+			names.push_back(name);
+			factories.push_back(f);
+			ids[name] = id;
+
+			//Keep the wire mapping valid for the new subtype.
+			if (remoteMapped)
+			{
+				localToRemote.push_back(INVALID_ID);
+				for (size_t i = 0; i < remoteNames.size(); i++)
+				{
+					if (remoteNames[i] == name)
+					{
+						localToRemote[id] = (sf::Uint16)i;
+						remoteToLocal[i] = id;
+					}
+				}
+			}
+		};
+
+		/**
+		* Get the local ID of an object's subtype.
+		* @param object The object.
+		* @returns The subtype ID, or INVALID_ID if the subtype is not registered.
+		*/
+		DLL sf::Uint16 getID(const T *object)
+		{
+			std::type_index type(typeid(*object));
+
+			std::unique_lock<std::mutex> lock(registryMutex);
+
+			auto it = typeIDs.find(type);
+			if (it != typeIDs.end()) return it->second;
+
+			//First object of this C++ type. Look its subtype up by name and remember it.
+			auto nameIt = ids.find(object->getSubtype());
+			if (nameIt == ids.end()) return INVALID_ID;
+
+			typeIDs[type] = nameIt->second;
+			return nameIt->second;
+		};
+
+		/**
+		* Is a subtype ID registered?
+		* @param id The local subtype ID.
+		* @returns True if the subtype is registered, false if not.
+		*/
+		DLL inline bool has(sf::Uint16 id)
+		{
+			std::unique_lock<std::mutex> lock(registryMutex);
+			return id < factories.size();
+		};
+
+		/**
+		* Construct a new object of a registered subtype.
+		* @param id The local subtype ID.
+		* @returns The new object, or nullptr if the subtype is not registered.
+		*/
+		DLL T *create(sf::Uint16 id)
+		{
+			std::unique_lock<std::mutex> lock(registryMutex);
+			if (id >= factories.size()) return nullptr;
+			std::function<T *()> f = factories[id];
+			lock.unlock();
+
+			return f();
+		};
+
+		/**
+		* Construct a new object of the same subtype as a given object.
+		* @param object The object.
+		* @returns The new object, or nullptr if the subtype is not registered.
+		*/
+		DLL inline T *createLike(const T *object) { return create(getID(object)); };
+
+		/**
+		* Get the registered subtype names, in ID order.
+		* @returns The subtype names.
+		*/
+		DLL inline std::vector<std::string> getNames()
+		{
+			std::unique_lock<std::mutex> lock(registryMutex);
+			return names;
+		};
+
+		/**
+		* Set the subtype names registered on the other end of the connection, in the other end's ID order.
+		* From then on, headers are written and read using the other end's IDs.
+		* @param newRemoteNames The subtype names registered on the other end.
+		* @returns void.
+		*/
+		DLL void setRemoteNames(const std::vector<std::string> &newRemoteNames)
+		{
+			std::unique_lock<std::mutex> lock(registryMutex);
+
+			remoteNames = newRemoteNames;
+			remoteToLocal.assign(remoteNames.size(), INVALID_ID);
+			localToRemote.assign(names.size(), INVALID_ID);
+
+			for (size_t i = 0; i < remoteNames.size() && i < INVALID_ID; i++)
+			{
+				auto it = ids.find(remoteNames[i]);
+				if (it == ids.end()) continue;
+				remoteToLocal[i] = it->second;
+				localToRemote[it->second] = (sf::Uint16)i;
+			}
+
+			remoteMapped = true;
+		};
+
+		/**
+		* Store the registered subtype names in a given packet, in ID order.
+		* @param p The packet to store the names in.
+		* @returns The number of names stored. Subtypes with lower IDs are known to the other end.
+		*/
+		DLL sf::Uint16 serializeNames(WorkPacket &p)
+		{
+			std::vector<std::string> n = getNames();
+			p << (sf::Uint16)n.size();
+			for (auto &s : n) p << s;
+			return (sf::Uint16)n.size();
+		};
+
+		/**
+		* Read subtype names stored by serializeNames from a given packet.
+		* @param p The packet to read the names from.
+		* @returns The subtype names, in ID order.
+		*/
+		DLL static std::vector<std::string> deserializeNames(WorkPacket &p)
+		{
+			sf::Uint16 size = 0;
+			p >> size;
+			std::vector<std::string> n(size);
+			for (auto &s : n) p >> s;
+			return n;
+		};
+
+		/**
+		* Write the binary header for an object to a given packet.
+		* Subtypes the other end does not know the ID of are written with their name inline.
+		* Throws an error if the object's subtype is not registered.
+		* @param p The packet to write the header to.
+		* @param object The object the header is for.
+		* @param knownCount Number of subtypes the other end was told about when it connected, when the wire IDs are this end's own.
+		* @returns void.
+		*/
+		DLL void writeHeader(WorkPacket &p, const T *object, sf::Uint16 knownCount = INVALID_ID)
+		{
+			sf::Uint16 id = getID(object);
+			if (id == INVALID_ID) CF_THROW("Cannot send object of unregistered type " + object->getSubtype() + ".");
+
+			std::unique_lock<std::mutex> lock(registryMutex);
+			if (remoteMapped) id = localToRemote[id];
+			else if (id >= knownCount) id = INVALID_ID;
+			lock.unlock();
+
+			p << KIND;
+			p << id;
+
+			//The other end looks the subtype up by name instead.
+			if (id == INVALID_ID) p << object->getSubtype();
+		};
+
+		/**
+		* Read a binary header from a given packet, and construct a new object of the subtype it names.
+		* The object's data still needs to be read with its deserialize function.
+		* @param p The packet to read the header from.
+		* @returns The new object, or nullptr if the header is not for this kind of object or its subtype is not registered.
+		*/
+		DLL T *readHeader(WorkPacket &p)
+		{
+			sf::Uint8 kind = 0;
+			sf::Uint16 id = INVALID_ID;
+			p >> kind;
+			p >> id;
+
+			if (kind != KIND) return nullptr;
+
+			std::unique_lock<std::mutex> lock(registryMutex);
+			if (id == INVALID_ID)
+			{
+				//The subtype was sent by name.
+				std::string name;
+				p >> name;
+				auto it = ids.find(name);
+				if (it != ids.end()) id = it->second;
+			}
+			else if (remoteMapped)
+			{
+				id = id < remoteToLocal.size() ? remoteToLocal[id] : INVALID_ID;
+			}
+			lock.unlock();
+
+			return create(id);
+		};
+
+	private:
+
+		/**
+		* Fill the object pool with memory for objects of a subtype, by constructing and destroying them.
+		* Raises the object pool limit if it would not keep them all.
+		* @param f The callback function used to construct objects of the subtype.
+		* @param count The number of objects to set aside memory for.
+		* @returns void.
+		*/
+		static void reserve(std::function<T *()> f, unsigned int count)
+		{
+			if (count == 0) return;
+
+			if (CF_POOL->getMaxFreeBlocks() < count) CF_POOL->setMaxFreeBlocks(count);
+
+			std::vector<T *> objects;
+			objects.reserve(count);
+			for (unsigned int i = 0; i < count; i++) objects.push_back(f());
+			for (auto &o : objects)
+			{
+				delete o;
+				o = nullptr;
+			}
+		};
+
+		//Construction callbacks, indexed by subtype ID.
+		std::vector<std::function<T *()>> factories;
+
+		//Subtype names, indexed by subtype ID.
+		std::vector<std::string> names;
+
+		//Subtype IDs by name.
+		std::unordered_map<std::string, sf::Uint16> ids;
+
+		//Subtype IDs by C++ type, filled in as objects are seen.
+		std::unordered_map<std::type_index, sf::Uint16> typeIDs;
+
+		//Has a remote subtype list been set?
+		bool remoteMapped;
+
+		//Subtype names registered on the other end of the connection, indexed by their remote ID.
+		std::vector<std::string> remoteNames;
+
+		//Local subtype IDs indexed by remote ID, and remote subtype IDs indexed by local ID.
+		std::vector<sf::Uint16> remoteToLocal;
+		std::vector<sf::Uint16> localToRemote;
+
+		//Mutex for registry state.
+		std::mutex registryMutex;
+	};
+
+	template <class T, sf::Uint8 KIND>
+	const sf::Uint16 TypeRegistry<T, KIND>::INVALID_ID;
+
+	//Registry for user defined tasks.
+	typedef TypeRegistry<Task, 1> TaskTypeRegistry;
+
+	//Registry for user defined results.
+	typedef TypeRegistry<Result, 2> ResultTypeRegistry;
+}
\ No newline at end of file
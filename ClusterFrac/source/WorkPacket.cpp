@@ -1,4 +1,5 @@
 #include "WorkPacket.h"
+#include <algorithm>
 
 namespace cf
 {
@@ -8,6 +9,8 @@ namespace cf
 		//Packets have no flag by default.
 		flag = None;
 
+		largestDataSize = 0;
+
 		init();
 	}
 
@@ -16,6 +19,8 @@ namespace cf
 		//Set flag.
 		setFlag(newFlag);
 
+		largestDataSize = 0;
+
 		init();
 	}
 
@@ -27,6 +32,14 @@ namespace cf
 	{
 		//Compression default status.
 		compression = false;
+		compressionEngine = nullptr;
+
+		sendPrepared = false;
+		sendSize = 0;
+		sendCompressed = false;
+		sendBlocked = false;
+		chunkOffset = 0;
+		readError = false;
 	}
 
 	DLL void WorkPacket::setFlag(Flag newFlag)
@@ -34,85 +47,141 @@ namespace cf
 		flag = newFlag;
 	}
 
-	const void * WorkPacket::onSend(std::size_t & size)
+	bool WorkPacket::isLittleEndian()
 	{
-		//Append flag to data stream.
-		*this << flag;
-
-		const void *tmpData;
+		const sf::Uint16 probe = 1;
+		return *reinterpret_cast<const sf::Uint8 *>(&probe) == 1;
+	}
 
-		if (compression)
+	void WorkPacket::swapBytes(void *data, std::size_t count, std::size_t size)
+	{
+		sf::Uint8 *bytes = static_cast<sf::Uint8 *>(data);
+		for (std::size_t i = 0; i < count; i++)
 		{
+			std::reverse(bytes + i * size, bytes + (i + 1) * size);
+		}
+	}
 
-			// Cast the data to a bytef pointer
-			const Bytef* srcData = static_cast<const Bytef*>(getData());
-
-			// Get the size of the packet to send
-			size_t tmpSize = getDataSize();
-
-			//Zlib by default only supports 32 bits max for the size integer.
-			if (tmpSize > ULONG_MAX) CF_THROW("Data too large to compress using Zlib.");
+	const void * WorkPacket::onSend(std::size_t & size)
+	{
+		//A partly sent packet asks for its data again to send the rest. Only append the flag and compress once.
+		//Being asked again means the send buffer filled up before the packet fitted.
+		if (sendPrepared)
+		{
+			sendBlocked = true;
+			size = sendSize;
+			return sendCompressed ? oCompressionBuffer.data() : getData();
+		}
 
-			uLong srcSize = (uLong)tmpSize;
+		sendStarted = std::chrono::steady_clock::now();
+		sendBlocked = false;
 
-			//Compute the size of the compressed data
-			uLong dstSize = compressBound(srcSize);
+		//Append flag to data stream.
+		*this << flag;
 
-			//Resize the vector to accomodate the compressed data,
-			//plus four bytes for our uncompressed size
-			oCompressionBuffer.resize(dstSize + 4);
+		const void *tmpData;
 
-			//Store srcSize as the first four bytes of the buffer
-			oCompressionBuffer[0] = srcSize & 0xFF;
-			oCompressionBuffer[1] = (srcSize >> 8) & 0xFF;
-			oCompressionBuffer[2] = (srcSize >> 16) & 0xFF;
-			oCompressionBuffer[3] = (srcSize >> 24) & 0xFF;
+		//Batch packets use the dictionary for the type of packet they hold, which is their first byte.
+		sf::Uint8 dictionaryFlag = flag;
+		if (flag == Batch && getDataSize() > sizeof flag) dictionaryFlag = *static_cast<const sf::Uint8 *>(getData());
 
-			//Compress the data into the rest of the buffer
-			compress(oCompressionBuffer.data() + 4, &dstSize, srcData, srcSize);
+		//Let the engine decide whether compressing this packet is worth it on this connection.
+		sendCompressed = compression && compressionEngine != nullptr && compressionEngine->shouldCompress(getDataSize(), dictionaryFlag);
 
-			//Set the size to the compressed size plus
-			//the four bytes for the size marker
-			size = (dstSize + 4);
+		if (sendCompressed)
+		{
+			//Compress the data into the buffer, after four bytes for our uncompressed size.
+			compressionEngine->compress(getData(), getDataSize(), dictionaryFlag, oCompressionBuffer);
+			oCompressionBuffer.push_back((Bytef)EncodingZlib);
 
+			size = oCompressionBuffer.size();
 			tmpData = oCompressionBuffer.data();
-
 		}
 		else
 		{
 			//Skip compression.
+			*this << (sf::Uint8)EncodingRaw;
 			size = getDataSize();
 			tmpData = getData();
 		}
 
+		sendPrepared = true;
+		sendSize = size;
+
 		//Return data to send
 		return tmpData;
 	}
 
-	void WorkPacket::onReceive(const void *data, std::size_t size)
+	void WorkPacket::onSent()
 	{
-		if (compression)
-		{
-			//Cast the data to Bytef*, the format zlib deals with
-			const Bytef* srcData = static_cast<const Bytef*>(data);
+		if (!sendPrepared || compressionEngine == nullptr) return;
 
-			//Extract the uncompressed data size from the first four
-			//bytes in the packet so we can use it for the buffer
-			//Use SFML sf::Uint32 to ensure byte order and size is sane across different platforms.
-			sf::Uint32 uncompressedSize = srcData[3] << 24 | srcData[2] << 16 | srcData[1] << 8 | srcData[0];
+		compressionEngine->recordSend(sendSize, std::chrono::duration<double>(std::chrono::steady_clock::now() - sendStarted).count(), sendBlocked);
+	}
+
+	bool WorkPacket::nextChunk(WorkPacket &frame, sf::Uint32 messageID, std::size_t chunkSize)
+	{
+		std::size_t size = getDataSize();
+		if (chunkOffset >= size) return false;
 
-			//Resize the vector to accomodate the uncompressed data
-			oCompressionBuffer.resize(uncompressedSize);
+		std::size_t pieceSize = chunkSize > 0 ? std::min(chunkSize, size - chunkOffset) : size - chunkOffset;
 
-			//Declare a variable for the destination size
-			uLong dstSize;
+		frame.clear();
+		frame.setFlag(Chunk);
+		frame.setCompression(compression);
+		frame.setCompressionEngine(compressionEngine);
 
-			//Uncompress the data (skip the first four bytes which were the size data)
-			uncompress(oCompressionBuffer.data(), &dstSize, (srcData + 4), (uLong)size - 4);
+		frame << messageID;
+		frame << flag;
+		frame << (sf::Uint64)size;
+		frame << (sf::Uint64)chunkOffset;
+		frame.append(static_cast<const char *>(getData()) + chunkOffset, pieceSize);
 
-			//Assert that the uncompressed size is the same as the
-			//size we were sent for the buffer
-			if (dstSize != uncompressedSize) CF_THROW("Size mismatch during data decompression. Are compression options set correctly on host and client?");
+		chunkOffset += pieceSize;
+
+		return true;
+	}
+
+	bool WorkPacket::setReceivedData(const void *data, std::size_t size)
+	{
+		clear();
+		onReceive(data, size);
+		return !readError;
+	}
+
+	void WorkPacket::onReceive(const void *data, std::size_t size)
+	{
+		readError = !decodeReceived(data, size);
+	}
+
+	bool WorkPacket::decodeReceived(const void *data, std::size_t size)
+	{
+		if (size < sizeof flag + 1)
+		{
+			CF_SAY("Received packet is too small to hold a packet flag.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		//The last byte records how the rest was encoded.
+		sf::Uint8 encoding = static_cast<const sf::Uint8 *>(data)[size - 1];
+		size--;
+
+		if (encoding == EncodingZlib)
+		{
+			if (compressionEngine == nullptr)
+			{
+				CF_SAY("No compression engine set to decompress packet.", Settings::LogLevels::Error);
+				return false;
+			}
+
+			//Decompress into the buffer, which keeps its capacity for the next packet.
+			if (!compressionEngine->decompress(data, size, oCompressionBuffer)) return false;
+			std::size_t dstSize = oCompressionBuffer.size();
+			if (dstSize < sizeof flag)
+			{
+				CF_SAY("Decompressed packet is too small to hold a packet flag.", Settings::LogLevels::Error);
+				return false;
+			}
 
 			//Retrieve the packet flag data.
 			std::size_t soFlag = sizeof flag;
@@ -120,11 +189,8 @@ namespace cf
 
 			//Append data to the packet.
 			append(oCompressionBuffer.data(), dstSize - soFlag);
-
-			oCompressionBuffer.clear();
-			oCompressionBuffer.resize(0);
 		}
-		else
+		else if (encoding == EncodingRaw)
 		{
 			//Skip decompression.
 
@@ -135,5 +201,12 @@ namespace cf
 			//Append data to the packet.
 			append(data, size - soFlag);
 		}
+		else
+		{
+			CF_SAY("Unknown encoding in received packet.", Settings::LogLevels::Error);
+			return false;
+		}
+
+		return true;
 	}
 }
\ No newline at end of file
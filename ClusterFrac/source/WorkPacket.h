@@ -1,8 +1,15 @@
 #pragma once
 #include "DllExport.h"
+#include <vector>
+#include <string>
+#include <cstring>
+#include <type_traits>
+#include <chrono>
 #include <SFML\Network.hpp>
 #include <zlib.h>
 #include "ConsoleMessager.hpp"
+#include "CompressionEngine.h"
+#include "ArrayFilter.h"
 
 namespace cf
 {
@@ -10,20 +17,36 @@ namespace cf
 	* Work packet class based on SFML Packet class.
 	* Work packets are serialised data designed to be sent over a network.
 	* Extends the SFML Packet class by adding packet flag type and data compression options.
+	* Each packet is sent with a trailing encoding byte that records whether it was compressed,
+	* so the receiver never needs to know in advance.
 	* @author Ashley Flynn - Academy of Interactive Entertainment - 2018.
 	*/
 	class WorkPacket : public sf::Packet
 	{
+
+		//Packet pool needs access to the packet's largest data size.
+		friend class PacketPool;
+
 	public:
 		
 		//The packet type.
+		//Batch packets hold the flag of the packets they stand in for, followed by any number of tasks or results.
+		//Chunk packets hold one piece of a packet too large to send whole. See nextChunk.
 		enum Flag
 		{
 			None,
 			Task,
-			Result
+			Result,
+			Handshake,
+			Cancel,
+			Batch,
+			Chunk
 		};
 
+		//Size of the header at the start of each chunk packet, in bytes.
+		//A Uint32 message ID, the Uint8 flag and Uint64 data size of the whole packet, and the Uint64 offset of the piece.
+		static const std::size_t CHUNK_HEADER_SIZE = 21;
+
 		/**
 		* Default constructor.
 		*/
@@ -65,21 +88,176 @@ namespace cf
 		* Hides the base class clear() function.
 		* @returns void.
 		*/
-		DLL inline void clear() { static_cast<sf::Packet*>(this)->clear(); flag = None; };
+		DLL inline void clear() { static_cast<sf::Packet*>(this)->clear(); flag = None; sendPrepared = false; chunkOffset = 0; readError = false; };
+
+		/**
+		* Fill the packet with data received from the network without using a SFML socket, such as by the listener reactor.
+		* The packet is cleared first. The data is decompressed if compression is turned on.
+		* @param data The received data, not including the packet size that comes before it on the network.
+		* @param size The size of the received data, in bytes.
+		* @returns True if the data was decoded, false if it could not be. See hasReadError().
+		*/
+		DLL bool setReceivedData(const void *data, std::size_t size);
 
 		/**
-		* Turn compression during send/receive on or off.
-		* NOTE: Send/receive will FAIL if the compression status does not match for the work packets
-		* used by the host and client when sneding/receiving.
-		* @param state True to enable compression, false to disable.
+		* Did the received data fail to decode, or did an array read from the packet fail to read?
+		* Received data comes from the other end of the connection, so bad data is reported here rather than thrown.
+		* @returns True if the packet could not be read, false if not.
+		*/
+		DLL inline bool hasReadError() const { return readError; };
+
+		/**
+		* Allow or forbid compression when the packet is sent.
+		* When allowed, the compression engine decides whether compressing the packet is worth it.
+		* Received packets are decompressed if they were sent compressed, whatever this setting.
+		* Handshake packets are always sent uncompressed.
+		* @param state True to allow compression, false to forbid it.
 		*/
 		DLL inline void setCompression(bool state) { compression = state; };
 
+		/**
+		* Set the compression engine used to compress the packet when compression is allowed, and to decompress it.
+		* Each connection has its own engine, which holds the compression level and dictionaries agreed for it.
+		* @param engine The compression engine for the connection the packet is sent or received on.
+		* @returns void.
+		*/
+		DLL inline void setCompressionEngine(CompressionEngine *engine) { compressionEngine = engine; };
+
+		/**
+		* Report that the packet has been sent in full.
+		* Gives the compression engine a measurement of the link speed, if the send had to wait for the socket send buffer.
+		* @returns void.
+		*/
+		DLL void onSent();
+
+		/**
+		* Should the packet be sent as a series of chunk packets?
+		* A packet must either be sent whole or in chunks, so this is only true before the packet has been sent.
+		* @param chunkSize The largest amount of packet data to send in one piece, in bytes, or zero to always send packets whole.
+		* @returns True if the packet should be sent in chunks, false if it should be sent whole.
+		*/
+		DLL inline bool needsChunks(std::size_t chunkSize) const { return chunkSize > 0 && !sendPrepared && (chunkOffset > 0 || getDataSize() > chunkSize); };
+
+		/**
+		* Write the next piece of the packet to a chunk packet.
+		* Large packets are sent as a series of chunk packets, each compressed and sent on its own, so only one
+		* piece at a time is held in memory besides the packet itself. Each chunk packet is written once the one
+		* before it has been sent. The receiver puts them back together with a ChunkAssembler.
+		* The packet must not be changed while it is sent in chunks.
+		* @param frame The packet to write the piece to. It is cleared first, and uses the compression settings of this packet.
+		* @param messageID ID of the packet on its connection, the same for all its pieces.
+		* @param chunkSize The largest amount of packet data to write to the chunk packet, in bytes, or zero to write the rest of the packet.
+		* @returns True if a piece was written, false if all the pieces have already been written.
+		*/
+		DLL bool nextChunk(WorkPacket &frame, sf::Uint32 messageID, std::size_t chunkSize);
+
+		/**
+		* Write an array of numbers to the packet in one block.
+		* Elements are stored in little endian byte order, so little endian machines copy them unchanged.
+		* The array can be encoded with a filter to take fewer bytes, or to compress better if the packet is
+		* compressed. The filter is recorded in the packet, so readArray reverses it without being told.
+		* @param data Pointer to the first element.
+		* @param count The number of elements.
+		* @param filter The filter to encode the array with, from the ArrayFilter::Type enum.
+		* @returns void.
+		*/
+		template <typename T>
+		DLL void writeArray(const T *data, std::size_t count, ArrayFilter::Type filter = ArrayFilter::None)
+		{
+			static_assert(std::is_arithmetic<T>::value, "Only arrays of numbers can be written in one block.");
+
+			std::size_t bytes = count * sizeof(T);
+			if (bytes > 0xFFFFFFFF) CF_THROW("Array too large to write to a packet.");
+
+			*this << (sf::Uint8)filter;
+
+			//Swap the elements in a copy on big endian machines, to leave the caller's data untouched.
+			const sf::Uint8 *littleEndian = reinterpret_cast<const sf::Uint8 *>(data);
+			std::vector<T> swapped;
+			if (!isLittleEndian() && sizeof(T) > 1)
+			{
+				swapped.assign(data, data + count);
+				swapBytes(swapped.data(), count, sizeof(T));
+				littleEndian = reinterpret_cast<const sf::Uint8 *>(swapped.data());
+			}
+
+			//Unfiltered arrays have the same layout as a string, a Uint32 size in bytes followed by the data.
+			if (filter == ArrayFilter::None)
+			{
+				*this << (sf::Uint32)bytes;
+				if (bytes > 0) append(littleEndian, bytes);
+				return;
+			}
+
+			//Filtered arrays also store the element count, as the encoded size doesn't give it.
+			ArrayFilter::encode(filter, littleEndian, count, sizeof(T), filterBuffer);
+			if (filterBuffer.size() > 0xFFFFFFFF) CF_THROW("Array too large to write to a packet.");
+
+			*this << (sf::Uint32)count;
+			*this << (sf::Uint32)filterBuffer.size();
+			if (filterBuffer.size() > 0) append(filterBuffer.data(), filterBuffer.size());
+		};
+
+		/**
+		* Write a vector of numbers to the packet in one block.
+		* @param v The vector to write.
+		* @param filter The filter to encode the array with, from the ArrayFilter::Type enum.
+		* @returns void.
+		*/
+		template <typename T>
+		DLL inline void writeArray(const std::vector<T> &v, ArrayFilter::Type filter = ArrayFilter::None) { writeArray(v.data(), v.size(), filter); };
+
+		/**
+		* Read an array of numbers written by writeArray from the packet, reversing any filter it was encoded with.
+		* The vector is resized once to hold the whole array.
+		* If the block is not a valid array of this element type, the vector is emptied and the packet records a read error.
+		* @param v The vector to read the array into. Its previous contents are replaced.
+		* @returns True if the array was read, false if not.
+		*/
+		template <typename T>
+		DLL bool readArray(std::vector<T> &v)
+		{
+			static_assert(std::is_arithmetic<T>::value, "Only arrays of numbers can be read in one block.");
+
+			sf::Uint8 filter = ArrayFilter::None;
+			sf::Uint32 count = 0;
+			*this >> filter;
+			if (filter != ArrayFilter::None) *this >> count;
+
+			//SFML checks the block fits in the packet as it reads it.
+			*this >> arrayBuffer;
+
+			if (filter == ArrayFilter::None)
+			{
+				if (arrayBuffer.size() % sizeof(T) != 0) return failArray(v);
+
+				v.resize(arrayBuffer.size() / sizeof(T));
+				if (v.size() > 0) std::memcpy(v.data(), arrayBuffer.data(), arrayBuffer.size());
+			}
+			else
+			{
+				//Check the count against the encoded data before making room for it, as it comes from the other end.
+				if (!ArrayFilter::isValidCount((ArrayFilter::Type)filter, arrayBuffer.size(), count, sizeof(T))) return failArray(v);
+
+				//Decode straight into the vector.
+				v.resize(count);
+				if (count > 0 && !ArrayFilter::decode((ArrayFilter::Type)filter, reinterpret_cast<const sf::Uint8 *>(arrayBuffer.data()), arrayBuffer.size(),
+					count, sizeof(T), reinterpret_cast<sf::Uint8 *>(v.data()))) return failArray(v);
+			}
+
+			if (!isLittleEndian() && v.size() > 0) swapBytes(v.data(), v.size(), sizeof(T));
+
+			return true;
+		};
+
 	private:
 
 		//Is compression during network sending turned on or off?
 		bool compression;
 
+		//Compression engine for the connection the packet is sent or received on.
+		CompressionEngine *compressionEngine;
+
 		//The work packet's identifying type flag. Stored as a Uint8 for 
 		//maximum cross platform and network compatibility.
 		sf::Uint8 flag;
@@ -87,8 +265,80 @@ namespace cf
 		//Data buffer to use during compression.
 		std::vector<Bytef> oCompressionBuffer;
 
+		//Has the data to send been prepared? A packet sent on a non blocking socket may take several sends,
+		//and the data is only prepared for the first of them.
+		bool sendPrepared;
+
+		//Size of the prepared data to send.
+		std::size_t sendSize;
+
+		//Was the prepared data compressed?
+		bool sendCompressed;
+
+		//Time the data to send was prepared, just before the first send call.
+		std::chrono::steady_clock::time_point sendStarted;
+
+		//Did a send call return before all the prepared data was accepted, because the socket send buffer was full?
+		bool sendBlocked;
+
+		//Largest data size the packet has held, in bytes, as last measured by the packet pool.
+		//Kept when the packet is cleared, as its buffers keep their capacity.
+		std::size_t largestDataSize;
+
+		//Amount of the packet data already written to chunk packets, in bytes.
+		std::size_t chunkOffset;
+
+		//Trailing byte that records how the sent data is encoded.
+		enum Encoding
+		{
+			EncodingRaw,
+			EncodingZlib
+		};
+
+		//Array blocks are read through this buffer, which keeps its capacity between reads.
+		std::string arrayBuffer;
+
+		//Did the received data fail to decode, or an array fail to read?
+		bool readError;
+
+		//Filtered arrays are encoded into this buffer, which keeps its capacity between writes.
+		std::vector<sf::Uint8> filterBuffer;
+
+		/**
+		* Is this machine little endian?
+		* @returns True if this machine is little endian, false if it is big endian.
+		*/
+		DLL static bool isLittleEndian();
+
+		/**
+		* Reverse the byte order of each element in an array.
+		* @param data Pointer to the first element.
+		* @param count The number of elements.
+		* @param size The size of each element, in bytes.
+		* @returns void.
+		*/
+		DLL static void swapBytes(void *data, std::size_t count, std::size_t size);
+
+		/**
+		* Record that an array in the packet could not be read, and empty the vector it was read into.
+		* @param v The vector the array was read into.
+		* @returns False, for readArray to return.
+		*/
+		template <typename T>
+		DLL inline bool failArray(std::vector<T> &v) { v.clear(); readError = true; return false; };
+
+		/**
+		* Decode data received from the network into the packet, decompressing it if it was sent compressed.
+		* @param data The received data, including the trailing packet flag and encoding bytes.
+		* @param size The size of the received data, in bytes.
+		* @returns True if the data was decoded, false if it is malformed.
+		*/
+		bool decodeReceived(const void *data, std::size_t size);
+
 		/**
 		* Actions to perform before the work packet is sent across the network.
+		* Called again for each partial send, and returns the same data each time.
+		* Data must not be added to the packet until it has been sent in full.
 		* Overrides virtual function in base class.
 		* @returns void.
 		*/
@@ -96,6 +346,7 @@ namespace cf
 
 		/**
 		* Actions to perform after the work packet is received from the network.
+		* Data that can't be decoded is recorded as a read error. See hasReadError().
 		* Overrides virtual function in base class.
 		* @returns void.
 		*/